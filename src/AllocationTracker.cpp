@@ -0,0 +1,189 @@
+#include "AllocationTracker.h"
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#include "Logger.h"
+
+
+AllocationTracker::Counter AllocationTracker::listCounters[AllocationTracker::tagCount];
+thread_local AllocationTag AllocationTracker::tagCurrent = AllocationTag::untagged;
+
+AllocationTracker::FrameStats AllocationTracker::frameStatsStart;
+AllocationTracker::FrameStats AllocationTracker::frameStatsLast;
+AllocationTracker::FrameStats AllocationTracker::frameStatsWorst;
+int AllocationTracker::steadyStateFrameCount = 0;
+
+
+
+
+//Every allocation in the program goes through these, including the standard containers.
+void* operator new(size_t size) {
+	AllocationTracker::recordAllocation(size);
+	void* memory = malloc(size > 0 ? size : 1);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	AllocationTracker::recordAllocation(size);
+	return malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void* memory) noexcept {
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+	free(memory);
+}
+
+
+//Over-aligned types come through these instead, and need the aligned allocator's own free on
+//Windows.
+static void* allocateAligned(size_t size, size_t alignment) {
+#ifdef _WIN32
+	return _aligned_malloc(size > 0 ? size : 1, alignment);
+#else
+	void* memory = nullptr;
+	if (posix_memalign(&memory, alignment, size > 0 ? size : 1) != 0)
+		return nullptr;
+	return memory;
+#endif
+}
+
+static void freeAligned(void* memory) {
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	AllocationTracker::recordAllocation(size);
+	void* memory = allocateAligned(size, (size_t)alignment);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	AllocationTracker::recordAllocation(size);
+	return allocateAligned(size, (size_t)alignment);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+	freeAligned(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept {
+	freeAligned(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+	freeAligned(memory);
+}
+
+
+
+
+void AllocationTracker::beginFrame() {
+	readCounters(frameStatsStart);
+}
+
+
+const AllocationTracker::FrameStats& AllocationTracker::endFrame(bool steadyState) {
+	FrameStats frameStatsEnd;
+	readCounters(frameStatsEnd);
+
+	//The frame's allocations are the difference from when it started.
+	frameStatsLast = FrameStats();
+	for (int count = 0; count < tagCount; count++) {
+		frameStatsLast.listCounts[count] = frameStatsEnd.listCounts[count] - frameStatsStart.listCounts[count];
+		frameStatsLast.listBytes[count] = frameStatsEnd.listBytes[count] - frameStatsStart.listBytes[count];
+		frameStatsLast.countTotal += frameStatsLast.listCounts[count];
+		frameStatsLast.bytesTotal += frameStatsLast.listBytes[count];
+	}
+
+	if (frameStatsLast.countTotal > frameStatsWorst.countTotal)
+		frameStatsWorst = frameStatsLast;
+
+	steadyStateFrameCount = (steadyState ? steadyStateFrameCount + 1 : 0);
+
+#ifdef CITYDEFENSE_ALLOCATION_BUDGET
+	//The profiler's own overlay is exempt from the budget.
+	size_t countBudgeted = frameStatsLast.countTotal -
+		frameStatsLast.listCounts[(int)AllocationTag::profiler];
+	if (steadyStateFrameCount > steadyStateWarmupFrameCount && countBudgeted > 0) {
+		for (int count = 0; count < tagCount; count++)
+			if (frameStatsLast.listCounts[count] > 0)
+				LOG_ERROR(LogModule::general, "Steady state frame allocated %d times (%d bytes) in: %s",
+					(int)frameStatsLast.listCounts[count], (int)frameStatsLast.listBytes[count],
+					getTagName((AllocationTag)count));
+		SDL_assert(countBudgeted == 0);
+	}
+#endif
+
+	return frameStatsLast;
+}
+
+
+
+const AllocationTracker::FrameStats& AllocationTracker::getLastFrame() {
+	return frameStatsLast;
+}
+
+
+const AllocationTracker::FrameStats& AllocationTracker::getWorstFrame() {
+	return frameStatsWorst;
+}
+
+
+void AllocationTracker::resetWorstFrame() {
+	frameStatsWorst = FrameStats();
+}
+
+
+
+const char* AllocationTracker::getTagName(AllocationTag tag) {
+	static const char* listTagNames[] = {
+		"untagged", "game", "units", "turrets", "projectiles", "spawning", "level", "ui", "assets", "profiler" };
+
+	return (tag >= AllocationTag::untagged && tag < AllocationTag::count ? listTagNames[(int)tag] : "?");
+}
+
+
+
+void AllocationTracker::recordAllocation(size_t size) {
+	Counter& counter = listCounters[(int)tagCurrent];
+	counter.count.fetch_add(1, std::memory_order_relaxed);
+	counter.bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+
+AllocationTag AllocationTracker::getTagCurrent() {
+	return tagCurrent;
+}
+
+
+void AllocationTracker::setTagCurrent(AllocationTag tag) {
+	tagCurrent = tag;
+}
+
+
+void AllocationTracker::readCounters(FrameStats& frameStats) {
+	frameStats = FrameStats();
+	for (int count = 0; count < tagCount; count++) {
+		frameStats.listCounts[count] = listCounters[count].count.load(std::memory_order_relaxed);
+		frameStats.listBytes[count] = listCounters[count].bytes.load(std::memory_order_relaxed);
+		frameStats.countTotal += frameStats.listCounts[count];
+		frameStats.bytesTotal += frameStats.listBytes[count];
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include "SDL2/SDL.h"
+
+
+
+//Subsystems that allocations are counted against.  The tag is per thread and set with 
+//ALLOCATION_TAG for the rest of the enclosing scope.
+enum class AllocationTag : int {
+	untagged,
+	game,
+	units,
+	turrets,
+	projectiles,
+	spawning,
+	level,
+	ui,
+	assets,
+	profiler,
+	count
+};
+
+
+#define ALLOCATION_TAG_CONCAT_INNER(a, b) a##b
+#define ALLOCATION_TAG_CONCAT(a, b) ALLOCATION_TAG_CONCAT_INNER(a, b)
+#define ALLOCATION_TAG(tag) AllocationTagScope ALLOCATION_TAG_CONCAT(allocationTagScope, __LINE__)(tag)
+
+
+//Counts every call to the global operator new, by tag and by frame.  Building with 
+//CITYDEFENSE_ALLOCATION_BUDGET (make ALLOCATION_BUDGET=1) asserts whenever a steady state frame 
+//allocates, so the frame loop can be driven to zero allocations.
+class AllocationTracker
+{
+public:
+	static const int tagCount = (int)AllocationTag::count;
+
+	struct FrameStats {
+		size_t countTotal = 0;
+		size_t bytesTotal = 0;
+		size_t listCounts[tagCount] = {};
+		size_t listBytes[tagCount] = {};
+	};
+
+	static void beginFrame();
+	//A frame that's part of the steady state loop is held to the allocation budget once the 
+	//loop has warmed up.
+	static const FrameStats& endFrame(bool steadyState);
+
+	static const FrameStats& getLastFrame();
+	//The frame with the most allocations since resetWorstFrame() was last called.
+	static const FrameStats& getWorstFrame();
+	static void resetWorstFrame();
+
+	static const char* getTagName(AllocationTag tag);
+
+	//Called by the global operator new.
+	static void recordAllocation(size_t size);
+
+	static AllocationTag getTagCurrent();
+	static void setTagCurrent(AllocationTag tag);
+
+
+private:
+	static const int steadyStateWarmupFrameCount = 120;
+
+	struct Counter {
+		std::atomic<size_t> count{ 0 };
+		std::atomic<size_t> bytes{ 0 };
+	};
+
+	static void readCounters(FrameStats& frameStats);
+
+
+	static Counter listCounters[tagCount];
+	static thread_local AllocationTag tagCurrent;
+
+	static FrameStats frameStatsStart, frameStatsLast, frameStatsWorst;
+	static int steadyStateFrameCount;
+};
+
+
+class AllocationTagScope
+{
+public:
+	explicit AllocationTagScope(AllocationTag tag) : tagPrevious(AllocationTracker::getTagCurrent()) {
+		AllocationTracker::setTagCurrent(tag);
+	}
+	~AllocationTagScope() {
+		AllocationTracker::setTagCurrent(tagPrevious);
+	}
+	AllocationTagScope(const AllocationTagScope&) = delete;
+	AllocationTagScope& operator=(const AllocationTagScope&) = delete;
+
+private:
+	AllocationTag tagPrevious;
+};
@@ -0,0 +1,153 @@
+#include "AssetIndex.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <vector>
+
+
+std::unordered_map<std::string, AssetIndex::Location> AssetIndex::umapLocations;
+AssetPack AssetIndex::assetPack;
+bool AssetIndex::built = false;
+
+
+
+
+void AssetIndex::build() {
+    if (built)
+        return;
+    built = true;
+
+    namespace fs = std::filesystem;
+
+    //Look next to the working directory first, then next to the executable.
+    std::vector<fs::path> listRootsToTry = { fs::path(".") };
+    char* basePath = SDL_GetBasePath();
+    if (basePath != nullptr) {
+        listRootsToTry.push_back(fs::path(basePath));
+        SDL_free(basePath);
+    }
+
+    //Index the asset pack first so it takes priority over loose files.
+    for (const auto& root : listRootsToTry) {
+        fs::path pathPack = root / "data.pak";
+        if (assetPack.open(pathPack.string())) {
+            for (int count = 0; count < assetPack.getEntryCount(); count++) {
+                Location location;
+                location.path = pathPack.string() + "/" + assetPack.getEntryName(count);
+                location.data = assetPack.getEntryData(count, location.size);
+                addLocation(assetPack.getEntryName(count), location);
+            }
+
+            LOG_INFO(LogModule::assets, "Indexed %d assets in: %s", assetPack.getEntryCount(), pathPack.string().c_str());
+            break;
+        }
+    }
+
+    //Then any loose files in the data directory, which fill in whatever the pack doesn't have.
+    fs::path pathData;
+    for (const auto& root : listRootsToTry) {
+        std::error_code error;
+        for (fs::directory_iterator it(root, error), end; !error && it != end; it.increment(error)) {
+            if (it->is_directory(error) && toKey(it->path().filename().string()) == "data") {
+                pathData = it->path();
+                break;
+            }
+        }
+        if (pathData.empty() == false)
+            break;
+    }
+
+    if (pathData.empty()) {
+        if (assetPack.isOpen() == false)
+            LOG_ERROR(LogModule::assets, "Couldn't find the data directory");
+        return;
+    }
+
+    //Collect every file under the data directory, sorted so lookups are the same on every platform.
+    std::vector<fs::path> listFiles;
+    std::error_code error;
+    fs::recursive_directory_iterator it(pathData, error), end;
+    for (; !error && it != end; it.increment(error)) {
+        if (it->is_regular_file(error))
+            listFiles.push_back(it->path());
+    }
+    std::sort(listFiles.begin(), listFiles.end());
+
+    for (const auto& pathFile : listFiles) {
+        Location location;
+        location.path = pathFile.string();
+        addLocation(pathFile.lexically_relative(pathData).generic_string(), location);
+    }
+
+    LOG_INFO(LogModule::assets, "Indexed %d assets under: %s", (int)listFiles.size(), pathData.string().c_str());
+}
+
+
+
+SDL_RWops* AssetIndex::openRW(const std::string& name, std::string* pathResolved) {
+    const Location* location = find(name);
+    if (location == nullptr)
+        return nullptr;
+
+    if (pathResolved != nullptr)
+        *pathResolved = location->path;
+
+    if (location->data != nullptr)
+        return SDL_RWFromConstMem(location->data, (int)location->size);
+
+    return SDL_RWFromFile(location->path.c_str(), "rb");
+}
+
+
+bool AssetIndex::contains(const std::string& name) {
+    return (find(name) != nullptr);
+}
+
+
+
+const AssetIndex::Location* AssetIndex::find(const std::string& name) {
+    if (built == false)
+        build();
+
+    //Try the exact name first, then the same name in any other format.
+    auto found = umapLocations.find(toKey(name));
+    if (found == umapLocations.end())
+        found = umapLocations.find(toKey(removeExtension(name)));
+
+    if (found != umapLocations.end())
+        return &found->second;
+
+    return nullptr;
+}
+
+
+std::string AssetIndex::toKey(const std::string& name) {
+    std::string key = name;
+    for (auto& c : key)
+        c = (c == '\\' ? '/' : (char)std::tolower((unsigned char)c));
+
+    return key;
+}
+
+
+std::string AssetIndex::removeExtension(const std::string& name) {
+    size_t dotPos = name.find_last_of('.');
+    size_t slashPos = name.find_last_of("/\\");
+    if (dotPos != std::string::npos && (slashPos == std::string::npos || dotPos > slashPos))
+        return name.substr(0, dotPos);
+
+    return name;
+}
+
+
+void AssetIndex::addLocation(const std::string& pathRelative, const Location& location) {
+    size_t slashPos = pathRelative.find_last_of("/\\");
+    std::string filename = (slashPos == std::string::npos ? pathRelative : pathRelative.substr(slashPos + 1));
+
+    //Keep the first match if two files share a name.
+    for (const auto& key : { filename, pathRelative, removeExtension(filename), removeExtension(pathRelative) }) {
+        if (key != "")
+            umapLocations.emplace(toKey(key), location);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include "SDL2/SDL.h"
+#include "AssetPack.h"
+
+
+
+//Maps logical asset names to the files found by a one-time scan of the data directory (and the 
+//data.pak archive when one is installed), so loading an asset is a single hash lookup instead of 
+//probing paths on disk.  Names are matched case-insensitively by file name ("Tile Wall.bmp"), by 
+//path relative to the data directory ("Sounds/Spawn Unit.ogg"), and by file name without an 
+//extension as a fallback when the requested format doesn't exist ("Instructions.bmp" finds 
+//"Instructions.png").
+class AssetIndex
+{
+public:
+	//Scans the data directory.  Call once on the main thread before any worker threads use it.
+	static void build();
+	//Opens a stream over the asset, or returns nullptr if it doesn't exist.  Assets in the pack 
+	//are served straight from the mapped file without copying.  pathResolved receives the file 
+	//the name resolved to, so callers can pick a decoder by its extension.
+	static SDL_RWops* openRW(const std::string& name, std::string* pathResolved = nullptr);
+	static bool contains(const std::string& name);
+
+
+private:
+	struct Location {
+		std::string path;
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+	};
+
+	static const Location* find(const std::string& name);
+	static std::string toKey(const std::string& name);
+	static std::string removeExtension(const std::string& name);
+	static void addLocation(const std::string& pathRelative, const Location& location);
+
+
+	static std::unordered_map<std::string, Location> umapLocations;
+	static AssetPack assetPack;
+	static bool built;
+};
\ No newline at end of file
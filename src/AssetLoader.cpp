@@ -0,0 +1,176 @@
+#include "AssetLoader.h"
+#include "TextureLoader.h"
+#include "SoundLoader.h"
+#include "Profiler.h"
+#include "AllocationTracker.h"
+
+
+
+
+AssetLoader::AssetLoader() {
+	mutex = SDL_CreateMutex();
+	conditionDecoded = SDL_CreateCond();
+}
+
+
+AssetLoader::~AssetLoader() {
+	//Stop the workers first so nothing is still writing into listAssets.
+	workerPool.reset();
+
+	//Free anything that was decoded but never uploaded.
+	for (auto& assetSelected : listAssets) {
+		if (assetSelected.surface != nullptr)
+			SDL_FreeSurface(assetSelected.surface);
+		if (assetSelected.mix_Chunk != nullptr)
+			Mix_FreeChunk(assetSelected.mix_Chunk);
+	}
+
+	SDL_DestroyCond(conditionDecoded);
+	SDL_DestroyMutex(mutex);
+}
+
+
+
+void AssetLoader::queueTexture(const std::string& filename) {
+	if (started == false) {
+		Asset asset;
+		asset.filename = filename;
+		asset.type = AssetType::texture;
+		listAssets.push_back(asset);
+	}
+}
+
+
+void AssetLoader::queueSound(const std::string& filename) {
+	if (started == false) {
+		Asset asset;
+		asset.filename = filename;
+		asset.type = AssetType::sound;
+		listAssets.push_back(asset);
+	}
+}
+
+
+void AssetLoader::queueGameAssets() {
+	//Backgrounds first so the selection screen previews show up as early as possible.
+	queueTexture("bg1.bmp");
+	queueTexture("bg2.bmp");
+	queueTexture("bg3.bmp");
+
+	queueTexture("Tile Wall.bmp");
+	queueTexture("City.bmp");
+	queueTexture("Tile Enemy Spawner.bmp");
+	queueTexture("Tile Empty.bmp");
+	queueTexture("Tile Arrow Up.bmp");
+	queueTexture("Tile Arrow Up Right.bmp");
+	queueTexture("Tile Arrow Right.bmp");
+	queueTexture("Tile Arrow Down Right.bmp");
+	queueTexture("Tile Arrow Down.bmp");
+	queueTexture("Tile Arrow Down Left.bmp");
+	queueTexture("Tile Arrow Left.bmp");
+	queueTexture("Tile Arrow Up Left.bmp");
+
+	queueTexture("Unit.bmp");
+	queueTexture("Turret.bmp");
+	queueTexture("Turret Shadow.bmp");
+	queueTexture("Projectile.bmp");
+
+	queueTexture("YouWin.bmp");
+	queueTexture("GameOver.bmp");
+	queueTexture("Instructions.bmp");
+
+	queueSound("Spawn Unit.ogg");
+	queueSound("Turret Shoot.ogg");
+}
+
+
+void AssetLoader::start() {
+	if (started)
+		return;
+
+	started = true;
+	workerPool = std::make_unique<WorkerPool>();
+	for (size_t count = 0; count < listAssets.size(); count++)
+		workerPool->submit([this, count]() { decodeAsset(count); });
+}
+
+
+
+void AssetLoader::decodeAsset(size_t index) {
+	PROFILE_SCOPE("AssetLoader::decodeAsset");
+	ALLOCATION_TAG(AllocationTag::assets);
+	Asset& asset = listAssets[index];
+	if (asset.type == AssetType::texture)
+		asset.surface = TextureLoader::loadSurface(asset.filename);
+	else
+		asset.mix_Chunk = SoundLoader::loadChunk(asset.filename);
+
+	SDL_LockMutex(mutex);
+	listIndicesDecoded.push_back(index);
+	SDL_CondSignal(conditionDecoded);
+	SDL_UnlockMutex(mutex);
+}
+
+
+
+bool AssetLoader::update(SDL_Renderer* renderer) {
+	PROFILE_SCOPE("AssetLoader::update");
+	ALLOCATION_TAG(AllocationTag::assets);
+	std::vector<size_t> listIndicesToUpload;
+	SDL_LockMutex(mutex);
+	listIndicesToUpload.swap(listIndicesDecoded);
+	SDL_UnlockMutex(mutex);
+
+	for (size_t index : listIndicesToUpload) {
+		Asset& asset = listAssets[index];
+
+		if (asset.type == AssetType::texture) {
+			//Textures can only be created on the render thread.  Skip it if something already
+			//loaded it synchronously in the meantime.
+			if (asset.surface != nullptr) {
+				if (TextureLoader::findTexture(asset.filename) == nullptr)
+					TextureLoader::addTexture(renderer, asset.filename, asset.surface);
+				else
+					SDL_FreeSurface(asset.surface);
+				asset.surface = nullptr;
+			}
+		}
+		else if (asset.mix_Chunk != nullptr) {
+			SoundLoader::addSound(asset.filename, asset.mix_Chunk);
+			asset.mix_Chunk = nullptr;
+		}
+
+		countResident++;
+	}
+
+	return (listIndicesToUpload.empty() == false);
+}
+
+
+void AssetLoader::finish(SDL_Renderer* renderer) {
+	start();
+
+	while (isFinished() == false) {
+		//Sleep until a worker reports another decoded asset.
+		SDL_LockMutex(mutex);
+		while (listIndicesDecoded.empty())
+			SDL_CondWait(conditionDecoded, mutex);
+		SDL_UnlockMutex(mutex);
+
+		update(renderer);
+	}
+}
+
+
+
+float AssetLoader::getProgress() const {
+	if (listAssets.empty())
+		return 1.0f;
+
+	return (float)countResident / listAssets.size();
+}
+
+
+bool AssetLoader::isFinished() const {
+	return (countResident >= listAssets.size());
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "SDL2/SDL.h"
+#include "SDL2/SDL_mixer.h"
+#include "WorkerPool.h"
+
+
+
+//Decodes images and sounds on a pool of worker threads.  Decoded images are turned into textures 
+//on the render thread in update(), and everything ends up in the TextureLoader/SoundLoader caches 
+//so the rest of the game keeps loading assets by name.
+class AssetLoader
+{
+public:
+	AssetLoader();
+	~AssetLoader();
+
+	void queueTexture(const std::string& filename);
+	void queueSound(const std::string& filename);
+	void queueGameAssets();
+	void start();
+
+	//Uploads everything that finished decoding.  Returns true if any asset became resident.
+	bool update(SDL_Renderer* renderer);
+	//Blocks until every queued asset is resident.
+	void finish(SDL_Renderer* renderer);
+
+	float getProgress() const;
+	bool isFinished() const;
+
+
+private:
+	enum class AssetType {
+		texture,
+		sound
+	};
+
+	struct Asset {
+		std::string filename;
+		AssetType type = AssetType::texture;
+		SDL_Surface* surface = nullptr;
+		Mix_Chunk* mix_Chunk = nullptr;
+	};
+
+	void decodeAsset(size_t index);
+
+
+	//The list isn't resized after start() so worker threads can each fill in their own entry.
+	std::vector<Asset> listAssets;
+	//Assets that have been decoded but not uploaded yet, guarded by mutex.
+	std::vector<size_t> listIndicesDecoded;
+	SDL_mutex* mutex = nullptr;
+	SDL_cond* conditionDecoded = nullptr;
+
+	size_t countResident = 0;
+	bool started = false;
+
+	std::unique_ptr<WorkerPool> workerPool;
+};
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "AssetPack.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+const char AssetPack::magic[4] = { 'C', 'D', 'P', 'K' };
+
+
+
+
+AssetPack::~AssetPack() {
+	close();
+}
+
+
+
+bool AssetPack::open(const std::string& path) {
+	close();
+
+	//Map the whole file read-only.
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		CloseHandle(file);
+		return false;
+	}
+
+	dataMapped = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (dataMapped == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	handleFile = file;
+	handleMapping = mapping;
+	sizeMapped = (std::size_t)size.QuadPart;
+#else
+	int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat info;
+	void* data = MAP_FAILED;
+	if (fstat(file, &info) == 0 && info.st_size > 0)
+		data = mmap(nullptr, (std::size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (data == MAP_FAILED)
+		return false;
+
+	//The whole file is going to be read front to back while loading.
+	madvise(data, (std::size_t)info.st_size, MADV_SEQUENTIAL);
+
+	dataMapped = static_cast<const unsigned char*>(data);
+	sizeMapped = (std::size_t)info.st_size;
+#endif
+
+	//Validate the header and that every entry lies inside the file.
+	const Header* header = reinterpret_cast<const Header*>(dataMapped);
+	bool valid = (sizeMapped >= sizeof(Header) &&
+		std::memcmp(header->magic, magic, sizeof(magic)) == 0 &&
+		header->version == version &&
+		header->fileSize == sizeMapped &&
+		header->indexOffset <= sizeMapped &&
+		header->entryCount <= (sizeMapped - header->indexOffset) / sizeof(Entry));
+
+	if (valid) {
+		listEntries = reinterpret_cast<const Entry*>(dataMapped + header->indexOffset);
+		for (std::uint32_t count = 0; count < header->entryCount && valid; count++) {
+			const Entry& entry = listEntries[count];
+			valid = (entry.offset <= sizeMapped && entry.size <= sizeMapped - entry.offset &&
+				std::memchr(entry.name, '\0', sizeof(entry.name)) != nullptr);
+		}
+	}
+
+	if (valid == false) {
+		std::cout << "Error: Asset pack is invalid: " << path << std::endl;
+		close();
+		return false;
+	}
+
+	entryCount = (int)header->entryCount;
+	return true;
+}
+
+
+void AssetPack::close() {
+	if (dataMapped != nullptr) {
+#ifdef _WIN32
+		UnmapViewOfFile(dataMapped);
+		CloseHandle((HANDLE)handleMapping);
+		CloseHandle((HANDLE)handleFile);
+		handleMapping = nullptr;
+		handleFile = nullptr;
+#else
+		munmap(const_cast<unsigned char*>(dataMapped), sizeMapped);
+#endif
+	}
+
+	dataMapped = nullptr;
+	sizeMapped = 0;
+	listEntries = nullptr;
+	entryCount = 0;
+}
+
+
+
+int AssetPack::getEntryCount() const {
+	return entryCount;
+}
+
+
+std::string AssetPack::getEntryName(int index) const {
+	if (index > -1 && index < entryCount)
+		return std::string(listEntries[index].name);
+
+	return "";
+}
+
+
+const unsigned char* AssetPack::getEntryData(int index, std::size_t& size) const {
+	if (index > -1 && index < entryCount) {
+		size = (std::size_t)listEntries[index].size;
+		return dataMapped + listEntries[index].offset;
+	}
+
+	size = 0;
+	return nullptr;
+}
+
+
+
+bool AssetPack::write(const std::string& pathOutput,
+	const std::vector<std::pair<std::string, std::string>>& listFiles) {
+	//Lay out the header, then the index, then each blob on an aligned offset.
+	Header header = {};
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.entryCount = (std::uint32_t)listFiles.size();
+	header.indexOffset = sizeof(Header);
+
+	std::vector<Entry> listEntriesOutput(listFiles.size());
+	std::vector<std::vector<char>> listBlobs(listFiles.size());
+	std::uint64_t offset = header.indexOffset + sizeof(Entry) * listFiles.size();
+
+	for (size_t count = 0; count < listFiles.size(); count++) {
+		const std::string& name = listFiles[count].first;
+		if (name.size() >= sizeof(Entry::name)) {
+			std::cout << "Error: Asset name is too long for the pack: " << name << std::endl;
+			return false;
+		}
+
+		std::ifstream fileInput(listFiles[count].second, std::ios::binary);
+		if (fileInput.is_open() == false) {
+			std::cout << "Error: Couldn't read asset: " << listFiles[count].second << std::endl;
+			return false;
+		}
+		listBlobs[count].assign(std::istreambuf_iterator<char>(fileInput), std::istreambuf_iterator<char>());
+
+		offset = (offset + blobAlignment - 1) / blobAlignment * blobAlignment;
+
+		Entry& entry = listEntriesOutput[count];
+		std::memset(&entry, 0, sizeof(entry));
+		std::memcpy(entry.name, name.c_str(), name.size());
+		entry.offset = offset;
+		entry.size = listBlobs[count].size();
+
+		offset += entry.size;
+	}
+	header.fileSize = offset;
+
+	//Write to a temporary file first so a partially written pack is never picked up.
+	std::string pathTemp = pathOutput + ".tmp";
+	{
+		std::ofstream fileOutput(pathTemp, std::ios::binary | std::ios::trunc);
+		if (fileOutput.is_open() == false) {
+			std::cout << "Error: Couldn't create: " << pathTemp << std::endl;
+			return false;
+		}
+
+		fileOutput.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		if (listEntriesOutput.empty() == false)
+			fileOutput.write(reinterpret_cast<const char*>(listEntriesOutput.data()),
+				sizeof(Entry) * listEntriesOutput.size());
+
+		for (size_t count = 0; count < listBlobs.size(); count++) {
+			//Pad up to the blob's aligned offset.
+			std::uint64_t position = (std::uint64_t)fileOutput.tellp();
+			std::vector<char> listPadding((size_t)(listEntriesOutput[count].offset - position), 0);
+			fileOutput.write(listPadding.data(), listPadding.size());
+			fileOutput.write(listBlobs[count].data(), listBlobs[count].size());
+		}
+
+		if (fileOutput.good() == false) {
+			std::cout << "Error: Couldn't write: " << pathTemp << std::endl;
+			return false;
+		}
+	}
+
+#ifdef _WIN32
+	bool renamed = (MoveFileExA(pathTemp.c_str(), pathOutput.c_str(), MOVEFILE_REPLACE_EXISTING) != 0);
+#else
+	bool renamed = (std::rename(pathTemp.c_str(), pathOutput.c_str()) == 0);
+#endif
+	if (renamed == false) {
+		std::cout << "Error: Couldn't replace: " << pathOutput << std::endl;
+		std::remove(pathTemp.c_str());
+	}
+
+	return renamed;
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+
+//A single-file archive of every asset: a header, a fixed-size index, then each file's bytes 
+//aligned to blobAlignment.  The archive is memory mapped once and assets are read straight out 
+//of the mapping, so nothing is copied and the whole install can be replaced with one rename.
+class AssetPack
+{
+public:
+	struct Header {
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t entryCount;
+		std::uint32_t reserved;
+		std::uint64_t indexOffset;
+		std::uint64_t fileSize;
+	};
+
+	struct Entry {
+		std::uint64_t offset;
+		std::uint64_t size;
+		//Path relative to the data directory with '/' separators, null terminated.
+		char name[112];
+	};
+
+	static const char magic[4];
+	static const std::uint32_t version = 1;
+	static const std::uint64_t blobAlignment = 64;
+
+	AssetPack() {}
+	AssetPack(const AssetPack&) = delete;
+	AssetPack& operator=(const AssetPack&) = delete;
+	~AssetPack();
+
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const { return dataMapped != nullptr; }
+
+	int getEntryCount() const;
+	std::string getEntryName(int index) const;
+	const unsigned char* getEntryData(int index, std::size_t& size) const;
+
+	//Writes the listed files (name in the pack, path on disk) to a temporary file and renames it 
+	//over pathOutput once it's complete.
+	static bool write(const std::string& pathOutput,
+		const std::vector<std::pair<std::string, std::string>>& listFiles);
+
+
+private:
+	const unsigned char* dataMapped = nullptr;
+	std::size_t sizeMapped = 0;
+	const Entry* listEntries = nullptr;
+	int entryCount = 0;
+
+#ifdef _WIN32
+	void* handleFile = nullptr;
+	void* handleMapping = nullptr;
+#endif
+};
\ No newline at end of file
@@ -1,31 +1,17 @@
 #include "BackgroundSelector.h"
-#include "SDL2/SDL_ttf.h"
-#include <iostream>
+#include "AssetIndex.h"
+#include "Logger.h"
 
 BackgroundSelection::BackgroundSelection(SDL_Renderer* renderer, int width, int height)
     : windowWidth(width), windowHeight(height) {
     
-    // Load font - try multiple font paths for better compatibility
-    TTF_Font* font = nullptr;
-    const char* fontPaths[] = {
-        "arial.ttf", 
-        "./arial.ttf",
-        "/usr/share/fonts/truetype/freefont/FreeSans.ttf",
-        "/usr/share/fonts/TTF/arial.ttf",
-        "/System/Library/Fonts/Supplemental/Arial.ttf", // macOS
-        "C:\\Windows\\Fonts\\arial.ttf" // Windows
-    };
-    
-    for (const char* path : fontPaths) {
-        font = TTF_OpenFont(path, 36);
-        if (font != nullptr) {
-            std::cout << "Loaded font from: " << path << std::endl;
-            break;
-        }
-    }
+    // Load the fonts from the game's data directory
+    font = TTF_OpenFontRW(AssetIndex::openRW("arial.ttf"), 1, 36);
+    labelFont = TTF_OpenFontRW(AssetIndex::openRW("arial.ttf"), 1, 24);
+    instructionsFont = TTF_OpenFontRW(AssetIndex::openRW("arial.ttf"), 1, 20);
     
     if (font == nullptr) {
-        std::cout << "Warning: Could not load any font: " << TTF_GetError() << std::endl;
+        LOG_WARNING(LogModule::ui, "Could not load font: %s", TTF_GetError());
     }
     
     // Create title texture
@@ -38,6 +24,22 @@ BackgroundSelection::BackgroundSelection(SDL_Renderer* renderer, int width, int
             SDL_FreeSurface(surface);
         }
     }
+
+    // Create instructions texture
+    if (instructionsFont != nullptr) {
+        SDL_Color textColor = {200, 200, 200, 255};
+        SDL_Surface* surface = TTF_RenderText_Solid(instructionsFont, "Click on a background to select it", textColor);
+        if (surface != nullptr) {
+            instructionsTexture = SDL_CreateTextureFromSurface(renderer, surface);
+            instructionsRect = {
+                width/2 - surface->w/2,
+                titleRect.y + titleRect.h + 20,
+                surface->w,
+                surface->h
+            };
+            SDL_FreeSurface(surface);
+        }
+    }
     
     // Define background options
     const int previewSize = 200;
@@ -50,19 +52,6 @@ BackgroundSelection::BackgroundSelection(SDL_Renderer* renderer, int width, int
     std::vector<std::string> filenames = {"bg1.bmp", "bg2.bmp", "bg3.bmp"};
     std::vector<std::string> displayNames = {"Grassy Field", "Light Desert", "Desert"};
     
-    // Create smaller font for labels
-    TTF_Font* labelFont = nullptr;
-    if (font != nullptr) {
-        labelFont = TTF_OpenFont(fontPaths[0], 24);
-        if (labelFont == nullptr) {
-            // Try the same font paths as above but with smaller size
-            for (const char* path : fontPaths) {
-                labelFont = TTF_OpenFont(path, 24);
-                if (labelFont != nullptr) break;
-            }
-        }
-    }
-    
     for (int i = 0; i < numOptions; i++) {
         BackgroundOption option;
         option.filename = filenames[i];
@@ -72,28 +61,13 @@ BackgroundSelection::BackgroundSelection(SDL_Renderer* renderer, int width, int
         int posX = startX + (i * (previewSize + spacing));
         option.rect = {posX, startY, previewSize, previewSize};
         
-        // Try multiple paths to find the background file
-        const char* bgPaths[] = {
-            option.filename.c_str(),
-            ("./"+option.filename).c_str(),
-            ("../"+option.filename).c_str(),
-            ("assets/"+option.filename).c_str(),
-            ("data/"+option.filename).c_str(),
-            ("resources/"+option.filename).c_str()
-        };
-        
-        // Load preview texture - try multiple paths
-        for (const char* path : bgPaths) {
-            option.preview = TextureLoader::loadTexture(renderer, path);
-            if (option.preview != nullptr) {
-                std::cout << "Loaded background preview from: " << path << std::endl;
-                break;
-            }
-        }
+        // Use the background if the asset loader already made it resident
+        option.preview = TextureLoader::findTexture(option.filename);
             
-        // If still failed, create a colored preview as fallback
+        // Otherwise show a colored preview until it's loaded
         if (option.preview == nullptr) {
-            std::cout << "Creating fallback colored preview for: " << option.filename << std::endl;
+            LOG_DEBUG(LogModule::ui, "Creating fallback colored preview for: %s", option.filename.c_str());
+            option.previewIsFallback = true;
             SDL_Surface* surface = SDL_CreateRGBSurface(0, previewSize, previewSize, 32, 0, 0, 0, 0);
             if (surface != nullptr) {
                 // Fill with different colors based on index
@@ -128,15 +102,6 @@ BackgroundSelection::BackgroundSelection(SDL_Renderer* renderer, int width, int
         
         options.push_back(option);
     }
-    
-    // Clean up fonts
-    if (font != nullptr) {
-        TTF_CloseFont(font);
-    }
-    
-    if (labelFont != nullptr) {
-        TTF_CloseFont(labelFont);
-    }
 }
 
 BackgroundSelection::~BackgroundSelection() {
@@ -144,15 +109,29 @@ BackgroundSelection::~BackgroundSelection() {
     if (titleTexture != nullptr) {
         SDL_DestroyTexture(titleTexture);
     }
+    if (instructionsTexture != nullptr) {
+        SDL_DestroyTexture(instructionsTexture);
+    }
     
     for (auto& option : options) {
-        if (option.preview != nullptr) {
+        if (option.preview != nullptr && option.previewIsFallback) {
             SDL_DestroyTexture(option.preview);
         }
         if (option.labelTexture != nullptr) {
             SDL_DestroyTexture(option.labelTexture);
         }
     }
+
+    // Clean up fonts
+    if (font != nullptr) {
+        TTF_CloseFont(font);
+    }
+    if (labelFont != nullptr) {
+        TTF_CloseFont(labelFont);
+    }
+    if (instructionsFont != nullptr) {
+        TTF_CloseFont(instructionsFont);
+    }
 }
 
 std::string BackgroundSelection::update(SDL_Event& event) {
@@ -168,7 +147,7 @@ std::string BackgroundSelection::update(SDL_Event& event) {
                 
                 selectionMade = true;
                 selectedBackground = option.filename;
-                std::cout << "Selected background: " << selectedBackground << std::endl;
+                LOG_INFO(LogModule::ui, "Selected background: %s", selectedBackground.c_str());
                 return selectedBackground;
             }
         }
@@ -179,24 +158,50 @@ std::string BackgroundSelection::update(SDL_Event& event) {
         int mouseX = event.motion.x;
         int mouseY = event.motion.y;
         
-        // Reset all hover states first
-        for (auto& option : options) {
-            option.hover = false;
-        }
-        
-        // Set hover state for option under mouse
+        // Set hover state for the option under the mouse, and only redraw if one changed
+        bool hoverFound = false;
         for (auto& option : options) {
-            if (mouseX >= option.rect.x && mouseX < option.rect.x + option.rect.w &&
-                mouseY >= option.rect.y && mouseY < option.rect.y + option.rect.h) {
-                option.hover = true;
-                break;
+            bool hover = !hoverFound &&
+                mouseX >= option.rect.x && mouseX < option.rect.x + option.rect.w &&
+                mouseY >= option.rect.y && mouseY < option.rect.y + option.rect.h;
+            if (hover != option.hover) {
+                option.hover = hover;
+                redrawRequired = true;
             }
+            hoverFound = hoverFound || hover;
         }
     }
+
+    // The window contents may have been lost or resized
+    if (event.type == SDL_WINDOWEVENT) {
+        redrawRequired = true;
+    }
     
     return ""; // No selection made yet
 }
 
+void BackgroundSelection::setLoadingProgress(float progress) {
+    if (progress != loadingProgress) {
+        loadingProgress = progress;
+        redrawRequired = true;
+    }
+
+    // Replace fallback previews with the real backgrounds once they're resident
+    for (auto& option : options) {
+        if (option.previewIsFallback) {
+            SDL_Texture* preview = TextureLoader::findTexture(option.filename);
+            if (preview != nullptr) {
+                if (option.preview != nullptr) {
+                    SDL_DestroyTexture(option.preview);
+                }
+                option.preview = preview;
+                option.previewIsFallback = false;
+                redrawRequired = true;
+            }
+        }
+    }
+}
+
 void BackgroundSelection::draw(SDL_Renderer* renderer) {
     // Clear screen with dark blue background
     SDL_SetRenderDrawColor(renderer, 25, 25, 50, 255);
@@ -208,39 +213,8 @@ void BackgroundSelection::draw(SDL_Renderer* renderer) {
     }
     
     // Draw instructions
-    TTF_Font* font = TTF_OpenFont("arial.ttf", 20);
-    if (font == nullptr) {
-        // Try alternative paths
-        const char* fontPaths[] = {
-            "./arial.ttf",
-            "/usr/share/fonts/truetype/freefont/FreeSans.ttf",
-            "/usr/share/fonts/TTF/arial.ttf",
-            "/System/Library/Fonts/Supplemental/Arial.ttf", // macOS
-            "C:\\Windows\\Fonts\\arial.ttf" // Windows
-        };
-        
-        for (const char* path : fontPaths) {
-            font = TTF_OpenFont(path, 20);
-            if (font != nullptr) break;
-        }
-    }
-    
-    if (font != nullptr) {
-        SDL_Color textColor = {200, 200, 200, 255};
-        SDL_Surface* surface = TTF_RenderText_Solid(font, "Click on a background to select it", textColor);
-        if (surface != nullptr) {
-            SDL_Texture* instructionsTexture = SDL_CreateTextureFromSurface(renderer, surface);
-            SDL_Rect instructionsRect = {
-                windowWidth/2 - surface->w/2,
-                titleRect.y + titleRect.h + 20,
-                surface->w,
-                surface->h
-            };
-            SDL_RenderCopy(renderer, instructionsTexture, NULL, &instructionsRect);
-            SDL_FreeSurface(surface);
-            SDL_DestroyTexture(instructionsTexture);
-        }
-        TTF_CloseFont(font);
+    if (instructionsTexture != nullptr) {
+        SDL_RenderCopy(renderer, instructionsTexture, NULL, &instructionsRect);
     }
     
     // Draw each option
@@ -288,6 +262,19 @@ void BackgroundSelection::draw(SDL_Renderer* renderer) {
         }
     }
     
+    // Draw asset loading progress along the bottom of the screen
+    if (loadingProgress < 1.0f) {
+        SDL_Rect barRect = { windowWidth / 4, windowHeight - 40, windowWidth / 2, 12 };
+        SDL_SetRenderDrawColor(renderer, 60, 60, 90, 255);
+        SDL_RenderFillRect(renderer, &barRect);
+
+        SDL_Rect fillRect = barRect;
+        fillRect.w = (int)(barRect.w * loadingProgress);
+        SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255);
+        SDL_RenderFillRect(renderer, &fillRect);
+    }
+    
     // Present the screen
     SDL_RenderPresent(renderer);
+    redrawRequired = false;
 }
\ No newline at end of file
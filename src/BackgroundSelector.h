@@ -2,6 +2,7 @@
 #include <vector>
 #include <string>
 #include "SDL2/SDL.h"
+#include "SDL2/SDL_ttf.h"
 #include "TextureLoader.h"
 
 class BackgroundSelection {
@@ -12,6 +13,12 @@ public:
     // Returns selected background filename or empty string if still selecting
     std::string update(SDL_Event& event);
     void draw(SDL_Renderer* renderer);
+
+    // Returns true if something changed since the screen was last drawn
+    bool isRedrawRequired() const { return redrawRequired; }
+
+    // Shows asset loading progress and swaps in previews that became resident
+    void setLoadingProgress(float progress);
     
     // Returns true if background was selected
     bool isSelectionMade() const { return selectionMade; }
@@ -24,6 +31,7 @@ private:
         std::string filename;
         std::string displayName;
         SDL_Texture* preview = nullptr;
+        bool previewIsFallback = false;  // Fallback previews are owned here, loaded ones by TextureLoader
         SDL_Rect rect;
         SDL_Texture* labelTexture = nullptr;
         SDL_Rect labelRect;
@@ -36,6 +44,17 @@ private:
     
     SDL_Texture* titleTexture = nullptr;
     SDL_Rect titleRect;
+
+    SDL_Texture* instructionsTexture = nullptr;
+    SDL_Rect instructionsRect;
+
+    // Fonts stay open for the lifetime of the screen instead of being reopened per frame
+    TTF_Font* font = nullptr;
+    TTF_Font* labelFont = nullptr;
+    TTF_Font* instructionsFont = nullptr;
+
+    bool redrawRequired = true;
+    float loadingProgress = 1.0f;
     
     int windowWidth;
     int windowHeight;
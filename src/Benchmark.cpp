@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "SDL2/SDL.h"
+#include "Level.h"
+#include "Unit.h"
+#include "Turret.h"
+#include "Projectile.h"
+#include "Simulation.h"
+#include "Logger.h"
+#include "AllocationTracker.h"
+
+
+
+//Headless benchmark of the simulation.  Each scenario builds a level without a renderer, steps it 
+//with the same Simulation::update as Game::update for a fixed number of ticks and reports the tick 
+//times and allocations per AllocationTracker tag as JSON, so regressions in Unit::update, 
+//Turret::findEnemyUnit and Level::calculateFlowField show up before they ship.
+//
+//Usage: CityDefenseBench [scenario name] [-o output.json]
+
+
+class BenchWorld
+{
+public:
+	BenchWorld(int tileCountX, int tileCountY) :
+		level(nullptr, tileCountX, tileCountY, ""),
+		crowdField(tileCountX, tileCountY),
+		tileCountX(tileCountX), tileCountY(tileCountY) {
+	}
+
+
+	void update(float dT) {
+		Simulation::update(nullptr, dT, level, crowdField, listUnits, listTurrets, listProjectiles);
+	}
+
+
+	Vector2D getRandomOpenPos() {
+		while (true) {
+			int x = rand() % tileCountX;
+			int y = rand() % tileCountY;
+			if (level.isTileWall(x, y) == false)
+				return Vector2D((float)x + 0.5f, (float)y + 0.5f);
+		}
+	}
+
+
+	void addUnitsUpTo(int count) {
+		while ((int)listUnits.size() < count)
+			listUnits.push_back(std::make_shared<Unit>(nullptr, getRandomOpenPos()));
+	}
+
+
+	//Units partway along the spawners' paths, following them as units from the spawners do.
+	void addUnitsOnPathsUpTo(int count) {
+		while ((int)listUnits.size() < count) {
+			int enemySpawnerID = level.getRandomEnemySpawner();
+			int pointCount;
+			unsigned int pathVersion;
+			const Vector2D* listPoints = level.getEnemyPath(enemySpawnerID, pointCount, pathVersion);
+			if (pointCount < 2)
+				return;
+
+			int point = 1 + rand() % (pointCount - 1);
+			Vector2D start = listPoints[point - 1], end = listPoints[point];
+			Vector2D pos = start + (end - start) * ((float)rand() / ((float)RAND_MAX + 1.0f));
+			listUnits.push_back(std::make_shared<Unit>(nullptr, pos));
+			listUnits.back()->setEnemySpawnerID(enemySpawnerID);
+		}
+	}
+
+
+	Level level;
+	CrowdField crowdField;
+	const int tileCountX, tileCountY;
+
+	std::vector<std::shared_ptr<Unit>> listUnits;
+	std::vector<Turret> listTurrets;
+	std::vector<Projectile> listProjectiles;
+};
+
+
+
+
+struct Scenario {
+	const char* name;
+	int tileCountX, tileCountY;
+	int tickCount;
+	std::function<void(BenchWorld&)> setup;
+	//Runs before each tick to keep the scenario under load, and isn't timed.
+	std::function<void(BenchWorld&, int)> feed;
+	//Runs as part of each tick and is timed.
+	std::function<void(BenchWorld&, int)> tick;
+};
+
+
+struct Result {
+	double ticksPerSecond = 0.0;
+	double tickMsP50 = 0.0, tickMsP99 = 0.0, tickMsMax = 0.0;
+	double allocationsPerTick = 0.0;
+	double bytesPerTick = 0.0;
+	double listAllocationsPerTickByTag[AllocationTracker::tagCount] = {};
+};
+
+
+
+static Result runScenario(const Scenario& scenario) {
+	const float dT = 1.0f / 60.0f;
+
+	//Every scenario starts from the same random sequence.
+	srand(1);
+	BenchWorld simulation(scenario.tileCountX, scenario.tileCountY);
+	if (scenario.setup)
+		scenario.setup(simulation);
+
+	std::vector<double> listTickMs;
+	listTickMs.reserve(scenario.tickCount);
+	AllocationTracker::FrameStats allocationsTotal;
+	double msPerTick = 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+	for (int count = 0; count < scenario.tickCount; count++) {
+		if (scenario.feed)
+			scenario.feed(simulation, count);
+
+		AllocationTracker::beginFrame();
+		Uint64 ticksStart = SDL_GetPerformanceCounter();
+
+		if (scenario.tick) {
+			ALLOCATION_TAG(AllocationTag::game);
+			scenario.tick(simulation, count);
+		}
+		simulation.update(dT);
+
+		Uint64 ticksEnd = SDL_GetPerformanceCounter();
+		const AllocationTracker::FrameStats& allocationsTick = AllocationTracker::endFrame(false);
+		allocationsTotal.countTotal += allocationsTick.countTotal;
+		allocationsTotal.bytesTotal += allocationsTick.bytesTotal;
+		for (int countTag = 0; countTag < AllocationTracker::tagCount; countTag++)
+			allocationsTotal.listCounts[countTag] += allocationsTick.listCounts[countTag];
+		listTickMs.push_back((double)(ticksEnd - ticksStart) * msPerTick);
+	}
+
+	Result result;
+	if (listTickMs.empty())
+		return result;
+
+	double msTotal = 0.0;
+	for (double tickMs : listTickMs)
+		msTotal += tickMs;
+
+	std::sort(listTickMs.begin(), listTickMs.end());
+	result.ticksPerSecond = (msTotal > 0.0 ? listTickMs.size() * 1000.0 / msTotal : 0.0);
+	result.tickMsP50 = listTickMs[listTickMs.size() / 2];
+	result.tickMsP99 = listTickMs[std::min(listTickMs.size() - 1, listTickMs.size() * 99 / 100)];
+	result.tickMsMax = listTickMs.back();
+	result.allocationsPerTick = (double)allocationsTotal.countTotal / listTickMs.size();
+	result.bytesPerTick = (double)allocationsTotal.bytesTotal / listTickMs.size();
+	for (int count = 0; count < AllocationTracker::tagCount; count++)
+		result.listAllocationsPerTickByTag[count] = (double)allocationsTotal.listCounts[count] / listTickMs.size();
+	return result;
+}
+
+
+
+static std::vector<Scenario> createScenarios() {
+	std::vector<Scenario> listScenarios;
+
+	//Ten thousand units walking to the city from all over a large map.
+	listScenarios.push_back({ "units_converge", 60, 34, 30,
+		[](BenchWorld& simulation) {
+			simulation.addUnitsUpTo(10000);
+		},
+		nullptr, nullptr });
+
+	//A wave of ten thousand units strung out along the spawners' paths on a large map with walls
+	//to go around, and a smooth field as in the game.
+	listScenarios.push_back({ "units_wave", 480, 480, 120,
+		[](BenchWorld& simulation) {
+			simulation.level.setFlowFieldSmooth(true);
+			//Rebuild the field once for all the walls rather than once for each.
+			simulation.level.setFlowFieldBudget(1000000000);
+			for (int count = 0; count < 20000; count++)
+				simulation.level.setTileWall(rand() % simulation.tileCountX, rand() % simulation.tileCountY, true);
+			while (simulation.level.isFlowFieldRebuilding())
+				simulation.level.updateFlowField();
+			simulation.level.updateFlowField();
+			simulation.addUnitsOnPathsUpTo(10000);
+		},
+		nullptr, nullptr });
+
+	//A ring of 500 turrets around the city firing into a steady stream of units.
+	listScenarios.push_back({ "turrets_firing", 60, 34, 300,
+		[](BenchWorld& simulation) {
+			Vector2D posTarget = simulation.level.getTargetPos();
+			for (int count = 0; count < 500; count++) {
+				float angle = count * 6.2831853f / 500.0f;
+				float radius = 4.0f + (count % 5);
+				simulation.listTurrets.push_back(Turret(nullptr, posTarget + Vector2D(angle) * radius));
+			}
+		},
+		[](BenchWorld& simulation, int) {
+			simulation.addUnitsUpTo(1000);
+		},
+		nullptr });
+
+	//Painting and erasing a few walls every tick, each one rebuilding the flow field.
+	listScenarios.push_back({ "wall_painting", 60, 34, 300,
+		[](BenchWorld& simulation) {
+			simulation.addUnitsUpTo(500);
+		},
+		nullptr,
+		[](BenchWorld& simulation, int tick) {
+			for (int count = 0; count < 8; count++) {
+				int x = rand() % simulation.tileCountX;
+				int y = rand() % simulation.tileCountY;
+				simulation.level.setTileWall(x, y, (tick / 60) % 2 == 0);
+			}
+		} });
+
+	//The same on a map large enough that a full rebuild takes several frames, so the flow field is
+	//rebuilt in slices under the game's budget.
+	listScenarios.push_back({ "wall_painting_large", 480, 480, 120,
+		[](BenchWorld& simulation) {
+			simulation.level.setFlowFieldBudget(2000);
+			simulation.addUnitsUpTo(500);
+		},
+		nullptr,
+		[](BenchWorld& simulation, int tick) {
+			for (int count = 0; count < 8; count++) {
+				int x = rand() % simulation.tileCountX;
+				int y = rand() % simulation.tileCountY;
+				simulation.level.setTileWall(x, y, (tick / 30) % 2 == 0);
+			}
+		} });
+
+	//Thousands of projectiles in flight through a crowd.
+	listScenarios.push_back({ "projectile_flood", 60, 34, 300,
+		[](BenchWorld& simulation) {
+			simulation.listProjectiles.reserve(5000);
+		},
+		[](BenchWorld& simulation, int) {
+			simulation.addUnitsUpTo(500);
+			Vector2D posTarget = simulation.level.getTargetPos();
+			while (simulation.listProjectiles.size() < 5000) {
+				float angle = (rand() % 3600) * 6.2831853f / 3600.0f;
+				simulation.listProjectiles.push_back(Projectile(nullptr, posTarget, Vector2D(angle)));
+			}
+		},
+		nullptr });
+
+	return listScenarios;
+}
+
+
+
+int main(int argc, char* args[]) {
+	std::string scenarioFilter;
+	std::string outputFilename;
+	for (int count = 1; count < argc; count++) {
+		std::string arg = args[count];
+		if (arg == "-o" && count + 1 < argc)
+			outputFilename = args[++count];
+		else
+			scenarioFilter = arg;
+	}
+
+	//Keep stdout for the results.
+	Logger::setModuleEnabled(LogModule::level, false);
+	Logger::setModuleEnabled(LogModule::assets, false);
+
+	FILE* output = stdout;
+	if (outputFilename.empty() == false) {
+		output = fopen(outputFilename.c_str(), "w");
+		if (output == nullptr) {
+			fprintf(stderr, "Couldn't open %s\n", outputFilename.c_str());
+			return 1;
+		}
+	}
+
+	fprintf(output, "{\n  \"scenarios\": [");
+	bool first = true;
+	for (const auto& scenario : createScenarios()) {
+		if (scenarioFilter.empty() == false && scenarioFilter != scenario.name)
+			continue;
+
+		Result result = runScenario(scenario);
+		fprintf(output, "%s\n    {\"name\": \"%s\", \"ticks\": %d, \"ticks_per_second\": %.2f, "
+			"\"tick_ms_p50\": %.4f, \"tick_ms_p99\": %.4f, \"tick_ms_max\": %.4f, "
+			"\"allocations_per_tick\": %.2f, \"bytes_per_tick\": %.1f, \"allocations_per_tick_by_tag\": {",
+			first ? "" : ",", scenario.name, scenario.tickCount, result.ticksPerSecond,
+			result.tickMsP50, result.tickMsP99, result.tickMsMax, result.allocationsPerTick,
+			result.bytesPerTick);
+
+		bool firstTag = true;
+		for (int count = 0; count < AllocationTracker::tagCount; count++) {
+			if (result.listAllocationsPerTickByTag[count] > 0.0) {
+				fprintf(output, "%s\"%s\": %.2f", firstTag ? "" : ", ",
+					AllocationTracker::getTagName((AllocationTag)count), result.listAllocationsPerTickByTag[count]);
+				firstTag = false;
+			}
+		}
+		fprintf(output, "}}");
+		fflush(output);
+		first = false;
+	}
+	fprintf(output, "\n  ]\n}\n");
+
+	if (output != stdout)
+		fclose(output);
+
+	return 0;
+}
@@ -0,0 +1,61 @@
+#include "CrowdField.h"
+#include <algorithm>
+
+
+
+CrowdField::CrowdField(int tileCountX, int tileCountY) :
+	cellCountX(tileCountX * cellsPerTile), cellCountY(tileCountY * cellsPerTile),
+	listDensities((size_t)(tileCountX * cellsPerTile + 3) * (tileCountY * cellsPerTile + 3), 0.0f) {
+}
+
+
+void CrowdField::clear() {
+	std::fill(listDensities.begin(), listDensities.end(), 0.0f);
+}
+
+
+void CrowdField::getCell(Vector2D pos, int& index, float& fractionX, float& fractionY) const {
+	float cellX = std::min(std::max(pos.x * cellsPerTile, 0.0f), cellCountX - 0.001f);
+	float cellY = std::min(std::max(pos.y * cellsPerTile, 0.0f), cellCountY - 0.001f);
+	int cornerX = (int)cellX, cornerY = (int)cellY;
+	fractionX = cellX - cornerX;
+	fractionY = cellY - cornerY;
+	index = (cornerX + 1) + (cornerY + 1) * (cellCountX + 3);
+}
+
+
+void CrowdField::addUnit(Vector2D pos) {
+	int index;
+	float fractionX, fractionY;
+	getCell(pos, index, fractionX, fractionY);
+
+	float* pointsTop = &listDensities[index];
+	float* pointsBottom = pointsTop + (cellCountX + 3);
+	pointsTop[0] += (1.0f - fractionX) * (1.0f - fractionY);
+	pointsTop[1] += fractionX * (1.0f - fractionY);
+	pointsBottom[0] += (1.0f - fractionX) * fractionY;
+	pointsBottom[1] += fractionX * fractionY;
+}
+
+
+Vector2D CrowdField::getPush(Vector2D pos) const {
+	int index;
+	float fractionX, fractionY;
+	getCell(pos, index, fractionX, fractionY);
+
+	//The slope at each of the four points is the difference between the points either side of
+	//it, and those are blended the same way the unit was added.
+	const int rowLength = cellCountX + 3;
+	const int listCorners[4] = { index, index + 1, index + rowLength, index + rowLength + 1 };
+	const float listWeights[4] = {
+		(1.0f - fractionX) * (1.0f - fractionY), fractionX * (1.0f - fractionY),
+		(1.0f - fractionX) * fractionY, fractionX * fractionY };
+
+	Vector2D slope;
+	for (int count = 0; count < 4; count++) {
+		const float* point = &listDensities[listCorners[count]];
+		slope.x += (point[1] - point[-1]) * 0.5f * listWeights[count];
+		slope.y += (point[rowLength] - point[-rowLength]) * 0.5f * listWeights[count];
+	}
+	return Vector2D(-slope.x, -slope.y);
+}
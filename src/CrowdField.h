@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include "Vector2D.h"
+
+
+
+//How crowded each part of the map is, for keeping units apart without checking every pair.  The
+//map is covered by a lattice of points cellsPerTile to a tile, and once a tick every unit adds
+//itself to the four points around it, weighted by how close it is to each.  A unit steers down the
+//slope of the density, taken at the four points around it and blended.  Taking the slope at the
+//points rather than across the cell means units sharing a cell push apart, and a unit's own
+//weights cancel out of it.  Building it is one pass over the units and clearing it one over the
+//points, however the units are bunched up.
+class CrowdField
+{
+public:
+	//Points half a tile apart only reach units about a unit's width away.
+	static constexpr int cellsPerTile = 2;
+
+	CrowdField(int tileCountX, int tileCountY);
+
+	void clear();
+	void addUnit(Vector2D pos);
+	//Down the slope of the density at a unit's position, in units per cell per cell.  What the
+	//unit added itself cancels out.
+	Vector2D getPush(Vector2D pos) const;
+
+
+private:
+	//The lattice point to the top left of the position and how far the position is past it,
+	//clamped so the four points around it are always on the lattice.
+	void getCell(Vector2D pos, int& index, float& fractionX, float& fractionY) const;
+
+
+	const int cellCountX, cellCountY;
+	//The points a row at a time, with an extra ring of points around the map that always stay
+	//empty, so the slope at the edge can read past it.  Rows are cellCountX + 3 points long.
+	std::vector<float> listDensities;
+};
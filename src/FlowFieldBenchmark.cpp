@@ -0,0 +1,684 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "SDL2/SDL.h"
+#include "Level.h"
+#include "HierarchicalPathfinder.h"
+#include "Logger.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+
+//Microbenchmark of the flow field over generated maps, from the game's 15x9 up to 2048x2048.
+//Each map is timed for a full rebuild, for the distance and direction passes on their own, and 
+//for a single wall edit, and reports nanoseconds per tile plus cache misses where the platform's
+//performance counters can be read.  The results are the baseline for flow field optimizations.
+//Maps of 256x256 and up, to 4096x4096, are also timed through the hierarchical path layer, for a
+//full build, a single wall edit and building one cluster's local field.  Full rebuilds of the
+//largest flat map are repeated with 1, 2, 4 and so on threads, up to the core count.  Last, random
+//edits are checked against rebuilds and searches from scratch, and any difference fails the run.
+//
+//Usage: CityDefenseFlowBench [max tiles per side] [-o output.json]
+
+
+//Counts hardware cache misses around a block of code, when the OS allows it.
+class CacheMissCounter
+{
+public:
+	CacheMissCounter() {
+#ifdef __linux__
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	}
+
+	~CacheMissCounter() {
+#ifdef __linux__
+		if (fd >= 0)
+			close(fd);
+#endif
+	}
+
+	bool isAvailable() const {
+		return (fd >= 0);
+	}
+
+	void start() {
+#ifdef __linux__
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	long long stop() {
+		long long count = 0;
+#ifdef __linux__
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(fd, &count, sizeof(count)) != sizeof(count))
+				count = 0;
+		}
+#endif
+		return count;
+	}
+
+
+private:
+	int fd = -1;
+};
+
+
+
+
+enum class WallPattern {
+	random,
+	maze,
+	corridor,
+	terrain
+};
+
+
+class FlowFieldBenchmark
+{
+public:
+	struct Result {
+		double fullRebuildNsPerTile = 0.0;
+		double distancesNsPerTile = 0.0;
+		double directionsNsPerTile = 0.0;
+		double singleEditNsPerTile = 0.0;
+		double singleEditUs = 0.0;
+		double cacheMissesPerTile = -1.0;
+	};
+
+
+	static Result run(int tileCountX, int tileCountY, WallPattern wallPattern, bool useDiagonal) {
+		srand(1);
+		Level level(nullptr, tileCountX, tileCountY, "");
+		level.setFlowFieldHierarchical(false);
+		level.useFlowFieldDiagonal = useDiagonal;
+		generateWalls(level, wallPattern);
+
+		Result result;
+		double tileCount = (double)tileCountX * tileCountY;
+		int repeatCount = getRepeatCount(tileCountX * tileCountY);
+
+		//Full rebuild, as on every wall edit today.
+		CacheMissCounter cacheMissCounter;
+		long long cacheMisses = 0;
+		Uint64 ticks = 0;
+		for (int count = 0; count < repeatCount; count++) {
+			cacheMissCounter.start();
+			Uint64 ticksStart = SDL_GetPerformanceCounter();
+			level.calculateFlowField();
+			ticks += SDL_GetPerformanceCounter() - ticksStart;
+			cacheMisses += cacheMissCounter.stop();
+		}
+		result.fullRebuildNsPerTile = toNs(ticks) / repeatCount / tileCount;
+		if (cacheMissCounter.isAvailable())
+			result.cacheMissesPerTile = (double)cacheMisses / repeatCount / tileCount;
+
+		//The distance pass on its own, which needs the distances reset first.
+		ticks = 0;
+		for (int count = 0; count < repeatCount; count++) {
+			resetFlowData(level);
+			Uint64 ticksStart = SDL_GetPerformanceCounter();
+			level.calculateDistances();
+			ticks += SDL_GetPerformanceCounter() - ticksStart;
+		}
+		result.distancesNsPerTile = toNs(ticks) / repeatCount / tileCount;
+
+		//The direction pass on its own.
+		ticks = 0;
+		for (int count = 0; count < repeatCount; count++) {
+			Uint64 ticksStart = SDL_GetPerformanceCounter();
+			level.calculateFlowDirections();
+			ticks += SDL_GetPerformanceCounter() - ticksStart;
+		}
+		result.directionsNsPerTile = toNs(ticks) / repeatCount / tileCount;
+
+		//Placing and removing one wall through the same path the game uses.
+		ticks = 0;
+		int editCount = 0;
+		for (int count = 0; count < repeatCount; count++) {
+			int x = rand() % tileCountX;
+			int y = rand() % tileCountY;
+			if (level.getTileType(x, y) != Level::TileType::empty ||
+				(x == level.targetX && y == level.targetY))
+				continue;
+
+			Uint64 ticksStart = SDL_GetPerformanceCounter();
+			level.setTileWall(x, y, true);
+			level.setTileWall(x, y, false);
+			ticks += SDL_GetPerformanceCounter() - ticksStart;
+			editCount += 2;
+		}
+		if (editCount > 0) {
+			result.singleEditUs = toNs(ticks) / editCount / 1000.0;
+			result.singleEditNsPerTile = toNs(ticks) / editCount / tileCount;
+		}
+
+		return result;
+	}
+
+
+	struct HierarchicalResult {
+		double buildMs = 0.0;
+		double singleEditUs = 0.0;
+		double localFieldUs = 0.0;
+		int nodeCount = 0;
+	};
+
+
+	static HierarchicalResult runHierarchical(int tileCountX, int tileCountY, WallPattern wallPattern) {
+		srand(1);
+		Level level(nullptr, tileCountX, tileCountY, "");
+		level.setFlowFieldHierarchical(true);
+		generateWalls(level, wallPattern);
+
+		HierarchicalResult result;
+		Uint64 ticksStart = SDL_GetPerformanceCounter();
+		level.calculateFlowField();
+		result.buildMs = toNs(SDL_GetPerformanceCounter() - ticksStart) / 1000000.0;
+		result.nodeCount = level.pathfinderHierarchical->getNodeCount();
+
+		//Ask for a direction in random clusters, which builds each one's local field once.
+		Uint64 ticks = 0;
+		int localFieldCount = 0;
+		for (int count = 0; count < 256; count++) {
+			int localFieldCountBefore = level.pathfinderHierarchical->getLocalFieldCount();
+			int x = rand() % tileCountX;
+			int y = rand() % tileCountY;
+			ticksStart = SDL_GetPerformanceCounter();
+			level.getFlowNormal(x, y);
+			ticks += SDL_GetPerformanceCounter() - ticksStart;
+			localFieldCount += level.pathfinderHierarchical->getLocalFieldCount() - localFieldCountBefore;
+		}
+		if (localFieldCount > 0)
+			result.localFieldUs = toNs(ticks) / localFieldCount / 1000.0;
+
+		//Placing and removing one wall through the same path the game uses.
+		ticks = 0;
+		int editCount = 0;
+		for (int count = 0; count < 20; count++) {
+			int x = rand() % tileCountX;
+			int y = rand() % tileCountY;
+			if (level.getTileType(x, y) != Level::TileType::empty)
+				continue;
+
+			ticksStart = SDL_GetPerformanceCounter();
+			level.setTileWall(x, y, true);
+			level.setTileWall(x, y, false);
+			ticks += SDL_GetPerformanceCounter() - ticksStart;
+			editCount += 2;
+		}
+		if (editCount > 0)
+			result.singleEditUs = toNs(ticks) / editCount / 1000.0;
+
+		return result;
+	}
+
+
+	static double runParallel(int tileCountX, int tileCountY, WallPattern wallPattern, int threadCount) {
+		srand(1);
+		Level level(nullptr, tileCountX, tileCountY, "");
+		level.setFlowFieldHierarchical(false);
+		level.setFlowFieldThreadCount(threadCount);
+		generateWalls(level, wallPattern);
+
+		int repeatCount = getRepeatCount(tileCountX * tileCountY);
+		Uint64 ticksStart = SDL_GetPerformanceCounter();
+		for (int count = 0; count < repeatCount; count++)
+			level.calculateFlowField();
+		return toNs(SDL_GetPerformanceCounter() - ticksStart) / repeatCount / 1000000.0;
+	}
+
+
+	static double runSmooth(int tileCountX, int tileCountY, WallPattern wallPattern, bool useSmooth) {
+		srand(1);
+		Level level(nullptr, tileCountX, tileCountY, "");
+		level.setFlowFieldHierarchical(false);
+		level.setFlowFieldThreadCount(1);
+		level.setFlowFieldSmooth(useSmooth);
+		generateWalls(level, wallPattern);
+
+		int repeatCount = getRepeatCount(tileCountX * tileCountY);
+		Uint64 ticksStart = SDL_GetPerformanceCounter();
+		for (int count = 0; count < repeatCount; count++)
+			level.calculateFlowField();
+		return toNs(SDL_GetPerformanceCounter() - ticksStart) / repeatCount / 1000000.0;
+	}
+
+
+	//Makes random wall and cost edits through the incremental update, and after every few compares
+	//every tile's direction with a layer rebuilt from scratch.  Returns the number of tiles that
+	//differed, summed over the checks.
+	static int verifyHierarchical(int tileCountX, int tileCountY, WallPattern wallPattern, int editCount) {
+		srand(1);
+		Level level(nullptr, tileCountX, tileCountY, "");
+		level.setFlowFieldHierarchical(true);
+		generateWalls(level, wallPattern);
+		level.calculateFlowField();
+
+		int mismatchCount = 0;
+		for (int count = 1; count <= editCount; count++) {
+			int x = rand() % tileCountX;
+			int y = rand() % tileCountY;
+			if (rand() % 4 == 0)
+				level.setTileCost(x, y, Level::tileCostMin + rand() % (Level::tileCostMax - Level::tileCostMin + 1));
+			else
+				level.setTileWall(x, y, level.isTileWall(x, y) == false);
+
+			if (count % 10 == 0 || count == editCount) {
+				HierarchicalPathfinder pathfinderRebuilt(level);
+				pathfinderRebuilt.rebuild();
+				for (int flowFieldID = 0; flowFieldID < level.getFlowFieldCount(); flowFieldID++) {
+					for (int y = 0; y < tileCountY; y++) {
+						for (int x = 0; x < tileCountX; x++) {
+							Vector2D normal = level.pathfinderHierarchical->getFlowNormal(x, y, flowFieldID);
+							Vector2D normalRebuilt = pathfinderRebuilt.getFlowNormal(x, y, flowFieldID);
+							if (normal.x != normalRebuilt.x || normal.y != normalRebuilt.y)
+								mismatchCount++;
+						}
+					}
+				}
+			}
+		}
+
+		return mismatchCount;
+	}
+
+
+	//Asks canPlaceWall about random tiles and places and removes walls the way the game does, and
+	//checks every answer, and the reachable tiles it keeps patched between edits, against a plain
+	//search from the targets.  Returns the number of answers and tiles that differed.
+	static int verifyPlaceWall(int tileCountX, int tileCountY, WallPattern wallPattern, int editCount) {
+		srand(1);
+		Level level(nullptr, tileCountX, tileCountY, "");
+		level.setFlowFieldHierarchical(false);
+		generateWalls(level, wallPattern);
+
+		//Spawners in the open, so there's something to cut off on any pattern.
+		for (int count = 0; count < 8; count++) {
+			int x = rand() % tileCountX;
+			int y = rand() % tileCountY;
+			if (level.getTileType(x, y) == Level::TileType::empty)
+				level.setTileEnemySpawner(x, y, true);
+		}
+
+		int mismatchCount = 0;
+		std::vector<char> listReached, listReachedBlocked;
+		for (int count = 0; count < editCount; count++) {
+			int x = rand() % tileCountX;
+			int y = rand() % tileCountY;
+
+			if (level.getTileType(x, y) == Level::TileType::wall) {
+				level.setTileWall(x, y, false);
+			}
+			else {
+				//Nothing a spawner reaches now may be cut off by the wall.
+				searchReachable(level, -1, -1, listReached);
+				searchReachable(level, x, y, listReachedBlocked);
+				bool isAllowed = true;
+				for (const auto& enemySpawner : level.listEnemySpawners)
+					if (listReached[enemySpawner.index] && listReachedBlocked[enemySpawner.index] == 0)
+						isAllowed = false;
+				if (level.getTileType(x, y) != Level::TileType::empty)
+					isAllowed = true;
+
+				//Place it right after the check, as the game does, or sometimes without asking.
+				bool isChecked = (rand() % 4 != 0);
+				if (isChecked && level.canPlaceWall(x, y) != isAllowed)
+					mismatchCount++;
+				if (isAllowed)
+					level.setTileWall(x, y, true);
+			}
+
+			//The reachable tiles kept between checks have to match a search from scratch.
+			if (level.isReachableValid) {
+				searchReachable(level, -1, -1, listReached);
+				for (int index = 0; index < tileCountX * tileCountY; index++)
+					if (level.wallGrid.isSet(level.listReachable, index % tileCountX, index / tileCountX) !=
+						(listReached[index] != 0))
+						mismatchCount++;
+			}
+		}
+
+		return mismatchCount;
+	}
+
+
+private:
+	static int getRepeatCount(int tileCount) {
+		//Aim for a few million tiles per measurement, with at least a few runs.
+		int repeatCount = 4000000 / tileCount;
+		return (repeatCount < 3 ? 3 : (repeatCount > 2000 ? 2000 : repeatCount));
+	}
+
+
+	static double toNs(Uint64 ticks) {
+		return (double)ticks * 1000000000.0 / (double)SDL_GetPerformanceFrequency();
+	}
+
+
+	static void resetFlowData(Level& level) {
+		//The passes write the planes a rebuild fills before swapping them in.
+		size_t planeSize = level.listFlowDistances.size();
+		level.listFlowDistancesPending.assign(planeSize, Level::flowDistanceMax);
+		level.listFlowDirectionsXPending.assign(planeSize, 0);
+		level.listFlowDirectionsYPending.assign(planeSize, 0);
+	}
+
+
+	//A breadth first search out from every target over the tiles that aren't walls, with one more
+	//tile treated as a wall, that only goes by the level's tiles.
+	static void searchReachable(const Level& level, int xBlocked, int yBlocked, std::vector<char>& listReached) {
+		int tileCountX = level.tileCountX;
+		int tileCountY = level.tileCountY;
+		listReached.assign((size_t)tileCountX * tileCountY, 0);
+
+		std::vector<int> listQueue;
+		for (int index = 0; index < tileCountX * tileCountY; index++) {
+			if (level.listTiles[index].type == Level::TileType::target) {
+				listReached[index] = 1;
+				listQueue.push_back(index);
+			}
+		}
+
+		const int listSteps[][2] = { {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
+		for (size_t position = 0; position < listQueue.size(); position++) {
+			int x = listQueue[position] % tileCountX, y = listQueue[position] / tileCountX;
+			for (const auto& step : listSteps) {
+				int nextX = x + step[0], nextY = y + step[1];
+				int indexNext = nextX + nextY * tileCountX;
+				if (nextX >= 0 && nextX < tileCountX && nextY >= 0 && nextY < tileCountY &&
+					(nextX != xBlocked || nextY != yBlocked) && listReached[indexNext] == 0 &&
+					level.listTiles[indexNext].type != Level::TileType::wall) {
+					listReached[indexNext] = 1;
+					listQueue.push_back(indexNext);
+				}
+			}
+		}
+	}
+
+
+	static void setWall(Level& level, int x, int y, bool isWall) {
+		//Set the tile directly so the generators don't rebuild the flow field for every wall.
+		Level::Tile& tile = level.listTiles[x + y * level.tileCountX];
+		if (tile.type != Level::TileType::enemySpawner && tile.type != Level::TileType::target) {
+			tile.type = (isWall ? Level::TileType::wall : Level::TileType::empty);
+			level.wallGrid.setWall(x, y, isWall);
+		}
+	}
+
+
+	static void generateWalls(Level& level, WallPattern wallPattern) {
+		int tileCountX = level.tileCountX;
+		int tileCountY = level.tileCountY;
+
+		switch (wallPattern) {
+		case WallPattern::random:
+			//A quarter of the tiles are walls.
+			for (int y = 0; y < tileCountY; y++)
+				for (int x = 0; x < tileCountX; x++)
+					setWall(level, x, y, rand() % 4 == 0);
+			break;
+
+		case WallPattern::maze: {
+			//Carve a perfect maze through the odd cells with a depth first search.
+			for (int y = 0; y < tileCountY; y++)
+				for (int x = 0; x < tileCountX; x++)
+					setWall(level, x, y, true);
+
+			std::vector<char> listVisited((size_t)tileCountX * tileCountY, 0);
+			std::vector<int> listStack;
+			listStack.push_back(1 + 1 * tileCountX);
+			listVisited[listStack.back()] = 1;
+			setWall(level, 1, 1, false);
+
+			const int listSteps[][2] = { {2, 0}, {-2, 0}, {0, 2}, {0, -2} };
+			while (listStack.empty() == false) {
+				int index = listStack.back();
+				int x = index % tileCountX, y = index / tileCountX;
+
+				int listOptions[4], optionCount = 0;
+				for (int count = 0; count < 4; count++) {
+					int nextX = x + listSteps[count][0], nextY = y + listSteps[count][1];
+					if (nextX > 0 && nextX < tileCountX - 1 && nextY > 0 && nextY < tileCountY - 1 &&
+						listVisited[nextX + nextY * tileCountX] == 0)
+						listOptions[optionCount++] = count;
+				}
+
+				if (optionCount == 0) {
+					listStack.pop_back();
+					continue;
+				}
+
+				int step = listOptions[rand() % optionCount];
+				int nextX = x + listSteps[step][0], nextY = y + listSteps[step][1];
+				setWall(level, x + listSteps[step][0] / 2, y + listSteps[step][1] / 2, false);
+				setWall(level, nextX, nextY, false);
+				listVisited[nextX + nextY * tileCountX] = 1;
+				listStack.push_back(nextX + nextY * tileCountX);
+			}
+			break;
+		}
+
+		case WallPattern::corridor:
+			//Horizontal walls every few rows with the gap on alternating sides, which makes one
+			//long winding path and the deepest possible search.
+			for (int y = 0; y < tileCountY; y++)
+				for (int x = 0; x < tileCountX; x++)
+					setWall(level, x, y, (y % 4 == 3) && (y / 4 % 2 == 0 ? x != tileCountX - 1 : x != 0));
+			break;
+
+		case WallPattern::terrain:
+			//An eighth of the tiles are walls and the rest have random costs, with a road every
+			//16 rows, so the weighted search sees every step size.
+			for (int y = 0; y < tileCountY; y++) {
+				for (int x = 0; x < tileCountX; x++) {
+					setWall(level, x, y, rand() % 8 == 0);
+					unsigned char& cost = level.listTiles[x + y * tileCountX].cost;
+					cost = (unsigned char)(y % 16 == 0 ? Level::tileCostMin :
+						Level::tileCostMin + rand() % (Level::tileCostMax - Level::tileCostMin + 1));
+					level.tileCountWeighted += (cost != Level::tileCostDefault);
+				}
+			}
+			break;
+		}
+
+		level.wallDistanceField.rebuild();
+	}
+};
+
+
+
+
+static const char* getWallPatternName(WallPattern wallPattern) {
+	switch (wallPattern) {
+	case WallPattern::random: return "random";
+	case WallPattern::maze: return "maze";
+	case WallPattern::corridor: return "corridor";
+	case WallPattern::terrain: return "terrain";
+	}
+	return "";
+}
+
+
+
+int main(int argc, char* args[]) {
+	int sizeMax = 4096;
+	std::string outputFilename;
+	for (int count = 1; count < argc; count++) {
+		std::string arg = args[count];
+		if (arg == "-o" && count + 1 < argc)
+			outputFilename = args[++count];
+		else
+			sizeMax = atoi(arg.c_str());
+	}
+
+	//Keep stdout for the results.
+	Logger::setModuleEnabled(LogModule::level, false);
+	Logger::setModuleEnabled(LogModule::assets, false);
+
+	FILE* output = stdout;
+	if (outputFilename.empty() == false) {
+		output = fopen(outputFilename.c_str(), "w");
+		if (output == nullptr) {
+			fprintf(stderr, "Couldn't open %s\n", outputFilename.c_str());
+			return 1;
+		}
+	}
+
+	const int listSizes[][2] = { {15, 9}, {64, 64}, {256, 256}, {1024, 1024}, {2048, 2048} };
+	//Terrain is also run with diagonal steps, the slowest setting.
+	const struct {
+		WallPattern wallPattern;
+		bool useDiagonal;
+	} listConfigs[] = {
+		{ WallPattern::random, false }, { WallPattern::maze, false }, { WallPattern::corridor, false },
+		{ WallPattern::terrain, false }, { WallPattern::terrain, true } };
+
+	fprintf(output, "{\n  \"flow_field\": [");
+	bool first = true;
+	for (const auto& size : listSizes) {
+		if (size[0] > sizeMax || size[1] > sizeMax)
+			continue;
+
+		for (const auto& config : listConfigs) {
+			FlowFieldBenchmark::Result result = FlowFieldBenchmark::run(size[0], size[1], 
+				config.wallPattern, config.useDiagonal);
+
+			fprintf(output, "%s\n    {\"width\": %d, \"height\": %d, \"pattern\": \"%s\", \"neighbors\": %d, "
+				"\"full_rebuild_ns_per_tile\": %.3f, \"distances_ns_per_tile\": %.3f, "
+				"\"directions_ns_per_tile\": %.3f, \"single_edit_us\": %.3f, "
+				"\"single_edit_ns_per_tile\": %.3f, ",
+				first ? "" : ",", size[0], size[1], getWallPatternName(config.wallPattern), config.useDiagonal ? 8 : 4,
+				result.fullRebuildNsPerTile, result.distancesNsPerTile, result.directionsNsPerTile,
+				result.singleEditUs, result.singleEditNsPerTile);
+			if (result.cacheMissesPerTile >= 0.0)
+				fprintf(output, "\"cache_misses_per_tile\": %.4f}", result.cacheMissesPerTile);
+			else
+				fprintf(output, "\"cache_misses_per_tile\": null}");
+			fflush(output);
+			first = false;
+		}
+	}
+	fprintf(output, "\n  ],\n  \"hierarchical\": [");
+
+	const int listSizesHierarchical[] = { 256, 1024, 2048, 4096 };
+	const WallPattern listWallPatternsHierarchical[] = { WallPattern::random, WallPattern::maze,
+		WallPattern::corridor, WallPattern::terrain };
+	first = true;
+	for (int size : listSizesHierarchical) {
+		if (size > sizeMax)
+			continue;
+
+		for (WallPattern wallPattern : listWallPatternsHierarchical) {
+			FlowFieldBenchmark::HierarchicalResult result = FlowFieldBenchmark::runHierarchical(size, size, wallPattern);
+
+			fprintf(output, "%s\n    {\"width\": %d, \"height\": %d, \"pattern\": \"%s\", \"cluster_size\": %d, "
+				"\"node_count\": %d, \"build_ms\": %.3f, \"single_edit_us\": %.3f, \"local_field_us\": %.3f}",
+				first ? "" : ",", size, size, getWallPatternName(wallPattern), HierarchicalPathfinder::clusterSize,
+				result.nodeCount, result.buildMs, result.singleEditUs, result.localFieldUs);
+			fflush(output);
+			first = false;
+		}
+	}
+	fprintf(output, "\n  ],\n  \"parallel\": [");
+
+	//The largest flat map that fits under the size limit.
+	int sizeParallel = 0;
+	for (const auto& size : listSizes)
+		if (size[0] == size[1] && size[0] <= sizeMax)
+			sizeParallel = size[0];
+	first = true;
+	for (int threadCount = 1; sizeParallel > 0 && threadCount <= SDL_GetCPUCount(); threadCount *= 2) {
+		for (WallPattern wallPattern : { WallPattern::random, WallPattern::maze }) {
+			double fullRebuildMs = FlowFieldBenchmark::runParallel(sizeParallel, sizeParallel, wallPattern, threadCount);
+
+			fprintf(output, "%s\n    {\"width\": %d, \"height\": %d, \"pattern\": \"%s\", \"threads\": %d, "
+				"\"full_rebuild_ms\": %.3f}",
+				first ? "" : ",", sizeParallel, sizeParallel, getWallPatternName(wallPattern), threadCount,
+				fullRebuildMs);
+			fflush(output);
+			first = false;
+		}
+	}
+	fprintf(output, "\n  ],\n  \"smooth\": [");
+
+	//What the fast marching pass adds to a rebuild, on one thread.
+	first = true;
+	for (WallPattern wallPattern : { WallPattern::random, WallPattern::maze }) {
+		if (sizeParallel == 0)
+			break;
+		double plainMs = FlowFieldBenchmark::runSmooth(sizeParallel, sizeParallel, wallPattern, false);
+		double smoothMs = FlowFieldBenchmark::runSmooth(sizeParallel, sizeParallel, wallPattern, true);
+
+		fprintf(output, "%s\n    {\"width\": %d, \"height\": %d, \"pattern\": \"%s\", "
+			"\"plain_rebuild_ms\": %.3f, \"smooth_rebuild_ms\": %.3f}",
+			first ? "" : ",", sizeParallel, sizeParallel, getWallPatternName(wallPattern), plainMs, smoothMs);
+		fflush(output);
+		first = false;
+	}
+	fprintf(output, "\n  ],\n  \"verify\": [");
+
+	//Checks that incremental updates end up where working it out from scratch would.  Any mismatch
+	//fails the run.
+	int mismatchCountTotal = 0;
+	first = true;
+	const int listSizesVerify[][2] = { {96, 80}, {256, 256} };
+	const struct {
+		const char* name;
+		int (*verify)(int tileCountX, int tileCountY, WallPattern wallPattern, int editCount);
+	} listChecks[] = {
+		{ "hierarchical_repair", FlowFieldBenchmark::verifyHierarchical },
+		{ "place_wall", FlowFieldBenchmark::verifyPlaceWall } };
+	for (const auto& size : listSizesVerify) {
+		if (size[0] > sizeMax || size[1] > sizeMax)
+			continue;
+
+		for (WallPattern wallPattern : listWallPatternsHierarchical) {
+			for (const auto& check : listChecks) {
+				int editCount = 300;
+				int mismatchCount = check.verify(size[0], size[1], wallPattern, editCount);
+				mismatchCountTotal += mismatchCount;
+
+				fprintf(output, "%s\n    {\"check\": \"%s\", \"width\": %d, \"height\": %d, "
+					"\"pattern\": \"%s\", \"edits\": %d, \"mismatches\": %d}",
+					first ? "" : ",", check.name, size[0], size[1], getWallPatternName(wallPattern), editCount,
+					mismatchCount);
+				fflush(output);
+				first = false;
+			}
+		}
+	}
+	fprintf(output, "\n  ]\n}\n");
+
+	if (output != stdout)
+		fclose(output);
+
+	if (mismatchCountTotal > 0) {
+		fprintf(stderr, "%d mismatches in the verify checks\n", mismatchCountTotal);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,92 @@
+#include "FrameArena.h"
+#include <cstdint>
+#include <new>
+
+
+
+
+FrameArena::FrameArena(size_t capacity) :
+	memory(static_cast<unsigned char*>(::operator new(capacity))), capacity(capacity) {
+}
+
+
+FrameArena::~FrameArena() {
+	::operator delete(memory);
+}
+
+
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+	//Align the start of the allocation from the current top.
+	uintptr_t address = reinterpret_cast<uintptr_t>(memory) + used;
+	size_t padding = (alignment - (address % alignment)) % alignment;
+
+	if (used + padding + size > capacity) {
+		overflowCount++;
+		if (alignment > alignof(std::max_align_t))
+			return ::operator new(size, std::align_val_t(alignment));
+		return ::operator new(size);
+	}
+
+	void* memoryAllocated = memory + used + padding;
+	used += padding + size;
+	if (used > usedPeak)
+		usedPeak = used;
+
+	return memoryAllocated;
+}
+
+
+void FrameArena::deallocate(void* memoryToFree, size_t size, size_t alignment) {
+	if (owns(memoryToFree) == false) {
+		if (alignment > alignof(std::max_align_t))
+			::operator delete(memoryToFree, std::align_val_t(alignment));
+		else
+			::operator delete(memoryToFree);
+		return;
+	}
+
+	//Pop the last allocation so a scratch container that's freed right away gives its space back.
+	if (static_cast<unsigned char*>(memoryToFree) + size == memory + used)
+		used -= size;
+}
+
+
+
+size_t FrameArena::getMarker() const {
+	return used;
+}
+
+
+void FrameArena::rewind(size_t marker) {
+	if (marker < used)
+		used = marker;
+}
+
+
+void FrameArena::reset() {
+	used = 0;
+}
+
+
+
+bool FrameArena::owns(const void* memoryToCheck) const {
+	const unsigned char* address = static_cast<const unsigned char*>(memoryToCheck);
+	return (address >= memory && address < memory + capacity);
+}
+
+
+size_t FrameArena::getCapacity() const {
+	return capacity;
+}
+
+
+size_t FrameArena::getUsedPeak() const {
+	return usedPeak;
+}
+
+
+size_t FrameArena::getOverflowCount() const {
+	return overflowCount;
+}
+
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+
+
+
+//A linear allocator for transient data.  Allocations bump a pointer through one block and are all
+//released at once by reset(), or back to a marker by ArenaScope so it also works as a scratch 
+//stack.  If the block runs out, allocations fall back to the heap so callers never fail.  An arena
+//is only ever used from one thread.
+class FrameArena
+{
+public:
+	explicit FrameArena(size_t capacity);
+	~FrameArena();
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	//Arena memory is only reclaimed by reset() or rewind(), unless it was the last allocation.
+	//The alignment has to match the allocation's, for ones that fell back to the heap.
+	void deallocate(void* memory, size_t size, size_t alignment = alignof(std::max_align_t));
+
+	size_t getMarker() const;
+	void rewind(size_t marker);
+	void reset();
+
+	bool owns(const void* memory) const;
+	size_t getCapacity() const;
+	size_t getUsedPeak() const;
+	size_t getOverflowCount() const;
+
+
+private:
+	unsigned char* memory = nullptr;
+	size_t capacity = 0;
+	size_t used = 0;
+	size_t usedPeak = 0;
+	size_t overflowCount = 0;
+};
+
+
+
+//Rewinds an arena to where it was when the scope started.
+class ArenaScope
+{
+public:
+	explicit ArenaScope(FrameArena& arena) : arena(arena), marker(arena.getMarker()) {}
+	~ArenaScope() { arena.rewind(marker); }
+	ArenaScope(const ArenaScope&) = delete;
+	ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+	FrameArena& arena;
+	size_t marker;
+};
+
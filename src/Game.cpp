@@ -1,14 +1,22 @@
 #include "Game.h"
+#include "Simulation.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include "AllocationTracker.h"
 
 
 
 Game::Game(SDL_Window* window, SDL_Renderer* renderer, int windowWidth, int windowHeight, const std::string& backgroundFile) :
     placementModeCurrent(PlacementMode::wall), 
     level(renderer, windowWidth / tileSize, windowHeight / tileSize, backgroundFile),
+    crowdField(windowWidth / tileSize, windowHeight / tileSize),
     spawnTimer(0.25f), roundTimer(3.0f),
     windowWidth(windowWidth), windowHeight(windowHeight),
     currentBackground(backgroundFile) {
 
+    level.setFlowFieldBudget(flowFieldBudgetMicroseconds);
+    level.setFlowFieldSmooth(true);
+
     // Initialize UI
     ui = new UI(window, renderer);
 
@@ -16,14 +24,9 @@ Game::Game(SDL_Window* window, SDL_Renderer* renderer, int windowWidth, int wind
     resourceManager.reset();
 
     //Load the font
-    font = TTF_OpenFont("D:/Xius/Dev/Game_Project/Data/Fonts/arial.ttf", 24);
+    font = TTF_OpenFontRW(AssetIndex::openRW("arial.ttf"), 1, 24);
     if (font == nullptr) {
-        std::cout << "Error: Couldn't load font = " << TTF_GetError() << std::endl;
-        // Try loading a fallback font
-        font = TTF_OpenFont("D:/Xius/Dev/Game_Project/Data/Fonts/arial.ttf", 24);
-        if (font == nullptr) {
-            std::cout << "Error: Couldn't load fallback font = " << TTF_GetError() << std::endl;
-        }
+        LOG_ERROR(LogModule::game, "Couldn't load font = %s", TTF_GetError());
     }
 
     //Run the game.
@@ -33,6 +36,7 @@ Game::Game(SDL_Window* window, SDL_Renderer* renderer, int windowWidth, int wind
         textureWin = TextureLoader::loadTexture(renderer, "YouWin.bmp");
         textureGameOver = TextureLoader::loadTexture(renderer, "GameOver.bmp");
         textureInstructions = TextureLoader::loadTexture(renderer, "Instructions.bmp");
+        calculateScreenLayouts();
 
         // Create Try Again button
         createTryAgainButton(renderer);
@@ -53,19 +57,40 @@ Game::Game(SDL_Window* window, SDL_Renderer* renderer, int windowWidth, int wind
         //Start the game loop and run until it's time to stop.
         bool running = true;
         while (running) {
+            //The instruction and end screens are static, so sleep until there's input instead of
+            //spinning on the frame clock. Keep ticking while a notification is fading out or a
+            //flow field rebuild is still under way.
+            bool idle = (gameState != GameState::playing && !ui->isNotificationActive() &&
+                !level.isFlowFieldRebuilding());
+            if (idle && SDL_HasEvents(SDL_FIRSTEVENT, SDL_LASTEVENT) == SDL_FALSE)
+                SDL_WaitEventTimeout(NULL, idleWaitTimeoutMs);
+
             //Determine how much time has elapsed since the last frame.
             time2 = std::chrono::system_clock::now();
             std::chrono::duration<float> timeDelta = time2 - time1;
             float timeDeltaFloat = timeDelta.count();
 
+            //An event is waiting for the next frame, so sleep until it's due rather than spin.
+            if (idle && timeDeltaFloat < dT)
+                SDL_Delay((Uint32)((dT - timeDeltaFloat) * 1000.0f));
+
             //If enough time has passed then do everything required to generate the next frame.
             if (timeDeltaFloat >= dT) {
                 //Store the new time for the next frame.
                 time1 = time2;
 
+                PROFILE_FRAME_BEGIN();
+                AllocationTracker::beginFrame();
                 processEvents(renderer, running);
                 update(renderer, dT);
-                draw(renderer);
+
+                //Only redraw a static screen when something on it changed.
+                if (gameState == GameState::playing || redrawRequired || ui->isNotificationActive()) {
+                    draw(renderer);
+                    redrawRequired = false;
+                }
+                AllocationTracker::endFrame(gameState == GameState::playing);
+                PROFILE_FRAME_END();
             }
         }
     }
@@ -78,6 +103,17 @@ Game::~Game() {
         TTF_CloseFont(font);
         font = nullptr;
     }
+    if (pathPreview.texture != nullptr) {
+        SDL_DestroyTexture(pathPreview.texture);
+        pathPreview.texture = nullptr;
+    }
+    if (pathPreview.textureLabel != nullptr) {
+        SDL_DestroyTexture(pathPreview.textureLabel);
+        pathPreview.textureLabel = nullptr;
+    }
+#ifdef CITYDEFENSE_PROFILE
+    Profiler::destroyOverlay();
+#endif
     TextureLoader::deallocateTextures();
     SoundLoader::deallocateSounds();
 }
@@ -85,11 +121,17 @@ Game::~Game() {
 
 
 void Game::processEvents(SDL_Renderer* renderer, bool& running) {
+    PROFILE_SCOPE("processEvents");
+    ALLOCATION_TAG(AllocationTag::game);
     bool mouseDownThisFrame = false;
 
     //Process events.
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
+        //Mouse motion only matters to static screens when it changes a button's hover state.
+        if (event.type != SDL_MOUSEMOTION)
+            redrawRequired = true;
+
         switch (event.type) {
         case SDL_QUIT:
             running = false;
@@ -111,7 +153,7 @@ void Game::processEvents(SDL_Renderer* renderer, bool& running) {
                             mouseX <= startButton.rect.x + startButton.rect.w &&
                             mouseY >= startButton.rect.y && 
                             mouseY <= startButton.rect.y + startButton.rect.h) {
-                            gameState = GameState::playing;
+                            setGameState(GameState::playing);
                             instructionsVisible = false;  // Hide instructions when starting game
                             mouseDownStatus = 0;  // Reset mouse status to prevent wall placement
                             break;  // Skip further processing
@@ -143,16 +185,14 @@ void Game::processEvents(SDL_Renderer* renderer, bool& running) {
                 int mouseX = event.motion.x;
                 int mouseY = event.motion.y;
                 
-                if (gameState == GameState::instructions) {
-                    startButton.hover = (mouseX >= startButton.rect.x && 
-                                       mouseX <= startButton.rect.x + startButton.rect.w &&
-                                       mouseY >= startButton.rect.y && 
-                                       mouseY <= startButton.rect.y + startButton.rect.h);
-                } else {
-                    tryAgainButton.hover = (mouseX >= tryAgainButton.rect.x && 
-                                          mouseX <= tryAgainButton.rect.x + tryAgainButton.rect.w &&
-                                          mouseY >= tryAgainButton.rect.y && 
-                                          mouseY <= tryAgainButton.rect.y + tryAgainButton.rect.h);
+                Button& button = (gameState == GameState::instructions) ? startButton : tryAgainButton;
+                bool hover = (mouseX >= button.rect.x && 
+                              mouseX <= button.rect.x + button.rect.w &&
+                              mouseY >= button.rect.y && 
+                              mouseY <= button.rect.y + button.rect.h);
+                if (hover != button.hover) {
+                    button.hover = hover;
+                    redrawRequired = true;
                 }
             }
             break;
@@ -176,6 +216,19 @@ void Game::processEvents(SDL_Renderer* renderer, bool& running) {
             case SDL_SCANCODE_H:
                 ui->toggleGameState();
                 break;
+#ifdef CITYDEFENSE_PROFILE
+                //Show/hide the frame profiler
+            case SDL_SCANCODE_P:
+                Profiler::toggleOverlay();
+                break;
+                //Write a trace of everything recorded so far
+            case SDL_SCANCODE_T: {
+                char filename[64];
+                SDL_snprintf(filename, sizeof(filename), "trace-%u.json", SDL_GetTicks());
+                TraceRecorder::writeFile(filename);
+                break;
+            }
+#endif
                 //Show/hide the instructions
             case SDL_SCANCODE_I:
                 instructionsVisible = !instructionsVisible;
@@ -192,13 +245,9 @@ void Game::processEvents(SDL_Renderer* renderer, bool& running) {
     Vector2D posMouse((float)mouseX / tileSize, (float)mouseY / tileSize);
 
     if (mouseDownStatus > 0 && gameState == GameState::playing) {  // Only process placement in playing state
-        // Calculate center position and tile coordinates
-        int centerX = windowWidth / (2 * tileSize);
-        int centerY = windowHeight / (2 * tileSize);
+        // Calculate tile coordinates
         int tileX = (int)posMouse.x;
         int tileY = (int)posMouse.y;
-        bool isAdjacentToCenter = (abs(tileX - centerX) <= 1 && abs(tileY - centerY) <= 1);
-        int wallsAroundCenter = 0;
 
         switch (mouseDownStatus) {
         case SDL_BUTTON_LEFT:
@@ -209,26 +258,15 @@ void Game::processEvents(SDL_Renderer* renderer, bool& running) {
                     break;
                 }
                 
-                // Count existing walls around center
-                for (int x = centerX - 1; x <= centerX + 1; x++) {
-                    for (int y = centerY - 1; y <= centerY + 1; y++) {
-                        if (level.isTileWall(x, y)) {
-                            wallsAroundCenter++;
-                        }
-                    }
-                }
-                
-                // Don't allow placement if it would create a complete barrier
-                if (isAdjacentToCenter && wallsAroundCenter >= 7) {
+                // Don't allow placement if it would cut a spawner off from the city
+                if (!level.canPlaceWall(tileX, tileY)) {
                     ui->showNotification("Cannot block access to city!");
                     break;
                 }
                 
                 //Add wall at the mouse position.
-                if (!level.isTileWall(tileX, tileY)) {
-                    level.setTileWall(tileX, tileY, true);
+                if (level.setTileWall(tileX, tileY, true))
                     resourceManager.decrementWalls();
-                }
                 break;
             case PlacementMode::turret:
                 //Add the selected turret at the mouse position.
@@ -240,10 +278,8 @@ void Game::processEvents(SDL_Renderer* renderer, bool& running) {
 
         case SDL_BUTTON_RIGHT:
             //Remove wall at the mouse position.
-            if (level.isTileWall(tileX, tileY)) {
-                level.setTileWall(tileX, tileY, false);
+            if (level.setTileWall(tileX, tileY, false))
                 resourceManager.incrementWalls();
-            }
             //Remove turrets at the mouse position.
             removeTurretsAtMousePosition(posMouse);
             break;
@@ -254,77 +290,45 @@ void Game::processEvents(SDL_Renderer* renderer, bool& running) {
 
 
 void Game::update(SDL_Renderer* renderer, float dT) {
-    // Update notification timer
+    PROFILE_SCOPE("update");
+    ALLOCATION_TAG(AllocationTag::game);
+    // Update notification timer, and clear it off static screens once it expires
+    bool notificationWasActive = ui->isNotificationActive();
     ui->updateNotification(dT);
+    if (notificationWasActive && !ui->isNotificationActive())
+        redrawRequired = true;
 
     // Only update game if still playing
     if (gameState == GameState::playing) {
-        //Update the units.
-        updateUnits(dT);
-
-        //Update the turrets.
-        for (auto& turretSelected : listTurrets)
-            turretSelected.update(renderer, dT, listUnits, listProjectiles);
-
-        //Update the projectiles.
-        updateProjectiles(dT);
+        //Update the level, units, turrets and projectiles.
+        int unitsReachedTargetCount = Simulation::update(renderer, dT, level, crowdField,
+            listUnits, listTurrets, listProjectiles);
+
+        // Each enemy that reaches target reduces health by 5
+        if (unitsReachedTargetCount > 0) {
+            cityHealth -= 5 * unitsReachedTargetCount;
+            if (cityHealth <= 0) {
+                setGameState(GameState::gameOver);
+            }
+        }
 
         updateSpawnUnitsIfRequired(renderer, dT);
 
         // Check win condition
         if (currentRound >= maxRounds && listUnits.empty()) {
-            gameState = GameState::victory;
-        }
-    }
-}
-
-
-void Game::updateUnits(float dT) {
-    //Loop through the list of units and update all of them.
-    auto it = listUnits.begin();
-    while (it != listUnits.end()) {
-        bool increment = true;
-
-        if ((*it) != nullptr) {
-            (*it)->update(dT, level, listUnits);
-
-            // If unit reached target, reduce city health
-            if ((*it)->reachedTarget()) {
-                cityHealth -= 5; // Each enemy that reaches target reduces health by 5
-                if (cityHealth <= 0) {
-                    gameState = GameState::gameOver;
-                }
-            }
-
-            //Check if the unit is still alive. If not then erase it and don't increment the iterator.
-            if ((*it)->isAlive() == false) {
-                it = listUnits.erase(it);
-                increment = false;
-            }
+            setGameState(GameState::victory);
         }
-
-        if (increment)
-            it++;
     }
-}
-
-
-void Game::updateProjectiles(float dT) {
-    //Loop through the list of projectiles and update all of them.
-    auto it = listProjectiles.begin();
-    while (it != listProjectiles.end()) {
-        (*it).update(dT, listUnits);
-
-        //Check if the projectile has collided or not, erase it if needed, and update the iterator.
-        if ((*it).getCollisionOccurred())
-            it = listProjectiles.erase(it);
-        else
-            it++;
+    else {
+        //Carry on with any flow field rebuild between rounds, so walls placed there take effect.
+        level.updateFlowField();
     }
 }
 
 
 void Game::updateSpawnUnitsIfRequired(SDL_Renderer* renderer, float dT) {
+    PROFILE_SCOPE("updateSpawnUnits");
+    ALLOCATION_TAG(AllocationTag::spawning);
     spawnTimer.countDown(dT);
 
     //Check if the round needs to start.
@@ -354,7 +358,9 @@ void Game::updateSpawnUnitsIfRequired(SDL_Renderer* renderer, float dT) {
 
     //Add a unit if needed.
     if (spawnUnitCount > 0 && spawnTimer.timeSIsZero()) {
-        addUnit(renderer, level.getRandomEnemySpawnerLocation());
+        int enemySpawnerID = level.getRandomEnemySpawner();
+        addUnit(renderer, level.getEnemySpawnerLocation(enemySpawnerID));
+        listUnits.back()->setEnemySpawnerID(enemySpawnerID);
 
         //Play the spawn unit sound.
         if (mix_ChunkSpawnUnit != nullptr)
@@ -367,6 +373,8 @@ void Game::updateSpawnUnitsIfRequired(SDL_Renderer* renderer, float dT) {
 
 
 void Game::draw(SDL_Renderer* renderer) {
+    PROFILE_SCOPE("draw");
+    ALLOCATION_TAG(AllocationTag::game);
     //Draw.
     //Set the draw color to white.
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
@@ -378,18 +386,22 @@ void Game::draw(SDL_Renderer* renderer) {
     //Draw the level.
     level.draw(renderer, tileSize);
 
-    //Draw the enemy units.
-    for (auto& unitSelected : listUnits)
-        if (unitSelected != nullptr)
-            unitSelected->draw(renderer, tileSize);
+    {
+        PROFILE_SCOPE("drawEntities");
 
-    //Draw the turrets.
-    for (auto& turretSelected : listTurrets)
-        turretSelected.draw(renderer, tileSize);
+        //Draw the enemy units.
+        for (auto& unitSelected : listUnits)
+            if (unitSelected != nullptr)
+                unitSelected->draw(renderer, tileSize);
 
-    //Draw the projectiles.
-    for (auto& projectileSelected : listProjectiles)
-        projectileSelected.draw(renderer, tileSize);
+        //Draw the turrets.
+        for (auto& turretSelected : listTurrets)
+            turretSelected.draw(renderer, tileSize);
+
+        //Draw the projectiles.
+        for (auto& projectileSelected : listProjectiles)
+            projectileSelected.draw(renderer, tileSize);
+    }
     
     // Draw placement preview
     int mouseX = 0, mouseY = 0;
@@ -398,37 +410,12 @@ void Game::draw(SDL_Renderer* renderer) {
     drawPlacementPreview(renderer, mousePos);
 
     //Draw the overlay.
-    if (textureOverlay != nullptr && overlayVisible) {
-        int w = 0, h = 0;
-        SDL_QueryTexture(textureOverlay, NULL, NULL, &w, &h);
-        SDL_Rect rect = { 40, 40, w, h };
-        SDL_RenderCopy(renderer, textureOverlay, NULL, &rect);
-    }
+    if (textureOverlay != nullptr && overlayVisible)
+        SDL_RenderCopy(renderer, textureOverlay, NULL, &rectOverlay);
 
     // Draw instructions overlay
-    if (textureInstructions != nullptr && instructionsVisible) {
-        int w = 0, h = 0;
-        SDL_QueryTexture(textureInstructions, NULL, NULL, &w, &h);
-        
-        // Calculate scaling to fit the screen while maintaining aspect ratio
-        float scale = std::min(
-            (float)(windowWidth - 80) / w,  // Leave 40px padding on each side
-            (float)(windowHeight - 120) / h  // Leave 40px padding top and 80px bottom for button
-        );
-        
-        int scaledW = (int)(w * scale);
-        int scaledH = (int)(h * scale);
-        
-        // Center the image on screen
-        SDL_Rect rect = {
-            (windowWidth - scaledW) / 2,
-            (windowHeight - scaledH) / 2 - 20,  // Slightly above center to make room for button
-            scaledW,
-            scaledH
-        };
-        
-        SDL_RenderCopy(renderer, textureInstructions, NULL, &rect);
-    }
+    if (textureInstructions != nullptr && instructionsVisible)
+        SDL_RenderCopy(renderer, textureInstructions, NULL, &rectInstructions);
 
     // Draw game state using UI class
     ui->drawGameState(renderer, cityHealth, maxCityHealth, currentRound, maxRounds,
@@ -443,29 +430,8 @@ void Game::draw(SDL_Renderer* renderer) {
     if (gameState != GameState::playing) {
         if (gameState == GameState::instructions) {
             // Draw instructions
-            if (textureInstructions != nullptr) {
-                int w = 0, h = 0;
-                SDL_QueryTexture(textureInstructions, NULL, NULL, &w, &h);
-                
-                // Calculate scaling to fit the screen while maintaining aspect ratio
-                float scale = std::min(
-                    (float)(windowWidth - 80) / w,  // Leave 40px padding on each side
-                    (float)(windowHeight - 120) / h  // Leave 40px padding top and 80px bottom for button
-                );
-                
-                int scaledW = (int)(w * scale);
-                int scaledH = (int)(h * scale);
-                
-                // Center the image on screen
-                SDL_Rect rect = {
-                    (windowWidth - scaledW) / 2,
-                    (windowHeight - scaledH) / 2 - 20,  // Slightly above center to make room for button
-                    scaledW,
-                    scaledH
-                };
-                
-                SDL_RenderCopy(renderer, textureInstructions, NULL, &rect);
-            }
+            if (textureInstructions != nullptr)
+                SDL_RenderCopy(renderer, textureInstructions, NULL, &rectInstructions);
 
             // Draw Start Game button
             if (startButton.texture != nullptr) {
@@ -484,29 +450,9 @@ void Game::draw(SDL_Renderer* renderer) {
             }
         } else {
             SDL_Texture* endScreenTexture = (gameState == GameState::victory) ? textureWin : textureGameOver;
-            if (endScreenTexture != nullptr) {
-                int w = 0, h = 0;
-                SDL_QueryTexture(endScreenTexture, NULL, NULL, &w, &h);
-                
-                // Calculate scaling to fit the screen while maintaining aspect ratio
-                float scale = std::min(
-                    (float)windowWidth / w,
-                    (float)windowHeight / h
-                );
-                
-                int scaledW = (int)(w * scale);
-                int scaledH = (int)(h * scale);
-                
-                // Center the image on screen
-                SDL_Rect rect = {
-                    (windowWidth - scaledW) / 2,
-                    (windowHeight - scaledH) / 2,
-                    scaledW,
-                    scaledH
-                };
-                
-                SDL_RenderCopy(renderer, endScreenTexture, NULL, &rect);
-            }
+            const SDL_Rect& endScreenRect = (gameState == GameState::victory) ? rectWin : rectGameOver;
+            if (endScreenTexture != nullptr)
+                SDL_RenderCopy(renderer, endScreenTexture, NULL, &endScreenRect);
 
             // Draw Try Again button
             if (tryAgainButton.texture != nullptr) {
@@ -526,8 +472,16 @@ void Game::draw(SDL_Renderer* renderer) {
         }
     }
 
+#ifdef CITYDEFENSE_PROFILE
+    PROFILE_COUNTER("HUD text rebuilt", ui->getElementsRebuiltLastFrame());
+    Profiler::drawOverlay(renderer, font);
+#endif
+
     //Send the image to the window.
-    SDL_RenderPresent(renderer);
+    {
+        PROFILE_SCOPE("SDL_RenderPresent");
+        SDL_RenderPresent(renderer);
+    }
 }
 
 
@@ -576,12 +530,152 @@ void Game::drawPlacementPreview(SDL_Renderer* renderer, Vector2D mousePos) {
     };
 
     if (placementModeCurrent == PlacementMode::wall) {
+        updatePathPreview(renderer, tileX, tileY);
+        if (pathPreview.texture != nullptr)
+            SDL_RenderCopy(renderer, pathPreview.texture, NULL, NULL);
+
+        //Red for a wall that would cut the city off.
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        if (pathPreview.isBlocked)
+            SDL_SetRenderDrawColor(renderer, 255, 0, 0, 128);
+        else
+            SDL_SetRenderDrawColor(renderer, 0, 255, 0, 128);
         SDL_RenderFillRect(renderer, &previewRect);
     } else if (placementModeCurrent == PlacementMode::turret) {
         SDL_RenderDrawRect(renderer, &previewRect);
     }
 }
 
+void Game::updatePathPreview(SDL_Renderer* renderer, int tileX, int tileY) {
+    //The same tile of an unchanged level previews the same way, so only moving to another tile or
+    //editing the level costs a search and a redraw.
+    unsigned int levelVersion = level.getVersion();
+    if (tileX == pathPreview.tileX && tileY == pathPreview.tileY && levelVersion == pathPreview.levelVersion)
+        return;
+    PROFILE_SCOPE("updatePathPreview");
+    pathPreview.tileX = tileX;
+    pathPreview.tileY = tileY;
+    pathPreview.levelVersion = levelVersion;
+    pathPreview.isBlocked = (level.canPlaceWall(tileX, tileY) == false);
+
+    if (pathPreview.texture == nullptr) {
+        pathPreview.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+            windowWidth, windowHeight);
+        if (pathPreview.texture == nullptr) {
+            LOG_WARNING(LogModule::game, "Failed to create the path preview texture: %s", SDL_GetError());
+            return;
+        }
+        SDL_SetTextureBlendMode(pathPreview.texture, SDL_BLENDMODE_BLEND);
+    }
+
+    float lengthDelta = 0.0f;
+    bool isRouteFound = (pathPreview.isBlocked == false &&
+        level.previewWall(tileX, tileY, pathPreview.listRouteTiles, pathPreview.listRouteEnds, lengthDelta));
+
+    SDL_Texture* textureTargetPrevious = SDL_GetRenderTarget(renderer);
+    SDL_SetRenderTarget(renderer, pathPreview.texture);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+
+    if (isRouteFound) {
+        //A line through the middle of each route's tiles, with a dot on each tile.
+        int tileCountX = windowWidth / tileSize;
+        int dotSize = tileSize / 8;
+        SDL_SetRenderDrawColor(renderer, 255, 160, 0, 200);
+        int routeBegin = 0;
+        for (int routeEnd : pathPreview.listRouteEnds) {
+            for (int count = routeBegin; count < routeEnd; count++) {
+                int index = pathPreview.listRouteTiles[count];
+                int centerX = (index % tileCountX) * tileSize + tileSize / 2;
+                int centerY = (index / tileCountX) * tileSize + tileSize / 2;
+                SDL_Rect rectDot = { centerX - dotSize / 2, centerY - dotSize / 2, dotSize, dotSize };
+                SDL_RenderFillRect(renderer, &rectDot);
+
+                if (count > routeBegin) {
+                    int indexPrevious = pathPreview.listRouteTiles[count - 1];
+                    SDL_RenderDrawLine(renderer,
+                        (indexPrevious % tileCountX) * tileSize + tileSize / 2,
+                        (indexPrevious / tileCountX) * tileSize + tileSize / 2,
+                        centerX, centerY);
+                }
+            }
+            routeBegin = routeEnd;
+        }
+
+        //How much further the enemies would have to walk, next to the hovered tile.
+        if (font != nullptr) {
+            char text[32];
+            if (lengthDelta > 0.0f)
+                SDL_snprintf(text, sizeof(text), "+%.1f tiles", lengthDelta);
+            else
+                SDL_snprintf(text, sizeof(text), "No change");
+            if (pathPreview.textureLabel == nullptr || SDL_strcmp(text, pathPreview.labelText) != 0) {
+                if (pathPreview.textureLabel != nullptr) {
+                    SDL_DestroyTexture(pathPreview.textureLabel);
+                    pathPreview.textureLabel = nullptr;
+                }
+                SDL_Surface* surface = TTF_RenderText_Solid(font, text, SDL_Color{ 255, 255, 255, 255 });
+                if (surface != nullptr) {
+                    pathPreview.textureLabel = SDL_CreateTextureFromSurface(renderer, surface);
+                    pathPreview.labelWidth = surface->w;
+                    pathPreview.labelHeight = surface->h;
+                    SDL_strlcpy(pathPreview.labelText, text, sizeof(pathPreview.labelText));
+                    SDL_FreeSurface(surface);
+                }
+            }
+
+            if (pathPreview.textureLabel != nullptr) {
+                SDL_Rect rectText = { (tileX + 1) * tileSize + 4, tileY * tileSize,
+                    pathPreview.labelWidth, pathPreview.labelHeight };
+                rectText.x = std::min(rectText.x, windowWidth - rectText.w);
+                SDL_RenderCopy(renderer, pathPreview.textureLabel, NULL, &rectText);
+            }
+        }
+    }
+
+    SDL_SetRenderTarget(renderer, textureTargetPrevious);
+}
+
+void Game::calculateScreenLayouts() {
+    if (textureOverlay != nullptr) {
+        int w = 0, h = 0;
+        SDL_QueryTexture(textureOverlay, NULL, NULL, &w, &h);
+        rectOverlay = { 40, 40, w, h };
+    }
+
+    // Leave 40px padding on each side, 40px on top and 80px at the bottom for the button,
+    // and sit slightly above center to make room for it
+    rectInstructions = calculateFittedRect(textureInstructions, 80, 120, -20);
+
+    // The end screens fill the window
+    rectWin = calculateFittedRect(textureWin, 0, 0, 0);
+    rectGameOver = calculateFittedRect(textureGameOver, 0, 0, 0);
+}
+
+SDL_Rect Game::calculateFittedRect(SDL_Texture* texture, int paddingX, int paddingY, int offsetY) const {
+    int w = 0, h = 0;
+    if (texture == nullptr || SDL_QueryTexture(texture, NULL, NULL, &w, &h) != 0 || w <= 0 || h <= 0)
+        return SDL_Rect{ 0, 0, 0, 0 };
+
+    // Calculate scaling to fit the screen while maintaining aspect ratio
+    float scale = std::min(
+        (float)(windowWidth - paddingX) / w,
+        (float)(windowHeight - paddingY) / h
+    );
+
+    int scaledW = (int)(w * scale);
+    int scaledH = (int)(h * scale);
+
+    // Center the image on screen
+    return SDL_Rect{
+        (windowWidth - scaledW) / 2,
+        (windowHeight - scaledH) / 2 + offsetY,
+        scaledW,
+        scaledH
+    };
+}
+
 void Game::createTryAgainButton(SDL_Renderer* renderer) {
     if (font == nullptr) return;
 
@@ -622,9 +716,16 @@ void Game::createStartButton(SDL_Renderer* renderer) {
     }
 }
 
+void Game::setGameState(GameState gameStateNew) {
+    if (gameState != gameStateNew) {
+        gameState = gameStateNew;
+        redrawRequired = true;
+    }
+}
+
 void Game::resetGame(SDL_Renderer* renderer) {
     // Reset game state
-    gameState = GameState::playing;
+    setGameState(GameState::playing);
     cityHealth = maxCityHealth;
     currentRound = 0;
     spawnUnitCount = 0;
@@ -12,6 +12,7 @@
 #include "Level.h"
 #include "Timer.h"
 #include "ResourceManager.h"
+#include "AssetIndex.h"
 #include "UI.h"
 
 class Game
@@ -50,8 +51,6 @@ public:
 private:
 	void processEvents(SDL_Renderer* renderer, bool& running);
 	void update(SDL_Renderer* renderer, float dT);
-	void updateUnits(float dT);
-	void updateProjectiles(float dT);
 	void updateSpawnUnitsIfRequired(SDL_Renderer* renderer, float dT);
 	void draw(SDL_Renderer* renderer);
 	void addUnit(SDL_Renderer* renderer, Vector2D posMouse);
@@ -59,16 +58,29 @@ private:
 	void removeTurretsAtMousePosition(Vector2D posMouse);
 	void drawGameState(SDL_Renderer* renderer);
 	void drawPlacementPreview(SDL_Renderer* renderer, Vector2D mousePos);
+	void updatePathPreview(SDL_Renderer* renderer, int tileX, int tileY);
 	void resetGame(SDL_Renderer* renderer);
+	void setGameState(GameState gameStateNew);
 	void createTryAgainButton(SDL_Renderer* renderer);
 	void createStartButton(SDL_Renderer* renderer);
+	void calculateScreenLayouts();
+	SDL_Rect calculateFittedRect(SDL_Texture* texture, int paddingX, int paddingY, int offsetY) const;
 	void showNotification(const std::string& message);
 	void drawNotification(SDL_Renderer* renderer);
 
 	int mouseDownStatus = 0;
 
+	//Static screens are only redrawn after something visible changes.
+	bool redrawRequired = true;
+	static const int idleWaitTimeoutMs = 500;
+
+	//How long a frame may spend on a flow field rebuild after walls change.
+	static const int flowFieldBudgetMicroseconds = 2000;
+
 	const int tileSize = 64;
 	Level level;
+	//How crowded the map is, rebuilt from the units every tick.
+	CrowdField crowdField;
 
 	int windowWidth = 0;
 	int windowHeight = 0;
@@ -85,6 +97,12 @@ private:
 	SDL_Texture* textureInstructions = nullptr;
 	bool instructionsVisible = true;
 
+	//Screen layouts only depend on the texture and window sizes, so they're computed once.
+	SDL_Rect rectOverlay = { 0, 0, 0, 0 };
+	SDL_Rect rectInstructions = { 0, 0, 0, 0 };
+	SDL_Rect rectWin = { 0, 0, 0, 0 };
+	SDL_Rect rectGameOver = { 0, 0, 0, 0 };
+
 	Timer spawnTimer, roundTimer;
 	int spawnUnitCount = 0;
 	int currentRound = 0;
@@ -102,6 +120,20 @@ private:
 
 	Mix_Chunk* mix_ChunkSpawnUnit = nullptr;
 
+	//The enemy routes with a wall on the hovered tile, drawn into a texture that's only redrawn
+	//when the hovered tile or the level changes.  The route lists keep their memory between tiles.
+	struct PathPreview {
+		int tileX = -1, tileY = -1;
+		unsigned int levelVersion = 0;
+		bool isBlocked = false;
+		std::vector<int> listRouteTiles, listRouteEnds;
+		SDL_Texture* texture = nullptr;
+		//The length label, which is only rendered again when its text changes.
+		char labelText[32] = {};
+		SDL_Texture* textureLabel = nullptr;
+		int labelWidth = 0, labelHeight = 0;
+	} pathPreview;
+
 	TTF_Font* font = nullptr;
 	std::string currentBackground;
 };
\ No newline at end of file
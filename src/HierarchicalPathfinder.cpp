@@ -0,0 +1,647 @@
+#include "HierarchicalPathfinder.h"
+#include <algorithm>
+#include <functional>
+#include "Level.h"
+#include "Profiler.h"
+#include "AllocationTracker.h"
+
+
+
+
+HierarchicalPathfinder::HierarchicalPathfinder(const Level& level) :
+	level(level),
+	clusterCountX((level.tileCountX + clusterSize - 1) / clusterSize),
+	clusterCountY((level.tileCountY + clusterSize - 1) / clusterSize) {
+	size_t clusterCount = (size_t)clusterCountX * clusterCountY;
+	listClusters.resize(clusterCount);
+	listBordersVertical.resize(clusterCount);
+	listBordersHorizontal.resize(clusterCount);
+	listSearchDistances.resize(clusterSize * clusterSize);
+}
+
+
+
+void HierarchicalPathfinder::rebuild() {
+	PROFILE_SCOPE("HierarchicalPathfinder::rebuild");
+	ALLOCATION_TAG(AllocationTag::level);
+
+	flowFieldCount = level.flowFieldCount;
+
+	for (int clusterY = 0; clusterY < clusterCountY; clusterY++) {
+		for (int clusterX = 0; clusterX < clusterCountX; clusterX++) {
+			calculateEntrances(clusterX, clusterY, true);
+			calculateEntrances(clusterX, clusterY, false);
+		}
+	}
+
+	assignNodes();
+
+	for (int clusterIndex = 0; clusterIndex < (int)listClusters.size(); clusterIndex++)
+		calculateClusterEdges(clusterIndex);
+
+	calculateNodeDistances();
+}
+
+
+void HierarchicalPathfinder::updateTile(int x, int y) {
+	PROFILE_SCOPE("HierarchicalPathfinder::updateTile");
+	ALLOCATION_TAG(AllocationTag::level);
+
+	if (x < 0 || x >= level.tileCountX || y < 0 || y >= level.tileCountY)
+		return;
+
+	int clusterX = x / clusterSize;
+	int clusterY = y / clusterSize;
+	int localX = x % clusterSize;
+	int localY = y % clusterSize;
+
+	//The tile's own cluster always needs new edges, and so does the cluster across any border
+	//the tile sits on if that border's entrances changed.
+	int listClustersChanged[3] = { clusterX + clusterY * clusterCountX };
+	int clusterChangedCount = 1;
+	const Border* listBordersChanged[2];
+	int borderChangedCount = 0;
+
+	auto checkBorder = [&](int borderClusterX, int borderClusterY, bool isVertical, int clusterIndexOther) {
+		if (calculateEntrances(borderClusterX, borderClusterY, isVertical)) {
+			listBordersChanged[borderChangedCount++] = &(isVertical ? listBordersVertical : listBordersHorizontal)[
+				borderClusterX + borderClusterY * clusterCountX];
+			listClustersChanged[clusterChangedCount++] = clusterIndexOther;
+		}
+	};
+	if (localX == clusterSize - 1 && clusterX + 1 < clusterCountX)
+		checkBorder(clusterX, clusterY, true, (clusterX + 1) + clusterY * clusterCountX);
+	else if (localX == 0 && clusterX > 0)
+		checkBorder(clusterX - 1, clusterY, true, (clusterX - 1) + clusterY * clusterCountX);
+	if (localY == clusterSize - 1 && clusterY + 1 < clusterCountY)
+		checkBorder(clusterX, clusterY, false, clusterX + (clusterY + 1) * clusterCountX);
+	else if (localY == 0 && clusterY > 0)
+		checkBorder(clusterX, clusterY - 1, false, clusterX + (clusterY - 1) * clusterCountX);
+
+	//New entrances shift the IDs of every node numbered after them.
+	if (borderChangedCount > 0) {
+		for (auto* listBorders : { &listBordersVertical, &listBordersHorizontal })
+			for (auto& border : *listBorders)
+				border.nodeFirstPrevious = border.nodeFirst;
+		assignNodes();
+	}
+
+	for (int count = 0; count < clusterChangedCount; count++)
+		calculateClusterEdges(listClustersChanged[count]);
+
+	repairNodeDistances(listClustersChanged, clusterChangedCount, listBordersChanged, borderChangedCount);
+}
+
+
+
+Vector2D HierarchicalPathfinder::getFlowNormal(int x, int y, int flowFieldID) const {
+	if (x < 0 || x >= level.tileCountX || y < 0 || y >= level.tileCountY ||
+		flowFieldID < 0 || flowFieldID >= flowFieldCount)
+		return Vector2D();
+
+	int clusterIndex = (x / clusterSize) + (y / clusterSize) * clusterCountX;
+	int slot = listClusterLocalFields[flowFieldID * listClusters.size() + clusterIndex];
+	if (slot == -1)
+		slot = buildLocalField(clusterIndex, flowFieldID);
+
+	const LocalField& localField = listLocalFields[slot];
+	int indexLocal = (x % clusterSize) + (y % clusterSize) * clusterSize;
+	return Vector2D((float)localField.listDirectionsX[indexLocal], (float)localField.listDirectionsY[indexLocal]).normalize();
+}
+
+
+int HierarchicalPathfinder::getNodeCount() const {
+	return (int)listNodes.size();
+}
+
+
+int HierarchicalPathfinder::getLocalFieldCount() const {
+	return (int)(listLocalFields.size() - listLocalFieldsFree.size());
+}
+
+
+
+bool HierarchicalPathfinder::calculateEntrances(int clusterX, int clusterY, bool isVertical) {
+	int tileCountX = level.tileCountX;
+	int tileCountY = level.tileCountY;
+	if ((isVertical && clusterX + 1 >= clusterCountX) || (isVertical == false && clusterY + 1 >= clusterCountY))
+		return false;
+
+	//Walk along the border, with A the last row or column of this cluster and B the first of the next.
+	int indexFirstA, stepAlong, stepAcross, length;
+	if (isVertical) {
+		int y = clusterY * clusterSize;
+		indexFirstA = ((clusterX + 1) * clusterSize - 1) + y * tileCountX;
+		stepAlong = tileCountX;
+		stepAcross = 1;
+		length = std::min(clusterSize, tileCountY - y);
+	}
+	else {
+		int x = clusterX * clusterSize;
+		indexFirstA = x + ((clusterY + 1) * clusterSize - 1) * tileCountX;
+		stepAlong = 1;
+		stepAcross = tileCountX;
+		length = std::min(clusterSize, tileCountX - x);
+	}
+
+	//Every run of tiles that are open on both sides gets one entrance, at its middle.
+	listEntrancesScratch.clear();
+	int runStart = -1;
+	for (int count = 0; count <= length; count++) {
+		int indexA = indexFirstA + count * stepAlong;
+		bool isOpen = (count < length &&
+			level.listTiles[indexA].type != Level::TileType::wall &&
+			level.listTiles[indexA + stepAcross].type != Level::TileType::wall);
+
+		if (isOpen && runStart == -1)
+			runStart = count;
+		else if (isOpen == false && runStart != -1) {
+			int indexMiddleA = indexFirstA + ((runStart + count - 1) / 2) * stepAlong;
+			listEntrancesScratch.push_back({ indexMiddleA, indexMiddleA + stepAcross });
+			runStart = -1;
+		}
+	}
+
+	Border& border = (isVertical ? listBordersVertical : listBordersHorizontal)[clusterX + clusterY * clusterCountX];
+	if (border.listEntrances == listEntrancesScratch)
+		return false;
+
+	border.listEntrances = listEntrancesScratch;
+	return true;
+}
+
+
+void HierarchicalPathfinder::assignNodes() {
+	//Number the nodes border by border, so both sides of an entrance are next to each other.
+	listNodes.clear();
+	auto addNodes = [&](Border& border, int clusterIndexA, int clusterIndexB) {
+		border.nodeFirst = (int)listNodes.size();
+		for (const auto& entrance : border.listEntrances) {
+			int nodeA = (int)listNodes.size();
+			listNodes.push_back({ entrance.indexA, clusterIndexA, 0, nodeA + 1 });
+			listNodes.push_back({ entrance.indexB, clusterIndexB, 0, nodeA });
+		}
+	};
+	for (int clusterIndex = 0; clusterIndex < (int)listClusters.size(); clusterIndex++) {
+		addNodes(listBordersVertical[clusterIndex], clusterIndex, clusterIndex + 1);
+		addNodes(listBordersHorizontal[clusterIndex], clusterIndex, clusterIndex + clusterCountX);
+	}
+
+	//Then gather each cluster's nodes from its four borders.
+	for (int clusterY = 0; clusterY < clusterCountY; clusterY++) {
+		for (int clusterX = 0; clusterX < clusterCountX; clusterX++) {
+			int clusterIndex = clusterX + clusterY * clusterCountX;
+			Cluster& cluster = listClusters[clusterIndex];
+			cluster.listNodes.clear();
+
+			auto addBorder = [&](const Border& border, int side) {
+				for (size_t count = 0; count < border.listEntrances.size(); count++) {
+					int node = border.nodeFirst + 2 * (int)count + side;
+					listNodes[node].clusterNode = (int)cluster.listNodes.size();
+					cluster.listNodes.push_back(node);
+				}
+			};
+			if (clusterX > 0)
+				addBorder(listBordersVertical[clusterIndex - 1], 1);
+			addBorder(listBordersVertical[clusterIndex], 0);
+			if (clusterY > 0)
+				addBorder(listBordersHorizontal[clusterIndex - clusterCountX], 1);
+			addBorder(listBordersHorizontal[clusterIndex], 0);
+		}
+	}
+}
+
+
+void HierarchicalPathfinder::calculateClusterEdges(int clusterIndex) {
+	Cluster& cluster = listClusters[clusterIndex];
+	size_t nodeCount = cluster.listNodes.size();
+	cluster.listEdgeCosts.assign(nodeCount * nodeCount, Level::flowDistanceMax);
+	cluster.listTargetCosts.assign(flowFieldCount * nodeCount, Level::flowDistanceMax);
+
+	int originX = (clusterIndex % clusterCountX) * clusterSize;
+	int originY = (clusterIndex / clusterCountX) * clusterSize;
+	auto getIndexLocal = [&](int index) {
+		return (index % level.tileCountX - originX) + (index / level.tileCountX - originY) * clusterSize;
+	};
+
+	//Search out from each node, so the distance found at another node is the cost of walking
+	//from there to this one.
+	for (size_t nodeTo = 0; nodeTo < nodeCount; nodeTo++) {
+		listSearchSeeds.clear();
+		listSearchSeeds.push_back({ 0, getIndexLocal(listNodes[cluster.listNodes[nodeTo]].index) });
+		searchCluster(clusterIndex);
+
+		for (size_t nodeFrom = 0; nodeFrom < nodeCount; nodeFrom++)
+			cluster.listEdgeCosts[nodeTo * nodeCount + nodeFrom] =
+				listSearchDistances[getIndexLocal(listNodes[cluster.listNodes[nodeFrom]].index)];
+	}
+
+	//And from each group of targets in the cluster.
+	for (int flowFieldID = 0; flowFieldID < flowFieldCount; flowFieldID++) {
+		listSearchSeeds.clear();
+		addTargetSeeds(clusterIndex, flowFieldID);
+		if (listSearchSeeds.empty())
+			continue;
+
+		searchCluster(clusterIndex);
+		for (size_t node = 0; node < nodeCount; node++)
+			cluster.listTargetCosts[flowFieldID * nodeCount + node] =
+				listSearchDistances[getIndexLocal(listNodes[cluster.listNodes[node]].index)];
+	}
+}
+
+
+void HierarchicalPathfinder::calculateNodeDistances() {
+	PROFILE_SCOPE("HierarchicalPathfinder::calculateNodeDistances");
+
+	size_t nodeCount = listNodes.size();
+	listNodeDistances.assign(flowFieldCount * nodeCount, Level::flowDistanceMax);
+	listNodeNext.assign(flowFieldCount * nodeCount, nodeNextNone);
+	auto compare = std::greater<std::pair<unsigned int, int>>();
+
+	for (int flowFieldID = 0; flowFieldID < flowFieldCount; flowFieldID++) {
+		unsigned int* listDistances = listNodeDistances.data() + flowFieldID * nodeCount;
+
+		//Start from every node with a target in its own cluster.
+		listHeap.clear();
+		for (const auto& cluster : listClusters) {
+			size_t clusterNodeCount = cluster.listNodes.size();
+			for (size_t node = 0; node < clusterNodeCount; node++) {
+				unsigned int distance = cluster.listTargetCosts[flowFieldID * clusterNodeCount + node];
+				if (distance < listDistances[cluster.listNodes[node]]) {
+					listDistances[cluster.listNodes[node]] = distance;
+					listHeap.push_back({ distance, cluster.listNodes[node] });
+				}
+			}
+		}
+		std::make_heap(listHeap.begin(), listHeap.end(), compare);
+
+		searchNodes(flowFieldID);
+	}
+
+	//Every cached local field may be out of date.
+	size_t clusterCount = listClusters.size();
+	listClusterLocalFields.assign(flowFieldCount * clusterCount, -1);
+	listLocalFieldsFree.clear();
+	for (int slot = (int)listLocalFields.size() - 1; slot > -1; slot--)
+		listLocalFieldsFree.push_back(slot);
+}
+
+
+void HierarchicalPathfinder::repairNodeDistances(const int* listClustersChanged, int clusterChangedCount,
+	const Border* const* listBordersChanged, int borderChangedCount) {
+	PROFILE_SCOPE("HierarchicalPathfinder::repairNodeDistances");
+
+	//Only nodes whose path to the targets ran through a changed cluster can get longer, so only
+	//those are searched again, from their neighbors that kept their paths.  Paths that got shorter
+	//spread out from the changed clusters during the same search.
+	size_t nodeCount = listNodes.size();
+	size_t nodeCountPrevious = (flowFieldCount > 0 ? listNodeDistances.size() / flowFieldCount : 0);
+	listNodeDistancesPrevious.swap(listNodeDistances);
+	listNodeNextPrevious.swap(listNodeNext);
+	listNodeDistances.assign(flowFieldCount * nodeCount, Level::flowDistanceMax);
+	listNodeNext.assign(flowFieldCount * nodeCount, nodeNextBroken);
+
+	//Map the old node IDs to the new ones, which only differ if entrances changed.  Nodes on a
+	//changed border are new, and so are broken like anything that led to them.
+	listNodeRemap.resize(nodeCountPrevious);
+	if (borderChangedCount == 0) {
+		for (size_t node = 0; node < nodeCountPrevious; node++)
+			listNodeRemap[node] = (int)node;
+	}
+	else {
+		std::fill(listNodeRemap.begin(), listNodeRemap.end(), -1);
+		for (auto* listBorders : { &listBordersVertical, &listBordersHorizontal }) {
+			for (const auto& border : *listBorders) {
+				if (std::find(listBordersChanged, listBordersChanged + borderChangedCount, &border) !=
+					listBordersChanged + borderChangedCount)
+					continue;
+				for (int count = 0; count < 2 * (int)border.listEntrances.size(); count++)
+					listNodeRemap[border.nodeFirstPrevious + count] = border.nodeFirst + count;
+			}
+		}
+	}
+
+	auto isClusterChanged = [&](int clusterIndex) {
+		return std::find(listClustersChanged, listClustersChanged + clusterChangedCount, clusterIndex) !=
+			listClustersChanged + clusterChangedCount;
+	};
+	auto compare = std::greater<std::pair<unsigned int, int>>();
+	listClustersInvalid.assign(listClusters.size(), 0);
+	for (int count = 0; count < clusterChangedCount; count++)
+		listClustersInvalid[listClustersChanged[count]] = 1;
+
+	for (int flowFieldID = 0; flowFieldID < flowFieldCount; flowFieldID++) {
+		size_t planeOffset = flowFieldID * nodeCount;
+		size_t planeOffsetPrevious = flowFieldID * nodeCountPrevious;
+		unsigned int* listDistances = listNodeDistances.data() + planeOffset;
+		int* listNext = listNodeNext.data() + planeOffset;
+
+		for (size_t nodePrevious = 0; nodePrevious < nodeCountPrevious; nodePrevious++) {
+			int node = listNodeRemap[nodePrevious];
+			if (node == -1)
+				continue;
+
+			int nextPrevious = listNodeNextPrevious[planeOffsetPrevious + nodePrevious];
+			listDistances[node] = listNodeDistancesPrevious[planeOffsetPrevious + nodePrevious];
+			if (nextPrevious < 0)
+				listNext[node] = nextPrevious;
+			else
+				listNext[node] = (listNodeRemap[nextPrevious] == -1 ? nodeNextBroken : listNodeRemap[nextPrevious]);
+		}
+
+		//Follow each node's path until it reaches a node already sorted out, a target, or a 
+		//changed cluster, and mark the whole stretch the same way.
+		listNodeStates.assign(nodeCount, nodeStateUnknown);
+		for (size_t nodeFirst = 0; nodeFirst < nodeCount; nodeFirst++) {
+			int node = (int)nodeFirst;
+			char state;
+			while (true) {
+				if (listNodeStates[node] != nodeStateUnknown) {
+					state = listNodeStates[node];
+					break;
+				}
+				listNodeStack.push_back(node);
+				if (listNext[node] == nodeNextBroken || isClusterChanged(listNodes[node].cluster)) {
+					state = nodeStateDirty;
+					break;
+				}
+				if (listNext[node] == nodeNextNone) {
+					state = nodeStateClean;
+					break;
+				}
+				node = listNext[node];
+			}
+			for (int nodeStacked : listNodeStack)
+				listNodeStates[nodeStacked] = state;
+			listNodeStack.clear();
+		}
+
+		for (size_t node = 0; node < nodeCount; node++) {
+			if (listNodeStates[node] == nodeStateDirty) {
+				listDistances[node] = Level::flowDistanceMax;
+				listNext[node] = nodeNextNone;
+			}
+		}
+
+		//Seed each dirty node from its own cluster's targets and from its clean neighbors.
+		listHeap.clear();
+		for (size_t nodeDirty = 0; nodeDirty < nodeCount; nodeDirty++) {
+			if (listNodeStates[nodeDirty] != nodeStateDirty)
+				continue;
+
+			const Node& node = listNodes[nodeDirty];
+			const Cluster& cluster = listClusters[node.cluster];
+			size_t clusterNodeCount = cluster.listNodes.size();
+			unsigned int distanceBest = cluster.listTargetCosts[flowFieldID * clusterNodeCount + node.clusterNode];
+			int nextBest = nodeNextNone;
+
+			auto consider = [&](int nodeNeighbor, unsigned int cost) {
+				if (listNodeStates[nodeNeighbor] == nodeStateClean && cost != Level::flowDistanceMax &&
+					listDistances[nodeNeighbor] != Level::flowDistanceMax &&
+					listDistances[nodeNeighbor] + cost < distanceBest) {
+					distanceBest = listDistances[nodeNeighbor] + cost;
+					nextBest = nodeNeighbor;
+				}
+			};
+			for (size_t nodeTo = 0; nodeTo < clusterNodeCount; nodeTo++)
+				consider(cluster.listNodes[nodeTo], cluster.listEdgeCosts[nodeTo * clusterNodeCount + node.clusterNode]);
+			consider(node.partner, Level::flowStepStraight * level.listTiles[node.index].cost);
+
+			if (distanceBest != Level::flowDistanceMax) {
+				listDistances[nodeDirty] = distanceBest;
+				listNext[nodeDirty] = nextBest;
+				listHeap.push_back({ distanceBest, (int)nodeDirty });
+			}
+		}
+		std::make_heap(listHeap.begin(), listHeap.end(), compare);
+
+		searchNodes(flowFieldID);
+
+		//Drop the local fields of clusters whose nodes' distances changed, and of the clusters 
+		//across from them, whose exits point at those nodes.
+		for (size_t nodePrevious = 0; nodePrevious < nodeCountPrevious; nodePrevious++) {
+			int node = listNodeRemap[nodePrevious];
+			if (node != -1 && listDistances[node] != listNodeDistancesPrevious[planeOffsetPrevious + nodePrevious]) {
+				listClustersInvalid[listNodes[node].cluster] = 1;
+				listClustersInvalid[listNodes[listNodes[node].partner].cluster] = 1;
+			}
+		}
+	}
+
+	size_t clusterCount = listClusters.size();
+	for (int flowFieldID = 0; flowFieldID < flowFieldCount; flowFieldID++) {
+		for (size_t clusterIndex = 0; clusterIndex < clusterCount; clusterIndex++) {
+			int& slot = listClusterLocalFields[flowFieldID * clusterCount + clusterIndex];
+			if (slot != -1 && listClustersInvalid[clusterIndex]) {
+				listLocalFieldsFree.push_back(slot);
+				slot = -1;
+			}
+		}
+	}
+}
+
+
+void HierarchicalPathfinder::searchNodes(int flowFieldID) {
+	//Dijkstra over the abstract graph from what's in the heap, where a node's neighbors are the
+	//other nodes of its cluster and its partner across the border.  Each node remembers the next
+	//node on its path, which is always one that was settled before it.
+	size_t nodeCount = listNodes.size();
+	unsigned int* listDistances = listNodeDistances.data() + flowFieldID * nodeCount;
+	int* listNext = listNodeNext.data() + flowFieldID * nodeCount;
+	auto compare = std::greater<std::pair<unsigned int, int>>();
+
+	while (listHeap.empty() == false) {
+		std::pop_heap(listHeap.begin(), listHeap.end(), compare);
+		unsigned int distance = listHeap.back().first;
+		int nodeCurrent = listHeap.back().second;
+		listHeap.pop_back();
+		if (distance > listDistances[nodeCurrent])
+			continue;
+
+		auto relax = [&](int node, unsigned int cost) {
+			if (cost != Level::flowDistanceMax && distance + cost < listDistances[node]) {
+				listDistances[node] = distance + cost;
+				listNext[node] = nodeCurrent;
+				listHeap.push_back({ distance + cost, node });
+				std::push_heap(listHeap.begin(), listHeap.end(), compare);
+			}
+		};
+
+		const Node& node = listNodes[nodeCurrent];
+		const Cluster& cluster = listClusters[node.cluster];
+		size_t clusterNodeCount = cluster.listNodes.size();
+		const unsigned int* listEdgeCostsTo = cluster.listEdgeCosts.data() + node.clusterNode * clusterNodeCount;
+		for (size_t nodeFrom = 0; nodeFrom < clusterNodeCount; nodeFrom++)
+			relax(cluster.listNodes[nodeFrom], listEdgeCostsTo[nodeFrom]);
+
+		//Leaving the partner's tile to cross the border costs the partner's tile.
+		relax(node.partner, Level::flowStepStraight * level.listTiles[listNodes[node.partner].index].cost);
+	}
+}
+
+
+void HierarchicalPathfinder::searchCluster(int clusterIndex) const {
+	//Dial's algorithm inside one cluster, with the same step costs as the level's field.  The 
+	//seeds can be far apart, so they're sorted and only join the bucket ring when the sweep 
+	//reaches their distance, which keeps everything in the ring within one step of the sweep.
+	int originX = (clusterIndex % clusterCountX) * clusterSize;
+	int originY = (clusterIndex / clusterCountX) * clusterSize;
+	int width = std::min(clusterSize, level.tileCountX - originX);
+	int height = std::min(clusterSize, level.tileCountY - originY);
+	const unsigned int bucketCount = Level::tileCostMax * Level::flowStepStraight + 1;
+	if (listBuckets.size() != bucketCount)
+		listBuckets.resize(bucketCount);
+
+	std::fill(listSearchDistances.begin(), listSearchDistances.end(), Level::flowDistanceMax);
+	std::sort(listSearchSeeds.begin(), listSearchSeeds.end());
+
+	const int listNeighbors[][2] = { { -1, 0}, {1, 0}, {0, -1}, {0, 1} };
+	size_t seedNext = 0;
+	size_t openCount = 0;
+	unsigned int distanceCurrent = 0;
+	while (openCount > 0 || seedNext < listSearchSeeds.size()) {
+		if (openCount == 0)
+			distanceCurrent = std::max(distanceCurrent, listSearchSeeds[seedNext].first);
+
+		for (; seedNext < listSearchSeeds.size() && listSearchSeeds[seedNext].first == distanceCurrent; seedNext++) {
+			int indexLocal = listSearchSeeds[seedNext].second;
+			if (distanceCurrent < listSearchDistances[indexLocal]) {
+				listSearchDistances[indexLocal] = distanceCurrent;
+				listBuckets[distanceCurrent % bucketCount].push_back(indexLocal);
+				openCount++;
+			}
+		}
+
+		//Every step costs at least one, so nothing is added to this bucket while it's swept.
+		std::vector<int>& bucket = listBuckets[distanceCurrent % bucketCount];
+		openCount -= bucket.size();
+		for (int indexLocal : bucket) {
+			//Tiles that were moved to a closer bucket leave a stale entry behind.
+			if (listSearchDistances[indexLocal] != distanceCurrent)
+				continue;
+
+			int localX = indexLocal % clusterSize;
+			int localY = indexLocal / clusterSize;
+			for (int count = 0; count < 4; count++) {
+				int neighborX = localX + listNeighbors[count][0];
+				int neighborY = localY + listNeighbors[count][1];
+				if (neighborX < 0 || neighborX >= width || neighborY < 0 || neighborY >= height)
+					continue;
+
+				const Level::Tile& tile = level.listTiles[(originX + neighborX) + (originY + neighborY) * level.tileCountX];
+				if (tile.type == Level::TileType::wall)
+					continue;
+
+				int indexNeighbor = neighborX + neighborY * clusterSize;
+				unsigned int distanceNew = distanceCurrent + Level::flowStepStraight * tile.cost;
+				if (distanceNew < listSearchDistances[indexNeighbor]) {
+					listSearchDistances[indexNeighbor] = distanceNew;
+					listBuckets[distanceNew % bucketCount].push_back(indexNeighbor);
+					openCount++;
+				}
+			}
+		}
+		bucket.clear();
+		distanceCurrent++;
+	}
+}
+
+
+void HierarchicalPathfinder::addTargetSeeds(int clusterIndex, int flowFieldID) const {
+	int originX = (clusterIndex % clusterCountX) * clusterSize;
+	int originY = (clusterIndex / clusterCountX) * clusterSize;
+
+	for (const auto& target : level.listTargets) {
+		int targetX = target.index % level.tileCountX - originX;
+		int targetY = target.index / level.tileCountX - originY;
+		if (target.flowFieldID == flowFieldID &&
+			targetX > -1 && targetX < clusterSize && targetY > -1 && targetY < clusterSize)
+			listSearchSeeds.push_back({ 0, targetX + targetY * clusterSize });
+	}
+}
+
+
+int HierarchicalPathfinder::buildLocalField(int clusterIndex, int flowFieldID) const {
+	PROFILE_SCOPE("HierarchicalPathfinder::buildLocalField");
+	ALLOCATION_TAG(AllocationTag::level);
+
+	int slot;
+	if (listLocalFieldsFree.empty() == false) {
+		slot = listLocalFieldsFree.back();
+		listLocalFieldsFree.pop_back();
+	}
+	else {
+		slot = (int)listLocalFields.size();
+		listLocalFields.emplace_back();
+		listLocalFields.back().listDistances.resize(clusterSize * clusterSize);
+		listLocalFields.back().listDirectionsX.resize(clusterSize * clusterSize);
+		listLocalFields.back().listDirectionsY.resize(clusterSize * clusterSize);
+	}
+	listClusterLocalFields[flowFieldID * listClusters.size() + clusterIndex] = slot;
+
+	int originX = (clusterIndex % clusterCountX) * clusterSize;
+	int originY = (clusterIndex / clusterCountX) * clusterSize;
+	int width = std::min(clusterSize, level.tileCountX - originX);
+	int height = std::min(clusterSize, level.tileCountY - originY);
+	auto getIndexLocal = [&](int index) {
+		return (index % level.tileCountX - originX) + (index / level.tileCountX - originY) * clusterSize;
+	};
+
+	//Search from the cluster's nodes at their distances to the targets, and from its own targets.
+	const Cluster& cluster = listClusters[clusterIndex];
+	const unsigned int* listDistancesNode = listNodeDistances.data() + flowFieldID * listNodes.size();
+	listSearchSeeds.clear();
+	for (int node : cluster.listNodes)
+		if (listDistancesNode[node] != Level::flowDistanceMax)
+			listSearchSeeds.push_back({ listDistancesNode[node], getIndexLocal(listNodes[node].index) });
+	addTargetSeeds(clusterIndex, flowFieldID);
+	searchCluster(clusterIndex);
+
+	//Keep the distances by swapping them with the scratch, which is the same size.
+	LocalField& localField = listLocalFields[slot];
+	localField.listDistances.swap(listSearchDistances);
+	const unsigned int* listDistances = localField.listDistances.data();
+	std::fill(localField.listDirectionsX.begin(), localField.listDirectionsX.end(), 0);
+	std::fill(localField.listDirectionsY.begin(), localField.listDirectionsY.end(), 0);
+
+	//Point each tile at its lowest neighbor in the cluster, like the level's own field.
+	for (int localY = 0; localY < height; localY++) {
+		for (int localX = 0; localX < width; localX++) {
+			int indexLocal = localX + localY * clusterSize;
+			unsigned int flowFieldBest = listDistances[indexLocal];
+			if (flowFieldBest == Level::flowDistanceMax)
+				continue;
+
+			for (int offsetY = -1; offsetY <= 1; offsetY++) {
+				for (int offsetX = -1; offsetX <= 1; offsetX++) {
+					int neighborX = localX + offsetX;
+					int neighborY = localY + offsetY;
+					if (neighborX < 0 || neighborX >= width || neighborY < 0 || neighborY >= height)
+						continue;
+
+					if (listDistances[neighborX + neighborY * clusterSize] < flowFieldBest) {
+						flowFieldBest = listDistances[neighborX + neighborY * clusterSize];
+						localField.listDirectionsX[indexLocal] = (signed char)offsetX;
+						localField.listDirectionsY[indexLocal] = (signed char)offsetY;
+					}
+				}
+			}
+		}
+	}
+
+	//A node with nothing lower in the cluster is where the path leaves it, so point it across
+	//the border at its partner.
+	for (int node : cluster.listNodes) {
+		int indexLocal = getIndexLocal(listNodes[node].index);
+		int partner = listNodes[node].partner;
+		if (localField.listDirectionsX[indexLocal] == 0 && localField.listDirectionsY[indexLocal] == 0 &&
+			listDistancesNode[partner] < listDistances[indexLocal]) {
+			int indexPartner = listNodes[partner].index;
+			localField.listDirectionsX[indexLocal] = (signed char)(indexPartner % level.tileCountX - listNodes[node].index % level.tileCountX);
+			localField.listDirectionsY[indexLocal] = (signed char)(indexPartner / level.tileCountX - listNodes[node].index / level.tileCountX);
+		}
+	}
+
+	return slot;
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include "Vector2D.h"
+class Level;
+
+
+
+//An HPA* style path layer for maps too large to rebuild a whole flow field on every wall edit.
+//The map is cut into square clusters, and every open stretch of the border between two clusters
+//is an entrance with a node on each side.  The nodes of a cluster are joined by edges costed by
+//searches inside the cluster, and one search over that abstract graph gives every node its
+//distance to the targets.  A cluster's own flow field is only built when something asks for a
+//direction inside it, seeded from its nodes, so only clusters with units in them are ever filled
+//in.  A wall edit only rebuilds the edges of the clusters it touched.
+//
+//Searches are 4-neighbor and use the level's tile costs.  Paths only cross borders at the middle
+//of each entrance, so they can be slightly longer than the flat flow field's.
+class HierarchicalPathfinder
+{
+public:
+	static constexpr int clusterSize = 32;
+
+	explicit HierarchicalPathfinder(const Level& level);
+
+	void rebuild();
+	//Call after a tile's wall state or cost changed.  Target changes need a full rebuild.
+	void updateTile(int x, int y);
+
+	//Builds the cluster's flow field first if it isn't cached.
+	Vector2D getFlowNormal(int x, int y, int flowFieldID) const;
+
+	int getNodeCount() const;
+	int getLocalFieldCount() const;
+
+
+private:
+	//The two tiles either side of the border at the middle of an open stretch, A in the left or
+	//top cluster and B in the right or bottom one.
+	struct Entrance {
+		int indexA, indexB;
+		bool operator==(const Entrance& other) const { return indexA == other.indexA && indexB == other.indexB; }
+	};
+	//A border's entrances make nodes nodeFirst + 2 * n on the A side and nodeFirst + 2 * n + 1 on
+	//the B side.
+	struct Border {
+		std::vector<Entrance> listEntrances;
+		int nodeFirst = 0, nodeFirstPrevious = 0;
+	};
+	struct Node {
+		int index;
+		int cluster;
+		int clusterNode;
+		int partner;
+	};
+	struct Cluster {
+		//Node IDs in the order left, right, top, bottom border, which only changes when a border does.
+		std::vector<int> listNodes;
+		//The cost to walk from node i to node j inside the cluster is at j * nodeCount + i.
+		std::vector<unsigned int> listEdgeCosts;
+		//The cost from node i to the closest target of field f inside the cluster is at f * nodeCount + i.
+		std::vector<unsigned int> listTargetCosts;
+	};
+	struct LocalField {
+		std::vector<unsigned int> listDistances;
+		std::vector<signed char> listDirectionsX, listDirectionsY;
+	};
+
+	bool calculateEntrances(int clusterX, int clusterY, bool isVertical);
+	void assignNodes();
+	void calculateClusterEdges(int clusterIndex);
+	void calculateNodeDistances();
+	void repairNodeDistances(const int* listClustersChanged, int clusterChangedCount,
+		const Border* const* listBordersChanged, int borderChangedCount);
+	void searchNodes(int flowFieldID);
+	void searchCluster(int clusterIndex) const;
+	void addTargetSeeds(int clusterIndex, int flowFieldID) const;
+	int buildLocalField(int clusterIndex, int flowFieldID) const;
+
+
+	const Level& level;
+	const int clusterCountX, clusterCountY;
+	int flowFieldCount = 1;
+
+	//The border to the right of and below each cluster.
+	std::vector<Border> listBordersVertical, listBordersHorizontal;
+	std::vector<Cluster> listClusters;
+	std::vector<Node> listNodes;
+	//Each field's distance from every node to its targets, and the next node on the way there, at
+	//f * nodeCount + n.  The next nodes form a tree, which tells an edit which nodes it could affect.
+	static constexpr int nodeNextNone = -1, nodeNextBroken = -2;
+	std::vector<unsigned int> listNodeDistances, listNodeDistancesPrevious;
+	std::vector<int> listNodeNext, listNodeNextPrevious;
+
+	//Scratch for updates.
+	static constexpr char nodeStateUnknown = 0, nodeStateClean = 1, nodeStateDirty = 2;
+	std::vector<Entrance> listEntrancesScratch;
+	std::vector<int> listNodeRemap, listNodeStack;
+	std::vector<char> listNodeStates, listClustersInvalid;
+
+	//The local fields are a cache over the abstract graph, filled in from const lookups.  The
+	//slot of cluster c's field f is at f * clusterCount + c, or -1 if it isn't built.
+	mutable std::vector<LocalField> listLocalFields;
+	mutable std::vector<int> listLocalFieldsFree;
+	mutable std::vector<int> listClusterLocalFields;
+
+	//Scratch for searches inside a cluster, which are indexed by x + y * clusterSize.
+	mutable std::vector<unsigned int> listSearchDistances;
+	mutable std::vector<std::pair<unsigned int, int>> listSearchSeeds;
+	mutable std::vector<std::vector<int>> listBuckets;
+	//The heap for the search over the abstract graph.
+	std::vector<std::pair<unsigned int, int>> listHeap;
+};
@@ -1,72 +1,33 @@
 #include "Level.h"
-#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <limits>
+#include <new>
+#include "HierarchicalPathfinder.h"
+#include "WorkerPool.h"
+#include "Profiler.h"
+#include "AllocationTracker.h"
+#include "Logger.h"
 
 
 Level::Level(SDL_Renderer* renderer, int setTileCountX, int setTileCountY, const std::string& backgroundFile) :
     tileCountX(setTileCountX), tileCountY(setTileCountY),
-    targetX(setTileCountX / 2), targetY(setTileCountY / 2) {
+    wallGrid(setTileCountX, setTileCountY),
+    wallDistanceField(wallGrid, setTileCountX, setTileCountY),
+    targetX(setTileCountX / 2), targetY(setTileCountY / 2),
+    arenaFlowField((size_t)setTileCountX * setTileCountY * 2 * sizeof(int) +
+        flowBucketCount * sizeof(int) + alignof(std::max_align_t)) {
     
-    // Try multiple approaches to load the background texture
-    std::vector<std::string> pathsToTry = {
-        backgroundFile,                        // Original path
-        "./" + backgroundFile,                 // With explicit current directory
-        "../" + backgroundFile,                // Parent directory
-        "assets/" + backgroundFile,            // Assets folder
-        "data/" + backgroundFile,              // Data folder
-        "resources/" + backgroundFile          // Resources folder
-    };
-    
-    // Also try alternative extensions if loading fails
-    std::vector<std::string> extensions = {".bmp", ".png", ".jpg"};
-    
-    std::cout << "Attempting to load background: " << backgroundFile << std::endl;
-    
-    // First try direct paths with different prefixes
-    for (const auto& path : pathsToTry) {
-        textureBackground = TextureLoader::loadTexture(renderer, path.c_str());
-        if (textureBackground != nullptr) {
-            std::cout << "Successfully loaded background from: " << path << std::endl;
-            break;
-        } else {
-            std::cout << "Failed to load from: " << path << " - " << SDL_GetError() << std::endl;
-        }
-    }
-    
-    // If still not loaded, try different extensions
-    if (textureBackground == nullptr) {
-        std::string baseName = backgroundFile;
-        
-        // Remove extension if present
-        size_t dotPos = baseName.find_last_of('.');
-        if (dotPos != std::string::npos) {
-            baseName = baseName.substr(0, dotPos);
-        }
-        
-        // Try each extension
-        for (const auto& ext : extensions) {
-            for (const auto& path : pathsToTry) {
-                std::string pathWithExt = path;
-                
-                // Replace extension if path already has one
-                dotPos = pathWithExt.find_last_of('.');
-                if (dotPos != std::string::npos) {
-                    pathWithExt = pathWithExt.substr(0, dotPos) + ext;
-                }
-                
-                std::cout << "Trying with alternate extension: " << pathWithExt << std::endl;
-                textureBackground = TextureLoader::loadTexture(renderer, pathWithExt.c_str());
-                if (textureBackground != nullptr) {
-                    std::cout << "Successfully loaded background from: " << pathWithExt << std::endl;
-                    break;
-                }
-            }
-            if (textureBackground != nullptr) break;
-        }
+    // Load the background through the asset index, which also finds other formats of the same name
+    textureBackground = TextureLoader::loadTexture(renderer, backgroundFile);
+    if (textureBackground != nullptr) {
+        LOG_INFO(LogModule::level, "Loaded background: %s", backgroundFile.c_str());
     }
     
-    // Last resort: Create a colored background if texture loading failed
-    if (textureBackground == nullptr) {
-        std::cout << "Failed to load background texture, creating a fallback surface..." << std::endl;
+    // Otherwise create a colored background if texture loading failed
+    if (textureBackground == nullptr && renderer != nullptr) {
+        LOG_WARNING(LogModule::level, "Failed to load background texture, creating a fallback surface");
         
         // Choose color based on filename to somewhat match the intended bg
         Uint8 r = 100, g = 150, b = 100; // Default green-ish
@@ -88,7 +49,7 @@ Level::Level(SDL_Renderer* renderer, int setTileCountX, int setTileCountY, const
             SDL_FreeSurface(surface);
             
             if (textureBackground != nullptr) {
-                std::cout << "Created fallback background texture" << std::endl;
+                LOG_INFO(LogModule::level, "Created fallback background texture");
             }
         }
     }
@@ -110,6 +71,13 @@ Level::Level(SDL_Renderer* renderer, int setTileCountX, int setTileCountY, const
 
     size_t listTilesSize = (size_t)tileCountX * tileCountY;
     listTiles.assign(listTilesSize, Tile{});
+    if (listTilesSize >= (size_t)hierarchicalTileCountMin)
+        pathfinderHierarchical = std::make_unique<HierarchicalPathfinder>(*this);
+
+    isFlowFieldDeferred = true;
+
+    //The city is the target at the center.
+    setTileType(targetX, targetY, TileType::target);
 
     //Add an enemy spawner at each corner.
     int xMax = tileCountX - 1;
@@ -119,11 +87,15 @@ Level::Level(SDL_Renderer* renderer, int setTileCountX, int setTileCountY, const
     setTileType(0, yMax, TileType::enemySpawner);
     setTileType(xMax, yMax, TileType::enemySpawner);
 
+    isFlowFieldDeferred = false;
     calculateFlowField();
+    calculateEnemyPaths();
 }
 
 
 void Level::draw(SDL_Renderer* renderer, int tileSize) {
+    PROFILE_SCOPE("Level::draw");
+    ALLOCATION_TAG(AllocationTag::level);
     // Clear the renderer first
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
     SDL_RenderClear(renderer);
@@ -135,31 +107,31 @@ void Level::draw(SDL_Renderer* renderer, int tileSize) {
     // Draw background if available
     bool backgroundDrawn = false;
     if (textureBackground != nullptr) {
-        std::cout << "Attempting to render background texture" << std::endl;
+        LOG_DEBUG(LogModule::level, "Attempting to render background texture");
         // Create a rect covering the entire level area
         SDL_Rect bgRect = { 0, 0, levelWidth, levelHeight };
         
         // Verify texture is still valid
         int w, h;
         if (SDL_QueryTexture(textureBackground, NULL, NULL, &w, &h) == 0) {
-            std::cout << "Background texture is valid, dimensions: " << w << "x" << h << std::endl;
+            LOG_DEBUG(LogModule::level, "Background texture is valid, dimensions: %dx%d", w, h);
             // Draw the background texture
             if (SDL_RenderCopy(renderer, textureBackground, NULL, &bgRect) == 0) {
                 backgroundDrawn = true;
-                std::cout << "Successfully rendered background" << std::endl;
+                LOG_DEBUG(LogModule::level, "Rendered background");
             } else {
-                std::cout << "Failed to render background texture: " << SDL_GetError() << std::endl;
+                LOG_ERROR(LogModule::level, "Failed to render background texture: %s", SDL_GetError());
             }
         } else {
-            std::cout << "Background texture is invalid: " << SDL_GetError() << std::endl;
+            LOG_ERROR(LogModule::level, "Background texture is invalid: %s", SDL_GetError());
         }
     } else {
-        std::cout << "Background texture is null" << std::endl;
+        LOG_DEBUG(LogModule::level, "Background texture is null");
     }
     
     // Draw the checkerboard background only if no background image was drawn
     if (!backgroundDrawn) {
-        std::cout << "Drawing fallback checkerboard background" << std::endl;
+        LOG_DEBUG(LogModule::level, "Drawing fallback checkerboard background");
         for (int y = 0; y < tileCountY; y++) {
             for (int x = 0; x < tileCountX; x++) {
                 if ((x + y) % 2 == 0)
@@ -178,19 +150,19 @@ void Level::draw(SDL_Renderer* renderer, int tileSize) {
         drawTile(renderer, (count % tileCountX), (count / tileCountX), tileSize);*/
     
     //Draw the enemy spawner tiles.
-    for (int y = 0; y < tileCountY; y++) {
-        for (int x = 0; x < tileCountX; x++) {
-            if (getTileType(x, y) == TileType::enemySpawner) {
-                SDL_Rect rect = { x * tileSize, y * tileSize, tileSize, tileSize };
-                SDL_RenderCopy(renderer, textureTileEnemySpawner, NULL, &rect);
-            }
-        }
+    for (const auto& enemySpawner : listEnemySpawners) {
+        SDL_Rect rect = { (enemySpawner.index % tileCountX) * tileSize, (enemySpawner.index / tileCountX) * tileSize,
+            tileSize, tileSize };
+        SDL_RenderCopy(renderer, textureTileEnemySpawner, NULL, &rect);
     }
 
-    //Draw the target tile.
+    //Draw the target tiles.
     if (textureTileTarget != nullptr) {
-        SDL_Rect rect = { targetX * tileSize, targetY * tileSize, tileSize, tileSize };
-        SDL_RenderCopy(renderer, textureTileTarget, NULL, &rect);
+        for (const auto& target : listTargets) {
+            int index = target.index;
+            SDL_Rect rect = { (index % tileCountX) * tileSize, (index / tileCountX) * tileSize, tileSize, tileSize };
+            SDL_RenderCopy(renderer, textureTileTarget, NULL, &rect);
+        }
     }
     
     //Draw the wall tiles.
@@ -217,27 +189,29 @@ void Level::drawTile(SDL_Renderer* renderer, int x, int y, int tileSize) {
 
     //Ensure that the input tile exists.
     size_t index = static_cast<size_t>(x + y * tileCountX);
-    if (index < listTiles.size() &&
+    if (index < listFlowDirectionsX.size() &&
         x > -1 && x < tileCountX &&
         y > -1 && y < tileCountY) {
-        Tile& tileSelected = listTiles[index];
+        //Draw the first flow field.
+        int flowDirectionX = listFlowDirectionsX[index];
+        int flowDirectionY = listFlowDirectionsY[index];
 
         //Select the correct tile texture based on the flow direction.
-        if (tileSelected.flowDirectionX == 0 && tileSelected.flowDirectionY == -1)
+        if (flowDirectionX == 0 && flowDirectionY == -1)
             textureSelected = textureTileArrowUp;
-        else if (tileSelected.flowDirectionX == 1 && tileSelected.flowDirectionY == -1)
+        else if (flowDirectionX == 1 && flowDirectionY == -1)
             textureSelected = textureTileArrowUpRight;
-        else if (tileSelected.flowDirectionX == 1 && tileSelected.flowDirectionY == 0)
+        else if (flowDirectionX == 1 && flowDirectionY == 0)
             textureSelected = textureTileArrowRight;
-        else if (tileSelected.flowDirectionX == 1 && tileSelected.flowDirectionY == 1)
+        else if (flowDirectionX == 1 && flowDirectionY == 1)
             textureSelected = textureTileArrowDownRight;
-        else if (tileSelected.flowDirectionX == 0 && tileSelected.flowDirectionY == 1)
+        else if (flowDirectionX == 0 && flowDirectionY == 1)
             textureSelected = textureTileArrowDown;
-        else if (tileSelected.flowDirectionX == -1 && tileSelected.flowDirectionY == 1)
+        else if (flowDirectionX == -1 && flowDirectionY == 1)
             textureSelected = textureTileArrowDownLeft;
-        else if (tileSelected.flowDirectionX == -1 && tileSelected.flowDirectionY == 0)
+        else if (flowDirectionX == -1 && flowDirectionY == 0)
             textureSelected = textureTileArrowLeft;
-        else if (tileSelected.flowDirectionX == -1 && tileSelected.flowDirectionY == -1)
+        else if (flowDirectionX == -1 && flowDirectionY == -1)
             textureSelected = textureTileArrowUpLeft;
     }
 
@@ -250,18 +224,23 @@ void Level::drawTile(SDL_Renderer* renderer, int x, int y, int tileSize) {
 
 
 
-Vector2D Level::getRandomEnemySpawnerLocation() const {
-    //Create a list of all tiles that are enemy spawners.
-    std::vector<int> listSpawnerIndices;
-    for (size_t count = 0; count < listTiles.size(); count++) {
-        const auto& tileSelected = listTiles[count];
-        if (tileSelected.type == TileType::enemySpawner)
-            listSpawnerIndices.push_back(static_cast<int>(count));
+int Level::getRandomEnemySpawner() const {
+    //Pick a column of the alias table at random, then either it or its alias by its probability.
+    if (listEnemySpawners.empty() == false) {
+        int slot = rand() % (int)listEnemySpawners.size();
+        float chance = (float)rand() / ((float)RAND_MAX + 1.0f);
+        if (chance >= listEnemySpawnerAliasProbabilities[slot])
+            slot = listEnemySpawnerAliases[slot];
+        return slot;
     }
 
-    //If one or more spawners are found, pick one at random and output it's center position.
-    if (listSpawnerIndices.empty() == false) {
-        int index = listSpawnerIndices[rand() % listSpawnerIndices.size()];
+    return -1;
+}
+
+
+Vector2D Level::getEnemySpawnerLocation(int enemySpawnerID) const {
+    if (enemySpawnerID > -1 && enemySpawnerID < (int)listEnemySpawners.size()) {
+        int index = listEnemySpawners[enemySpawnerID].index;
         return Vector2D((float)(index % tileCountX) + 0.5f, (float)(index / tileCountX) + 0.5f);
     }
 
@@ -269,15 +248,405 @@ Vector2D Level::getRandomEnemySpawnerLocation() const {
 }
 
 
+int Level::getEnemySpawnerCount() const {
+    return (int)listEnemySpawners.size();
+}
+
+
+const Vector2D* Level::getEnemyPath(int enemySpawnerID, int& pointCount, unsigned int& pathVersion) const {
+    pointCount = 0;
+    pathVersion = 0;
+    if (enemySpawnerID < 0 || enemySpawnerID >= (int)listEnemySpawners.size())
+        return nullptr;
+
+    const EnemySpawner& enemySpawner = listEnemySpawners[enemySpawnerID];
+    pathVersion = enemySpawner.pathVersion;
+    if (enemySpawner.pathBegin == enemySpawner.pathEnd)
+        return nullptr;
+    pointCount = enemySpawner.pathEnd - enemySpawner.pathBegin;
+    return listEnemyPathPoints.data() + enemySpawner.pathBegin;
+}
+
+
+void Level::calculateEnemyPaths() {
+    PROFILE_SCOPE("Level::calculateEnemyPaths");
+
+    enemyPathsLevelVersion = version;
+    listEnemyPathPointsNext.clear();
+    for (auto& enemySpawner : listEnemySpawners) {
+        int pathBegin = (int)listEnemyPathPointsNext.size();
+        if (listFlowDistances.empty() == false || pathfinderHierarchical != nullptr) {
+            if (traceEnemyPath(enemySpawner.index)) {
+                //Each point is as far down the tiles as a straight line reaches from the one before.
+                auto getCenter = [&](int index) {
+                    return Vector2D((float)(index % tileCountX) + 0.5f, (float)(index / tileCountX) + 0.5f);
+                };
+                int last = (int)listEnemyPathTiles.size() - 1;
+                int anchor = 0;
+                listEnemyPathPointsNext.push_back(getCenter(listEnemyPathTiles[0]));
+                while (anchor < last) {
+                    int next = anchor + 1;
+                    int stepFirst = listEnemyPathTiles[anchor + 1] - listEnemyPathTiles[anchor];
+                    while (next < last && next + 1 - anchor <= enemyPathSegmentTilesMax) {
+                        bool isJoined = (tileCountWeighted == 0 ?
+                            isEnemyPathClear(getCenter(listEnemyPathTiles[anchor]), getCenter(listEnemyPathTiles[next + 1])) :
+                            listEnemyPathTiles[next + 1] - listEnemyPathTiles[next] == stepFirst);
+                        if (isJoined == false)
+                            break;
+                        next++;
+                    }
+                    listEnemyPathPointsNext.push_back(getCenter(listEnemyPathTiles[next]));
+                    anchor = next;
+                }
+            }
+        }
+        int pathEnd = (int)listEnemyPathPointsNext.size();
+
+        //Only a path that came out different gets a new version, so units on the others carry on.
+        bool isSame = (pathEnd - pathBegin == enemySpawner.pathEnd - enemySpawner.pathBegin &&
+            std::equal(listEnemyPathPointsNext.begin() + pathBegin, listEnemyPathPointsNext.begin() + pathEnd,
+                listEnemyPathPoints.begin() + enemySpawner.pathBegin,
+                [](const Vector2D& a, const Vector2D& b) { return a.x == b.x && a.y == b.y; }));
+        if (isSame == false || enemySpawner.pathVersion == 0)
+            enemySpawner.pathVersion = ++enemyPathVersionLast;
+        enemySpawner.pathBegin = pathBegin;
+        enemySpawner.pathEnd = pathEnd;
+    }
+    listEnemyPathPoints.swap(listEnemyPathPointsNext);
+}
+
+
+bool Level::traceEnemyPath(int indexStart) {
+    //Walk down field 0 a tile at a time.  Every step lowers the distance, so it can't loop.
+    listEnemyPathTiles.clear();
+    int x = indexStart % tileCountX;
+    int y = indexStart / tileCountX;
+    for (size_t count = 0; count < listTiles.size(); count++) {
+        listEnemyPathTiles.push_back(x + y * tileCountX);
+        if (isTileTarget(x, y, 0))
+            return true;
+
+        Vector2D direction = getFlowNormal(x, y, 0);
+        int stepX = (int)std::lround(direction.x);
+        int stepY = (int)std::lround(direction.y);
+        if (stepX == 0 && stepY == 0)
+            return false;
+
+        //The plain field goes diagonally for as long as it can and then straight, but a smooth
+        //field heads more directly for the target, which leaves a lot less to cut across.  Its
+        //direction is rounded to the nearest of the 8 steps, and taken as long as that's downhill.
+        if (listFlowAngles.empty() == false && pathfinderHierarchical == nullptr) {
+            const float sinEighth = 0.3827f;
+            Vector2D directionSmooth = getFlowNormal(Vector2D((float)x + 0.5f, (float)y + 0.5f), 0);
+            int smoothX = (directionSmooth.x > sinEighth) - (directionSmooth.x < -sinEighth);
+            int smoothY = (directionSmooth.y > sinEighth) - (directionSmooth.y < -sinEighth);
+            int neighborX = x + smoothX, neighborY = y + smoothY;
+            if ((smoothX != 0 || smoothY != 0) &&
+                neighborX >= 0 && neighborX < tileCountX && neighborY >= 0 && neighborY < tileCountY &&
+                listFlowDistances[neighborX + neighborY * tileCountX] < listFlowDistances[x + y * tileCountX] &&
+                (getTileType(neighborX, y) != TileType::wall || getTileType(x, neighborY) != TileType::wall)) {
+                stepX = smoothX;
+                stepY = smoothY;
+            }
+        }
+
+        //The field can step diagonally past a wall's corner, but the path goes round it on the
+        //open side, so the lines joining its tiles keep clear of the wall.
+        if (stepX != 0 && stepY != 0) {
+            bool isOpenX = (getTileType(x + stepX, y) != TileType::wall);
+            bool isOpenY = (getTileType(x, y + stepY) != TileType::wall);
+            if (isOpenX != isOpenY)
+                listEnemyPathTiles.push_back(isOpenX ? (x + stepX) + y * tileCountX : x + (y + stepY) * tileCountX);
+        }
+        x += stepX;
+        y += stepY;
+    }
+
+    return false;
+}
+
+
+bool Level::isEnemyPathClear(Vector2D posStart, Vector2D posEnd) const {
+    //Step along the line by however much clearance there is to spare, since no wall can be closer
+    //than that.  Tile centers beside a wall are half a tile from it, which is what's kept.
+    const float clearanceMin = 0.499f;
+    const float stepMin = 0.1f;
+    Vector2D offset = posEnd - posStart;
+    float length = offset.magnitude();
+    if (length <= 0.0f)
+        return true;
+
+    Vector2D direction = offset / length;
+    for (float distance = 0.0f; distance < length;) {
+        float clearance = wallDistanceField.getClearance(posStart + direction * distance);
+        if (clearance < clearanceMin)
+            return false;
+        distance += std::max(clearance - clearanceMin, stepMin);
+    }
+
+    return (wallDistanceField.getClearance(posEnd) >= clearanceMin);
+}
+
+
+
+bool Level::canPlaceWall(int x, int y) const {
+    if (x < 0 || x >= tileCountX || y < 0 || y >= tileCountY ||
+        getTileType(x, y) != TileType::empty)
+        return true;
+
+    //Most walls leave their open neighbors joined up around them, so they can't cut anything off.
+    if (isWallBypassable(x, y))
+        return true;
+
+    if (isReachableValid == false) {
+        calculateReachable(listReachable, -1, -1);
+        isReachableValid = true;
+    }
+    if (wallGrid.isSet(listReachable, x, y) == false)
+        return true;
+
+    //Try the wall out and see if any spawner that could reach a target no longer can.
+    calculateReachable(listReachableCandidate, x, y);
+    reachableCandidateIndex = x + y * tileCountX;
+    for (const auto& enemySpawner : listEnemySpawners) {
+        int spawnerX = enemySpawner.index % tileCountX;
+        int spawnerY = enemySpawner.index / tileCountX;
+        if (wallGrid.isSet(listReachable, spawnerX, spawnerY) &&
+            wallGrid.isSet(listReachableCandidate, spawnerX, spawnerY) == false)
+            return false;
+    }
+    return true;
+}
+
+
+bool Level::isWallBypassable(int x, int y) const {
+    //The eight neighbors in order around the tile, so each one shares an edge with the next.
+    const int listRing[][2] = {
+        {0, -1}, {1, -1}, {1, 0}, {1, 1},
+        {0, 1}, {-1, 1}, {-1, 0}, {-1, -1} };
+    bool listOpen[8];
+    int indexClosed = -1;
+    for (int count = 0; count < 8; count++) {
+        int neighborX = x + listRing[count][0];
+        int neighborY = y + listRing[count][1];
+        listOpen[count] = (neighborX >= 0 && neighborX < tileCountX &&
+            neighborY >= 0 && neighborY < tileCountY && wallGrid.isWall(neighborX, neighborY) == false);
+        if (listOpen[count] == false)
+            indexClosed = count;
+    }
+    if (indexClosed == -1)
+        return true;
+
+    //Count the open stretches of the ring that touch a side of the tile, starting after a closed
+    //neighbor so none is split in two.  With one at most, any path through the tile can go
+    //around it instead.
+    int runCount = 0;
+    bool isTouchingSide = false;
+    for (int count = 1; count <= 8; count++) {
+        int indexRing = (indexClosed + count) % 8;
+        if (listOpen[indexRing]) {
+            if (indexRing % 2 == 0)
+                isTouchingSide = true;
+        }
+        else {
+            if (isTouchingSide)
+                runCount++;
+            isTouchingSide = false;
+        }
+    }
+    return (runCount <= 1);
+}
+
+
+void Level::calculateReachable(std::vector<uint64_t>& listReached, int xBlocked, int yBlocked) const {
+    //Spread out from every target at once.
+    listReached.assign((size_t)wallGrid.getWordsPerRow() * tileCountY, 0);
+    for (const auto& target : listTargets)
+        wallGrid.setBit(listReached, target.index % tileCountX, target.index / tileCountX, true);
+    wallGrid.spread(listReached, xBlocked, yBlocked);
+}
+
+
+bool Level::previewWall(int x, int y, std::vector<int>& listRouteTiles, std::vector<int>& listRouteEnds,
+    float& lengthDelta) const {
+    PROFILE_SCOPE("Level::previewWall");
+
+    listRouteTiles.clear();
+    listRouteEnds.clear();
+    lengthDelta = 0.0f;
+    if (x < 0 || x >= tileCountX || y < 0 || y >= tileCountY ||
+        getTileType(x, y) != TileType::empty || pathfinderHierarchical != nullptr ||
+        flowFieldRebuild.isActive || listFlowDistances.empty())
+        return false;
+
+    //The scratch only grows the first time, or if the map changes size.
+    size_t tileCount = listTiles.size();
+    if (listPreviewCosts.size() != tileCount) {
+        listPreviewCosts.assign(tileCount, 0);
+        listPreviewStamps.assign(tileCount, 0);
+        listPreviewParents.assign(tileCount, -1);
+    }
+
+    unsigned int distanceDelta = 0;
+    for (const auto& enemySpawner : listEnemySpawners) {
+        unsigned int distanceOld = listFlowDistances[enemySpawner.index];
+        int indexTarget = -1;
+        if (distanceOld != flowDistanceMax)
+            indexTarget = searchPreviewRoute(enemySpawner.index, x + y * tileCountX);
+
+        if (indexTarget != -1) {
+            //Walk back from the target, then turn the route around.
+            size_t routeBegin = listRouteTiles.size();
+            for (int index = indexTarget; index != -1; index = listPreviewParents[index])
+                listRouteTiles.push_back(index);
+            std::reverse(listRouteTiles.begin() + routeBegin, listRouteTiles.end());
+            distanceDelta = std::max(distanceDelta, listPreviewCosts[indexTarget] - distanceOld);
+        }
+        listRouteEnds.push_back((int)listRouteTiles.size());
+    }
+
+    lengthDelta = (float)distanceDelta / (flowStepStraight * tileCostDefault);
+    return true;
+}
+
+
+int Level::searchPreviewRoute(int indexStart, int indexBlocked) const {
+    //A* from the spawner to field 0's targets, stepping the same way the flow field does.  A new
+    //wall only takes steps away, so the current distances never overestimate and make a
+    //consistent heuristic.  Where the wall doesn't change the route they're exact, and the search
+    //walks straight down it, only spreading out as far as a detour needs.
+    if (++previewStamp == 0) {
+        std::fill(listPreviewStamps.begin(), listPreviewStamps.end(), 0);
+        previewStamp = 1;
+    }
+    const unsigned int* listDistances = listFlowDistances.data();
+
+    auto isOpen = [&](int index) {
+        return (index != indexBlocked && listTiles[index].type != TileType::wall);
+    };
+    //Ties on the estimate go to the tile furthest along, so the search follows one route at a time.
+    auto getKey = [](unsigned int cost, unsigned int estimate) {
+        return ((uint64_t)estimate << 32) | (0xFFFFFFFFu - cost);
+    };
+
+    const int listNeighbors[][2] = {
+        {-1, 0}, {1, 0}, {0, -1}, {0, 1},
+        {-1, -1}, {1, -1}, {-1, 1}, {1, 1} };
+    int neighborCount = (useFlowFieldDiagonal ? 8 : 4);
+
+    listPreviewHeap.clear();
+    listPreviewCosts[indexStart] = 0;
+    listPreviewStamps[indexStart] = previewStamp;
+    listPreviewParents[indexStart] = -1;
+    listPreviewHeap.push_back({ getKey(0, listDistances[indexStart]), indexStart });
+
+    while (listPreviewHeap.empty() == false) {
+        std::pop_heap(listPreviewHeap.begin(), listPreviewHeap.end(), std::greater<std::pair<uint64_t, int>>());
+        auto entry = listPreviewHeap.back();
+        listPreviewHeap.pop_back();
+
+        //Skip tiles that were reached more cheaply after this entry went in.
+        int indexCurrent = entry.second;
+        unsigned int costCurrent = 0xFFFFFFFFu - (unsigned int)(entry.first & 0xFFFFFFFFu);
+        if (costCurrent != listPreviewCosts[indexCurrent])
+            continue;
+        if (listDistances[indexCurrent] == 0)
+            return indexCurrent;
+
+        int currentX = indexCurrent % tileCountX;
+        int currentY = indexCurrent / tileCountX;
+        for (int count = 0; count < neighborCount; count++) {
+            int offsetX = listNeighbors[count][0];
+            int offsetY = listNeighbors[count][1];
+            int neighborX = currentX + offsetX;
+            int neighborY = currentY + offsetY;
+            if (neighborX < 0 || neighborX >= tileCountX ||
+                neighborY < 0 || neighborY >= tileCountY)
+                continue;
+
+            //Tiles the current field can't reach a target from can't with another wall either.
+            int indexNeighbor = neighborX + neighborY * tileCountX;
+            if (isOpen(indexNeighbor) == false || listDistances[indexNeighbor] == flowDistanceMax)
+                continue;
+
+            bool isDiagonal = (offsetX != 0 && offsetY != 0);
+            if (isDiagonal && (isOpen(currentX + neighborY * tileCountX) == false ||
+                isOpen(neighborX + currentY * tileCountX) == false))
+                continue;
+
+            //Leaving a tile costs that tile's cost, as in the flow field.
+            unsigned int costNew = costCurrent +
+                (isDiagonal ? flowStepDiagonal : flowStepStraight) * listTiles[indexCurrent].cost;
+            if (listPreviewStamps[indexNeighbor] == previewStamp && costNew >= listPreviewCosts[indexNeighbor])
+                continue;
+
+            listPreviewCosts[indexNeighbor] = costNew;
+            listPreviewStamps[indexNeighbor] = previewStamp;
+            listPreviewParents[indexNeighbor] = indexCurrent;
+            listPreviewHeap.push_back({ getKey(costNew, costNew + listDistances[indexNeighbor]), indexNeighbor });
+            std::push_heap(listPreviewHeap.begin(), listPreviewHeap.end(), std::greater<std::pair<uint64_t, int>>());
+        }
+    }
+
+    return -1;
+}
+
+
+unsigned int Level::getVersion() const {
+    return version;
+}
+
+
+bool Level::setTileWall(int x, int y, bool isWall) {
+    TileType tileTypeOld = getTileType(x, y);
+    TileType tileTypeNew = (isWall ? TileType::wall : TileType::empty);
+    if (tileTypeOld == TileType::enemySpawner || tileTypeOld == TileType::target ||
+        tileTypeOld == tileTypeNew)
+        return false;
+
+    setTileType(x, y, tileTypeNew);
+    return true;
+}
+
+
+void Level::setTileEnemySpawner(int x, int y, bool isEnemySpawner, float weight) {
+    if (isEnemySpawner) {
+        setTileType(x, y, TileType::enemySpawner);
 
-bool Level::isTileWall(int x, int y) const {
-    return (getTileType(x, y) == TileType::wall);
+        //Update the weight of the spawner, which may have already existed.
+        int index = x + y * tileCountX;
+        for (auto& enemySpawner : listEnemySpawners) {
+            if (enemySpawner.index == index && enemySpawner.weight != weight) {
+                enemySpawner.weight = weight;
+                calculateEnemySpawnerAliasTable();
+            }
+        }
+    }
+    else if (getTileType(x, y) == TileType::enemySpawner)
+        setTileType(x, y, TileType::empty);
 }
 
 
-void Level::setTileWall(int x, int y, bool isWall) {
-    if (getTileType(x, y) != TileType::enemySpawner)
-        setTileType(x, y, (isWall ? TileType::wall : TileType::empty));
+void Level::setTileTarget(int x, int y, bool isTarget, int flowFieldID) {
+    if (isTarget) {
+        if (flowFieldID < 0)
+            return;
+
+        //Move an existing target to its new group.
+        int index = x + y * tileCountX;
+        if (getTileType(x, y) == TileType::target) {
+            for (auto& target : listTargets) {
+                if (target.index == index && target.flowFieldID != flowFieldID) {
+                    target.flowFieldID = flowFieldID;
+                    requestFlowFieldRebuild();
+                }
+            }
+        }
+        else
+            setTileType(x, y, TileType::target, flowFieldID);
+    }
+    else if (getTileType(x, y) == TileType::target)
+        setTileType(x, y, TileType::empty);
 }
 
 
@@ -292,14 +661,120 @@ Level::TileType Level::getTileType(int x, int y) const {
 }
 
 
-void Level::setTileType(int x, int y, TileType tileType) {
+void Level::setTileType(int x, int y, TileType tileType, int targetFlowFieldID) {
     size_t index = static_cast<size_t>(x + y * tileCountX);
     if (index < listTiles.size() &&
         x > -1 && x < tileCountX &&
         y > -1 && y < tileCountY) {
+        TileType tileTypeOld = listTiles[index].type;
+        if (tileTypeOld == tileType)
+            return;
+
         listTiles[index].type = tileType;
-        calculateFlowField();
+        version++;
+        wallGrid.setWall(x, y, tileType == TileType::wall);
+        if (tileTypeOld == TileType::wall || tileType == TileType::wall)
+            wallDistanceField.updateTile(x, y);
+        updateTileSets((int)index, tileTypeOld, tileType, targetFlowFieldID);
+
+        //Spawners are walked over like empty tiles, so only walls and targets change the flow field.
+        bool isFlowFieldChanged = false, isTargetChanged = false;
+        for (TileType tileTypeSelected : { tileTypeOld, tileType }) {
+            if (tileTypeSelected == TileType::wall || tileTypeSelected == TileType::target)
+                isFlowFieldChanged = true;
+            if (tileTypeSelected == TileType::target)
+                isTargetChanged = true;
+        }
+
+        //A wall the last check tried out, or one that can be walked around, is cheap to patch into
+        //the reachable tiles.  Anything else that changes paths means searching again.
+        if (isReachableValid && tileType == TileType::wall && (int)index == reachableCandidateIndex)
+            listReachable.swap(listReachableCandidate);
+        else if (isReachableValid && tileType == TileType::wall && isWallBypassable(x, y))
+            wallGrid.setBit(listReachable, x, y, false);
+        else if (isFlowFieldChanged)
+            isReachableValid = false;
+        reachableCandidateIndex = -1;
+
+        //The hierarchical layer can patch in a wall edit, but targets change the field groups.
+        if (isFlowFieldChanged && pathfinderHierarchical != nullptr && isTargetChanged == false)
+            pathfinderHierarchical->updateTile(x, y);
+        else if (isFlowFieldChanged)
+            requestFlowFieldRebuild();
+    }
+}
+
+
+void Level::updateTileSets(int index, TileType tileTypeOld, TileType tileTypeNew, int targetFlowFieldID) {
+    if (tileTypeOld == TileType::enemySpawner) {
+        for (size_t count = 0; count < listEnemySpawners.size(); count++) {
+            if (listEnemySpawners[count].index == index) {
+                listEnemySpawners[count] = listEnemySpawners.back();
+                listEnemySpawners.pop_back();
+                break;
+            }
+        }
+    }
+    else if (tileTypeOld == TileType::target) {
+        for (size_t count = 0; count < listTargets.size(); count++) {
+            if (listTargets[count].index == index) {
+                listTargets.erase(listTargets.begin() + count);
+                break;
+            }
+        }
     }
+
+    if (tileTypeNew == TileType::enemySpawner)
+        listEnemySpawners.push_back({ index, 1.0f });
+    else if (tileTypeNew == TileType::target)
+        listTargets.push_back({ index, targetFlowFieldID });
+
+    if (tileTypeOld == TileType::enemySpawner || tileTypeNew == TileType::enemySpawner)
+        calculateEnemySpawnerAliasTable();
+}
+
+
+void Level::calculateEnemySpawnerAliasTable() {
+    //Vose's alias method: every column holds one spawner with some probability and an alias for
+    //the rest, so a weighted pick is one random column and one random comparison.
+    size_t count = listEnemySpawners.size();
+    listEnemySpawnerAliasProbabilities.assign(count, 1.0f);
+    listEnemySpawnerAliases.assign(count, 0);
+    if (count == 0)
+        return;
+
+    float weightTotal = 0.0f;
+    for (const auto& enemySpawner : listEnemySpawners)
+        weightTotal += std::max(enemySpawner.weight, 0.0f);
+
+    //Without any positive weights they're all equally likely.
+    std::vector<float> listScaled(count, 1.0f);
+    if (weightTotal > 0.0f)
+        for (size_t countSpawner = 0; countSpawner < count; countSpawner++)
+            listScaled[countSpawner] = std::max(listEnemySpawners[countSpawner].weight, 0.0f) * count / weightTotal;
+
+    std::vector<int> listSmall, listLarge;
+    for (size_t countSpawner = 0; countSpawner < count; countSpawner++)
+        (listScaled[countSpawner] < 1.0f ? listSmall : listLarge).push_back((int)countSpawner);
+
+    while (listSmall.empty() == false && listLarge.empty() == false) {
+        int small = listSmall.back();
+        listSmall.pop_back();
+        int large = listLarge.back();
+        listLarge.pop_back();
+
+        listEnemySpawnerAliasProbabilities[small] = listScaled[small];
+        listEnemySpawnerAliases[small] = large;
+
+        listScaled[large] = (listScaled[large] + listScaled[small]) - 1.0f;
+        (listScaled[large] < 1.0f ? listSmall : listLarge).push_back(large);
+    }
+
+    //Anything left over is only off from 1 by rounding.
+    for (int index : listSmall)
+        listEnemySpawnerAliasProbabilities[index] = 1.0f;
+    for (int index : listLarge)
+        listEnemySpawnerAliasProbabilities[index] = 1.0f;
 }
 
 
@@ -309,79 +784,607 @@ Vector2D Level::getTargetPos() const {
 }
 
 
+Vector2D Level::getTargetPos(int index) const {
+    if (index > -1 && index < (int)listTargets.size()) {
+        int indexTile = listTargets[index].index;
+        return Vector2D((float)(indexTile % tileCountX) + 0.5f, (float)(indexTile / tileCountX) + 0.5f);
+    }
+
+    return getTargetPos();
+}
+
+
+int Level::getTargetCount() const {
+    return (int)listTargets.size();
+}
+
+
+bool Level::isTileTarget(int x, int y, int flowFieldID) const {
+    //A field's targets are exactly the tiles at distance zero in it.
+    size_t index = static_cast<size_t>(x + y * tileCountX);
+    if (flowFieldID > -1 && flowFieldID < flowFieldCount &&
+        x > -1 && x < tileCountX &&
+        y > -1 && y < tileCountY) {
+        //Without the planes, look the tile up among the group's targets.
+        if (pathfinderHierarchical != nullptr) {
+            if (listTiles[index].type == TileType::target)
+                for (const auto& target : listTargets)
+                    if (target.index == (int)index)
+                        return (target.flowFieldID == flowFieldID);
+            return false;
+        }
+
+        return (listFlowDistances[flowFieldID * listTiles.size() + index] == 0);
+    }
+
+    return false;
+}
+
+
+const WallDistanceField& Level::getWallDistanceField() const {
+    return wallDistanceField;
+}
+
+
+int Level::getFlowFieldCount() const {
+    return flowFieldCount;
+}
+
+
+void Level::setFlowFieldBudget(int microseconds) {
+    flowFieldBudgetMicroseconds = std::max(microseconds, 0);
+}
+
+
+int Level::getFlowFieldBudget() const {
+    return flowFieldBudgetMicroseconds;
+}
+
+
+bool Level::isFlowFieldRebuilding() const {
+    return flowFieldRebuild.isActive;
+}
+
+
+void Level::setFlowFieldThreadCount(int threadCount) {
+    //The team spins while it waits, so more threads than cores only slows it down.
+    if (threadCount <= 0)
+        threadCount = SDL_GetCPUCount();
+    threadCount = std::min(threadCount, SDL_GetCPUCount());
+    if (threadCount == getFlowFieldThreadCount())
+        return;
+
+    //The caller is one of the threads.
+    if (threadCount > 1)
+        workerPoolFlowField = std::make_unique<WorkerPool>(threadCount - 1);
+    else
+        workerPoolFlowField.reset();
+
+    //A rebuild in progress keeps its search state for the old pool, so it starts over.
+    if (flowFieldRebuild.isActive)
+        startFlowFieldRebuild();
+}
+
+
+int Level::getFlowFieldThreadCount() const {
+    return (workerPoolFlowField != nullptr ? workerPoolFlowField->getThreadCount() + 1 : 1);
+}
+
+
+void Level::updateFlowField() {
+    ALLOCATION_TAG(AllocationTag::level);
+
+    if (flowFieldRebuild.isActive) {
+        PROFILE_SCOPE("Level::updateFlowField");
+        Uint64 ticksBudget = (Uint64)flowFieldBudgetMicroseconds * SDL_GetPerformanceFrequency() / 1000000;
+        continueFlowFieldRebuild(SDL_GetPerformanceCounter() + std::max(ticksBudget, (Uint64)1));
+    }
+
+    //The paths follow the field units are on, so they wait for a rebuild to finish.
+    if (flowFieldRebuild.isActive == false && enemyPathsLevelVersion != version)
+        calculateEnemyPaths();
+}
+
+
 void Level::calculateFlowField() {
-    //Ensure the target is in bounds.
-    size_t indexTarget = static_cast<size_t>(targetX + targetY * tileCountX);
-    if (indexTarget < listTiles.size() &&
-        targetX > -1 && targetX < tileCountX &&
-        targetY > -1 && targetY < tileCountY) {
+    PROFILE_SCOPE("Level::calculateFlowField");
+    ALLOCATION_TAG(AllocationTag::level);
+
+    if (isFlowFieldDeferred)
+        return;
+
+    //The hierarchical layer keeps its own fields, so the full planes aren't needed.
+    if (pathfinderHierarchical != nullptr) {
+        if (flowFieldRebuild.isActive)
+            arenaFlowField.rewind(flowFieldRebuild.arenaMarker);
+        flowFieldRebuild = FlowFieldRebuild();
+
+        flowFieldCount = 1;
+        for (const auto& target : listTargets)
+            flowFieldCount = std::max(flowFieldCount, target.flowFieldID + 1);
+        for (auto* listPlane : { &listFlowDistances, &listFlowDistancesPending })
+            std::vector<unsigned int>().swap(*listPlane);
+        for (auto* listPlane : { &listFlowDirectionsX, &listFlowDirectionsY,
+            &listFlowDirectionsXPending, &listFlowDirectionsYPending })
+            std::vector<signed char>().swap(*listPlane);
+        for (auto* listPlane : { &listFlowAngles, &listFlowAnglesPending })
+            std::vector<unsigned char>().swap(*listPlane);
+        std::vector<float>().swap(listSmoothDistances);
+        pathfinderHierarchical->rebuild();
+        version++;
+        return;
+    }
+
+    startFlowFieldRebuild();
+    continueFlowFieldRebuild(0);
+}
+
+
+void Level::requestFlowFieldRebuild() {
+    if (isFlowFieldDeferred)
+        return;
+
+    //Without a budget, or with the hierarchical layer, the field is brought up to date right away.
+    if (flowFieldBudgetMicroseconds == 0 || pathfinderHierarchical != nullptr) {
+        calculateFlowField();
+        return;
+    }
 
-        //Reset the tile flow data.
-        for (auto& tileSelected : listTiles) {
-            tileSelected.flowDirectionX = 0;
-            tileSelected.flowDirectionY = 0;
-            tileSelected.flowDistance = flowDistanceMax;
+    //A rebuild already under way started from older tiles, so another one follows it.  Restarting
+    //it instead would starve it while the player keeps painting walls.
+    if (flowFieldRebuild.isActive)
+        flowFieldRebuild.isQueued = true;
+    else
+        startFlowFieldRebuild();
+}
+
+
+void Level::startFlowFieldRebuild() {
+    FlowFieldRebuild& rebuild = flowFieldRebuild;
+    if (rebuild.isActive)
+        arenaFlowField.rewind(rebuild.arenaMarker);
+
+    rebuild.isActive = true;
+    rebuild.isQueued = false;
+    rebuild.arenaMarker = arenaFlowField.getMarker();
+
+    //There's a field for every target group, even if the group is empty.
+    rebuild.flowFieldCount = 1;
+    for (const auto& target : listTargets)
+        rebuild.flowFieldCount = std::max(rebuild.flowFieldCount, target.flowFieldID + 1);
+
+    //Reset the flow data that's being built.  The current planes stay as they are until it's done.
+    size_t planeSize = (size_t)rebuild.flowFieldCount * listTiles.size();
+    listFlowDistancesPending.assign(planeSize, flowDistanceMax);
+    listFlowDirectionsXPending.assign(planeSize, 0);
+    listFlowDirectionsYPending.assign(planeSize, 0);
+    rebuild.isSmooth = useFlowFieldSmooth;
+    if (rebuild.isSmooth)
+        listFlowAnglesPending.assign(planeSize, 0);
+
+    beginDistances(0);
+}
+
+
+bool Level::continueFlowFieldRebuild(Uint64 ticksDeadline) {
+    FlowFieldRebuild& rebuild = flowFieldRebuild;
+    while (rebuild.isActive) {
+        //Every field is a distance pass and then a direction pass.
+        if (rebuild.isCalculatingDirections == false) {
+            bool isDone = (rebuild.isUniform ?
+                continueDistancesUniform(ticksDeadline) : continueDistances(ticksDeadline));
+            if (isDone == false)
+                return false;
+            rebuild.isCalculatingDirections = true;
+            rebuild.directionsNext = 0;
+        }
+
+        if (continueFlowDirections(ticksDeadline) == false)
+            return false;
+
+        //A smooth field follows on from the plain one, which marks the tiles with no direction.
+        if (rebuild.isSmooth) {
+            if (rebuild.isCalculatingSmooth == false)
+                beginSmoothField();
+            if (continueSmoothField(ticksDeadline) == false)
+                return false;
+        }
+
+        if (rebuild.flowFieldID + 1 < rebuild.flowFieldCount) {
+            beginDistances(rebuild.flowFieldID + 1);
+            continue;
         }
 
-        //Calculate the flow field.
-        calculateDistances();
-        calculateFlowDirections();
+        //Every field is done, so swap them in all at once.  Units never see a half built field.
+        listFlowDistances.swap(listFlowDistancesPending);
+        listFlowDirectionsX.swap(listFlowDirectionsXPending);
+        listFlowDirectionsY.swap(listFlowDirectionsYPending);
+        if (rebuild.isSmooth)
+            listFlowAngles.swap(listFlowAnglesPending);
+        else
+            listFlowAngles.clear();
+        flowFieldCount = rebuild.flowFieldCount;
+        arenaFlowField.rewind(rebuild.arenaMarker);
+        version++;
+        rebuild.isActive = false;
+
+        if (rebuild.isQueued == false)
+            return true;
+        startFlowFieldRebuild();
     }
+
+    return true;
 }
 
 
-void Level::calculateDistances() {
-    size_t indexTarget = static_cast<size_t>(targetX + targetY * tileCountX);
+//Reading the clock costs more than a step of a search, so it's only checked every so often.
+static bool isPastDeadline(Uint64 ticksDeadline, unsigned int& stepCount) {
+    return (ticksDeadline != 0 && (++stepCount & 1023) == 0 &&
+        SDL_GetPerformanceCounter() >= ticksDeadline);
+}
+
+
+void Level::beginDistances(int flowFieldID) {
+    FlowFieldRebuild& rebuild = flowFieldRebuild;
+    rebuild.flowFieldID = flowFieldID;
+    rebuild.isCalculatingDirections = false;
+    rebuild.isCalculatingSmooth = false;
+    arenaFlowField.rewind(rebuild.arenaMarker);
+
+    unsigned int* listDistances = listFlowDistancesPending.data() + flowFieldID * listTiles.size();
+
+    //The weighted search costs more than a BFS, so it's only used when it would find something
+    //different.
+    rebuild.isUniform = (useFlowFieldDiagonal == false && tileCountWeighted == 0);
+    if (rebuild.isUniform) {
+        //Create a queue that will contain the indices to be checked.  Every tile is queued at most 
+        //once, so it's a flat list in the flow field's scratch arena that's read from the front.
+        rebuild.listQueue = static_cast<int*>(arenaFlowField.allocate(listTiles.size() * sizeof(int), alignof(int)));
+        rebuild.queueFront = 0;
+        rebuild.queueBack = 0;
+
+        rebuild.listVisited = nullptr;
+        if (workerPoolFlowField != nullptr) {
+            size_t wordCount = (listTiles.size() + 31) / 32;
+            void* memory = arenaFlowField.allocate(wordCount * sizeof(std::atomic<unsigned int>),
+                alignof(std::atomic<unsigned int>));
+            rebuild.listVisited = static_cast<std::atomic<unsigned int>*>(memory);
+            for (size_t count = 0; count < wordCount; count++)
+                new (&rebuild.listVisited[count]) std::atomic<unsigned int>(0);
+        }
+
+        //Set every target tile in the group to 0 and add them all to the queue, so one search
+        //finds the distance to the closest of them.
+        for (const auto& target : listTargets) {
+            if (target.flowFieldID == flowFieldID && listDistances[target.index] != 0) {
+                listDistances[target.index] = 0;
+                rebuild.listQueue[rebuild.queueBack++] = target.index;
+                if (rebuild.listVisited != nullptr)
+                    rebuild.listVisited[target.index / 32].fetch_or(1u << (target.index % 32), std::memory_order_relaxed);
+            }
+        }
+        return;
+    }
 
-    //Create a queue that will contain the indices to be checked.
-    std::queue<size_t> listIndicesToCheck;
-    //Set the target tile's flow value to 0 and add it to the queue.
-    listTiles[indexTarget].flowDistance = 0;
-    listIndicesToCheck.push(indexTarget);
+    //Dial's algorithm: every step costs a small whole number, so the open tiles are kept in a ring
+    //of buckets, one per distance, that's swept in order like a BFS queue.  Each bucket is a 
+    //doubly linked list threaded through per tile links, so moving a tile to a closer bucket is 
+    //O(1), and it all lives in the flow field's scratch arena.
+    rebuild.listBucketHeads = static_cast<int*>(arenaFlowField.allocate(flowBucketCount * sizeof(int), alignof(int)));
+    rebuild.listNext = static_cast<int*>(arenaFlowField.allocate(listTiles.size() * sizeof(int), alignof(int)));
+    rebuild.listPrevious = static_cast<int*>(arenaFlowField.allocate(listTiles.size() * sizeof(int), alignof(int)));
+    std::fill(rebuild.listBucketHeads, rebuild.listBucketHeads + flowBucketCount, -1);
+    rebuild.openCount = 0;
+    rebuild.distanceCurrent = 0;
+
+    //Set every target tile in the group to 0 and add them all to the first bucket, so one search
+    //finds the distance to the closest of them.
+    for (const auto& target : listTargets) {
+        if (target.flowFieldID == flowFieldID && listDistances[target.index] != 0) {
+            listDistances[target.index] = 0;
+            linkDistanceBucket(target.index, listDistances);
+            rebuild.openCount++;
+        }
+    }
+}
+
+
+void Level::linkDistanceBucket(int index, const unsigned int* listDistances) {
+    FlowFieldRebuild& rebuild = flowFieldRebuild;
+    int& head = rebuild.listBucketHeads[listDistances[index] % flowBucketCount];
+    rebuild.listPrevious[index] = -1;
+    rebuild.listNext[index] = head;
+    if (head != -1)
+        rebuild.listPrevious[head] = index;
+    head = index;
+}
+
+
+void Level::unlinkDistanceBucket(int index, const unsigned int* listDistances) {
+    FlowFieldRebuild& rebuild = flowFieldRebuild;
+    if (rebuild.listPrevious[index] != -1)
+        rebuild.listNext[rebuild.listPrevious[index]] = rebuild.listNext[index];
+    else
+        rebuild.listBucketHeads[listDistances[index] % flowBucketCount] = rebuild.listNext[index];
+    if (rebuild.listNext[index] != -1)
+        rebuild.listPrevious[rebuild.listNext[index]] = rebuild.listPrevious[index];
+}
+
+
+bool Level::continueDistancesUniform(Uint64 ticksDeadline) {
+    if (flowFieldRebuild.listVisited != nullptr)
+        return continueDistancesUniformParallel(ticksDeadline);
+
+    FlowFieldRebuild& rebuild = flowFieldRebuild;
+    unsigned int* listDistances = listFlowDistancesPending.data() + rebuild.flowFieldID * listTiles.size();
+
+    //Every step costs the same, so a plain BFS finds the distances and each one is a step further.
+    const unsigned int distanceStep = flowStepStraight * tileCostDefault;
 
     //The offset of the neighboring tiles to be checked.
     const int listNeighbors[][2] = { { -1, 0}, {1, 0}, {0, -1}, {0, 1} };
 
-    //Loop through the queue and assign distance to each tile.
-    while (listIndicesToCheck.empty() == false) {
-        size_t indexCurrent = listIndicesToCheck.front();
-        listIndicesToCheck.pop();
+    //Loop through the queue and assign distance to each tile.  The queue is kept in the rebuild,
+    //so if time runs out the search picks up from the same frontier next frame.
+    unsigned int stepCount = 0;
+    while (rebuild.queueFront < rebuild.queueBack) {
+        if (isPastDeadline(ticksDeadline, stepCount))
+            return false;
+
+        int indexCurrent = rebuild.listQueue[rebuild.queueFront++];
 
         //Check each of the neighbors;
         for (int count = 0; count < 4; count++) {
-            int neighborX = listNeighbors[count][0] + static_cast<int>(indexCurrent % tileCountX);
-            int neighborY = listNeighbors[count][1] + static_cast<int>(indexCurrent / tileCountX);
-            size_t indexNeighbor = static_cast<size_t>(neighborX + neighborY * tileCountX);
+            int neighborX = listNeighbors[count][0] + indexCurrent % tileCountX;
+            int neighborY = listNeighbors[count][1] + indexCurrent / tileCountX;
+            int indexNeighbor = neighborX + neighborY * tileCountX;
 
             //Ensure that the neighbor exists and isn't a wall.
-            if (indexNeighbor < listTiles.size() && 
-                neighborX > -1 && neighborX < tileCountX &&
+            if (neighborX > -1 && neighborX < tileCountX &&
                 neighborY > -1 && neighborY < tileCountY &&
                 listTiles[indexNeighbor].type != TileType::wall) {
 
                 //Check if the tile has been assigned a distance yet or not.
-                if (listTiles[indexNeighbor].flowDistance == flowDistanceMax) {
+                if (listDistances[indexNeighbor] == flowDistanceMax) {
                     //If not the set it's distance and add it to the queue.
-                    listTiles[indexNeighbor].flowDistance = listTiles[indexCurrent].flowDistance + 1;
-                    listIndicesToCheck.push(indexNeighbor);
+                    listDistances[indexNeighbor] = listDistances[indexCurrent] + distanceStep;
+                    rebuild.listQueue[rebuild.queueBack++] = indexNeighbor;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+
+bool Level::continueDistancesUniformParallel(Uint64 ticksDeadline) {
+    FlowFieldRebuild& rebuild = flowFieldRebuild;
+    unsigned int* listDistances = listFlowDistancesPending.data() + rebuild.flowFieldID * listTiles.size();
+
+    //A level synchronous BFS.  The queue always holds exactly one distance between calls, and each
+    //distance is split across the team, which appends the next one to the queue.  Every tile in
+    //the next distance gets the same value whichever thread claims it, so the result doesn't
+    //depend on the order the threads run in.  Grid frontiers stay thin, a few times the map's
+    //width at most, so there's no bottom up step for when the frontier covers most of the map.
+    struct Team {
+        std::atomic<size_t> queueBackShared;
+        std::atomic<bool> isStopping;
+        SpinBarrier barrier;
+        Uint64 ticksDeadline;
+        unsigned int* listDistances;
+    } team = { {rebuild.queueBack}, {false}, SpinBarrier(getFlowFieldThreadCount()), ticksDeadline, listDistances };
+
+    //Only a pointer to the team is captured, so the job doesn't allocate.
+    workerPoolFlowField->runTeam([this, &team](int memberIndex, int memberCount) {
+        FlowFieldRebuild& rebuild = flowFieldRebuild;
+        unsigned int* listDistances = team.listDistances;
+        const unsigned int distanceStep = flowStepStraight * tileCostDefault;
+        const int listNeighbors[][2] = { { -1, 0}, {1, 0}, {0, -1}, {0, 1} };
+
+        size_t levelBegin = rebuild.queueFront;
+        size_t levelEnd = rebuild.queueBack;
+
+        //Newly claimed tiles are gathered locally and appended to the queue in batches.
+        const int batchSize = 256;
+        int listBatch[batchSize];
+        int batchCount = 0;
+        auto flushBatch = [&]() {
+            size_t position = team.queueBackShared.fetch_add(batchCount, std::memory_order_relaxed);
+            std::copy(listBatch, listBatch + batchCount, rebuild.listQueue + position);
+            batchCount = 0;
+        };
+
+        while (levelBegin < levelEnd) {
+            //Small distances aren't worth splitting.
+            size_t levelCount = levelEnd - levelBegin;
+            size_t indexBegin = levelBegin, indexEnd = levelEnd;
+            if (levelCount >= parallelFrontierMin) {
+                indexBegin = levelBegin + levelCount * memberIndex / memberCount;
+                indexEnd = levelBegin + levelCount * (memberIndex + 1) / memberCount;
+            }
+            else if (memberIndex != 0)
+                indexEnd = indexBegin;
+
+            for (size_t indexQueue = indexBegin; indexQueue < indexEnd; indexQueue++) {
+                int indexCurrent = rebuild.listQueue[indexQueue];
+                unsigned int distanceNew = listDistances[indexCurrent] + distanceStep;
+
+                for (int count = 0; count < 4; count++) {
+                    int neighborX = listNeighbors[count][0] + indexCurrent % tileCountX;
+                    int neighborY = listNeighbors[count][1] + indexCurrent / tileCountX;
+                    int indexNeighbor = neighborX + neighborY * tileCountX;
+                    if (neighborX < 0 || neighborX >= tileCountX ||
+                        neighborY < 0 || neighborY >= tileCountY ||
+                        listTiles[indexNeighbor].type == TileType::wall)
+                        continue;
+
+                    //Whoever sets the tile's bit first owns it, and is the only one to write it.
+                    std::atomic<unsigned int>& visited = rebuild.listVisited[indexNeighbor / 32];
+                    unsigned int bit = 1u << (indexNeighbor % 32);
+                    if ((visited.load(std::memory_order_relaxed) & bit) != 0 ||
+                        (visited.fetch_or(bit, std::memory_order_relaxed) & bit) != 0)
+                        continue;
+
+                    listDistances[indexNeighbor] = distanceNew;
+                    listBatch[batchCount++] = indexNeighbor;
+                    if (batchCount == batchSize)
+                        flushBatch();
                 }
             }
+            if (batchCount > 0)
+                flushBatch();
+
+            //The deadline is only checked between distances, so the queue is left holding one.
+            if (memberIndex == 0 && team.ticksDeadline != 0 && SDL_GetPerformanceCounter() >= team.ticksDeadline)
+                team.isStopping.store(true, std::memory_order_relaxed);
+
+            //Wait for the distance to be finished, agree on where the next one ends, then wait
+            //again so nobody appends to it before everyone has read that.
+            team.barrier.arrive();
+            levelBegin = levelEnd;
+            levelEnd = team.queueBackShared.load(std::memory_order_relaxed);
+            bool isStoppingNow = team.isStopping.load(std::memory_order_relaxed);
+            team.barrier.arrive();
+
+            if (isStoppingNow)
+                break;
+        }
+
+        if (memberIndex == 0) {
+            rebuild.queueFront = levelBegin;
+            rebuild.queueBack = levelEnd;
+        }
+    });
+
+    return (rebuild.queueFront == rebuild.queueBack);
+}
+
+
+bool Level::continueDistances(Uint64 ticksDeadline) {
+    FlowFieldRebuild& rebuild = flowFieldRebuild;
+    unsigned int* listDistances = listFlowDistancesPending.data() + rebuild.flowFieldID * listTiles.size();
+
+    //The offset of the neighboring tiles to be checked, straight ones first.
+    const int listNeighbors[][2] = {
+        {-1, 0}, {1, 0}, {0, -1}, {0, 1},
+        {-1, -1}, {1, -1}, {-1, 1}, {1, 1} };
+    int neighborCount = (useFlowFieldDiagonal ? 8 : 4);
+
+    //Take the tiles out in order of distance and relax each of their neighbors.
+    unsigned int stepCount = 0;
+    while (rebuild.openCount > 0) {
+        int indexCurrent = rebuild.listBucketHeads[rebuild.distanceCurrent % flowBucketCount];
+        if (indexCurrent == -1) {
+            rebuild.distanceCurrent++;
+            continue;
         }
+        if (isPastDeadline(ticksDeadline, stepCount))
+            return false;
+
+        unlinkDistanceBucket(indexCurrent, listDistances);
+        rebuild.openCount--;
+
+        int currentX = indexCurrent % tileCountX;
+        int currentY = indexCurrent / tileCountX;
+
+        //Check each of the neighbors;
+        for (int count = 0; count < neighborCount; count++) {
+            int offsetX = listNeighbors[count][0];
+            int offsetY = listNeighbors[count][1];
+            int neighborX = currentX + offsetX;
+            int neighborY = currentY + offsetY;
+
+            //Ensure that the neighbor exists and isn't a wall.
+            if (neighborX < 0 || neighborX >= tileCountX ||
+                neighborY < 0 || neighborY >= tileCountY)
+                continue;
+            int indexNeighbor = neighborX + neighborY * tileCountX;
+            if (listTiles[indexNeighbor].type == TileType::wall)
+                continue;
+
+            //Don't let a diagonal step squeeze past the corner of a wall.
+            bool isDiagonal = (offsetX != 0 && offsetY != 0);
+            if (isDiagonal && (listTiles[currentX + neighborY * tileCountX].type == TileType::wall ||
+                listTiles[neighborX + currentY * tileCountX].type == TileType::wall))
+                continue;
+
+            //Units leaving the neighbor have to cross it, so the step costs the neighbor's cost.
+            unsigned int distanceNew = rebuild.distanceCurrent +
+                (isDiagonal ? flowStepDiagonal : flowStepStraight) * listTiles[indexNeighbor].cost;
+            if (distanceNew < listDistances[indexNeighbor]) {
+                if (listDistances[indexNeighbor] == flowDistanceMax)
+                    rebuild.openCount++;
+                else
+                    unlinkDistanceBucket(indexNeighbor, listDistances);
+
+                listDistances[indexNeighbor] = distanceNew;
+                linkDistanceBucket(indexNeighbor, listDistances);
+            }
+        }
+    }
+
+    return true;
+}
+
+
+bool Level::continueFlowDirections(Uint64 ticksDeadline) {
+    FlowFieldRebuild& rebuild = flowFieldRebuild;
+    size_t tileCount = listTiles.size();
+
+    //Each tile's direction only reads distances, so the pass is cut into blocks of whole rows that
+    //are handed out to the workers.  With a deadline it does a block per thread between checks.
+    size_t blockSize = std::max(flowDirectionsBlockSize / tileCountX, (size_t)1) * tileCountX;
+    while (rebuild.directionsNext < tileCount) {
+        size_t indexBegin = rebuild.directionsNext;
+        size_t blockCount = (ticksDeadline == 0 ? (tileCount - indexBegin + blockSize - 1) / blockSize :
+            (size_t)getFlowFieldThreadCount());
+        size_t indexEnd = std::min(tileCount, indexBegin + blockCount * blockSize);
+
+        struct Round {
+            size_t indexBegin, indexEnd, blockSize;
+        } round = { indexBegin, indexEnd, blockSize };
+        auto calculateBlock = [this, &round](int block) {
+            size_t blockBegin = round.indexBegin + block * round.blockSize;
+            calculateFlowDirectionsRange(blockBegin, std::min(blockBegin + round.blockSize, round.indexEnd));
+        };
+        if (workerPoolFlowField != nullptr)
+            workerPoolFlowField->parallelFor((int)blockCount, calculateBlock);
+        else {
+            for (size_t block = 0; block < blockCount; block++)
+                calculateBlock((int)block);
+        }
+
+        rebuild.directionsNext = indexEnd;
+        if (indexEnd < tileCount && ticksDeadline != 0 && SDL_GetPerformanceCounter() >= ticksDeadline)
+            return false;
     }
+
+    return true;
 }
 
 
-void Level::calculateFlowDirections() {
+void Level::calculateFlowDirectionsRange(size_t indexBegin, size_t indexEnd) {
+    size_t planeOffset = flowFieldRebuild.flowFieldID * listTiles.size();
+    const unsigned int* listDistances = listFlowDistancesPending.data() + planeOffset;
+    signed char* listDirectionsX = listFlowDirectionsXPending.data() + planeOffset;
+    signed char* listDirectionsY = listFlowDirectionsYPending.data() + planeOffset;
+
     //The offset of the neighboring tiles to be checked.
     const int listNeighbors[][2] = {
         {-1, 0}, {-1, 1}, {0, 1}, {1, 1},
         {1, 0}, {1, -1}, {0, -1}, {-1, -1} };
 
-    for (size_t indexCurrent = 0; indexCurrent < listTiles.size(); indexCurrent++) {
+    for (size_t indexCurrent = indexBegin; indexCurrent < indexEnd; indexCurrent++) {
         //Ensure that the tile has been assigned a distance value.
-        if (listTiles[indexCurrent].flowDistance != flowDistanceMax) {
+        if (listDistances[indexCurrent] != flowDistanceMax) {
+            if (useFlowFieldDiagonal) {
+                calculateFlowDirectionDiagonal(indexCurrent, listDistances, listDirectionsX, listDirectionsY);
+                continue;
+            }
+
             //Set the best distance to the current tile's distance.
-            unsigned char flowFieldBest = listTiles[indexCurrent].flowDistance;
+            unsigned int flowFieldBest = listDistances[indexCurrent];
 
             //Check each of the neighbors;
             for (int count = 0; count < 8; count++) {
@@ -397,10 +1400,10 @@ void Level::calculateFlowDirections() {
                     neighborX > -1 && neighborX < tileCountX &&
                     neighborY > -1 && neighborY < tileCountY) {
                     //If the current neighbor's distance is lower than the best then use it.
-                    if (listTiles[indexNeighbor].flowDistance < flowFieldBest) {
-                        flowFieldBest = listTiles[indexNeighbor].flowDistance;
-                        listTiles[indexCurrent].flowDirectionX = offsetX;
-                        listTiles[indexCurrent].flowDirectionY = offsetY;
+                    if (listDistances[indexNeighbor] < flowFieldBest) {
+                        flowFieldBest = listDistances[indexNeighbor];
+                        listDirectionsX[indexCurrent] = (signed char)offsetX;
+                        listDirectionsY[indexCurrent] = (signed char)offsetY;
                     }
                 }
             }
@@ -409,17 +1412,397 @@ void Level::calculateFlowDirections() {
 }
 
 
+void Level::calculateDistances(int flowFieldID) {
+    //Runs one field's distance pass on its own into the pending planes, without a deadline.
+    ArenaScope arenaScope(arenaFlowField);
+    flowFieldRebuild.arenaMarker = arenaFlowField.getMarker();
+    beginDistances(flowFieldID);
+    if (flowFieldRebuild.isUniform)
+        continueDistancesUniform(0);
+    else
+        continueDistances(0);
+}
+
+
+void Level::calculateFlowDirections(int flowFieldID) {
+    flowFieldRebuild.flowFieldID = flowFieldID;
+    flowFieldRebuild.directionsNext = 0;
+    continueFlowDirections(0);
+}
+
+
+void Level::calculateFlowDirectionDiagonal(size_t indexCurrent, const unsigned int* listDistances,
+    signed char* listDirectionsX, signed char* listDirectionsY) {
+    int currentX = static_cast<int>(indexCurrent % tileCountX);
+    int currentY = static_cast<int>(indexCurrent / tileCountX);
+    unsigned int cost = listTiles[indexCurrent].cost;
+
+    //Point down the step the search actually took, which is the neighbor with the lowest distance
+    //plus the cost of getting there, skipping diagonals past a wall's corner as the search did.
+    unsigned int flowFieldBest = flowDistanceMax;
+    for (int offsetY = -1; offsetY <= 1; offsetY++) {
+        for (int offsetX = -1; offsetX <= 1; offsetX++) {
+            int neighborX = currentX + offsetX;
+            int neighborY = currentY + offsetY;
+            if ((offsetX == 0 && offsetY == 0) ||
+                neighborX < 0 || neighborX >= tileCountX ||
+                neighborY < 0 || neighborY >= tileCountY)
+                continue;
+
+            size_t indexNeighbor = static_cast<size_t>(neighborX + neighborY * tileCountX);
+            if (listDistances[indexNeighbor] >= listDistances[indexCurrent])
+                continue;
+
+            bool isDiagonal = (offsetX != 0 && offsetY != 0);
+            if (isDiagonal && (listTiles[currentX + neighborY * tileCountX].type == TileType::wall ||
+                listTiles[neighborX + currentY * tileCountX].type == TileType::wall))
+                continue;
 
-Vector2D Level::getFlowNormal(int x, int y) const {
+            unsigned int flowFieldNeighbor = listDistances[indexNeighbor] +
+                (isDiagonal ? flowStepDiagonal : flowStepStraight) * cost;
+            if (flowFieldNeighbor < flowFieldBest) {
+                flowFieldBest = flowFieldNeighbor;
+                listDirectionsX[indexCurrent] = (signed char)offsetX;
+                listDirectionsY[indexCurrent] = (signed char)offsetY;
+            }
+        }
+    }
+}
+
+
+
+void Level::beginSmoothField() {
+    FlowFieldRebuild& rebuild = flowFieldRebuild;
+    rebuild.isCalculatingSmooth = true;
+    arenaFlowField.rewind(rebuild.arenaMarker);
+
+    //The plain field's scratch is done with, so the heap takes its place in the arena.
+    size_t tileCount = listTiles.size();
+    rebuild.listSmoothHeap = static_cast<int*>(arenaFlowField.allocate(tileCount * sizeof(int), alignof(int)));
+    rebuild.listSmoothHeapPositions = static_cast<int*>(arenaFlowField.allocate(tileCount * sizeof(int), alignof(int)));
+    std::fill(rebuild.listSmoothHeapPositions, rebuild.listSmoothHeapPositions + tileCount, smoothHeapUnseen);
+    rebuild.smoothHeapCount = 0;
+    rebuild.anglesNext = 0;
+    listSmoothDistances.assign(tileCount, std::numeric_limits<float>::infinity());
+
+    for (const auto& target : listTargets) {
+        if (target.flowFieldID == rebuild.flowFieldID) {
+            listSmoothDistances[target.index] = 0.0f;
+            updateSmoothHeap(target.index);
+        }
+    }
+}
+
+
+bool Level::continueSmoothField(Uint64 ticksDeadline) {
+    FlowFieldRebuild& rebuild = flowFieldRebuild;
+
+    //Fast marching: the closest open tile's distance is final, so freeze it and solve again for
+    //each of its neighbors that isn't a wall or frozen yet.
+    const int listNeighbors[][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+    unsigned int stepCount = 0;
+    while (rebuild.smoothHeapCount > 0) {
+        if (isPastDeadline(ticksDeadline, stepCount))
+            return false;
+
+        int indexCurrent = popSmoothHeap();
+        int currentX = indexCurrent % tileCountX;
+        int currentY = indexCurrent / tileCountX;
+        for (const auto& offset : listNeighbors) {
+            int neighborX = currentX + offset[0];
+            int neighborY = currentY + offset[1];
+            if (neighborX < 0 || neighborX >= tileCountX ||
+                neighborY < 0 || neighborY >= tileCountY)
+                continue;
+            int indexNeighbor = neighborX + neighborY * tileCountX;
+            if (listTiles[indexNeighbor].type == TileType::wall ||
+                rebuild.listSmoothHeapPositions[indexNeighbor] == smoothHeapFrozen)
+                continue;
+
+            float distanceNew = solveEikonal(neighborX, neighborY);
+            if (distanceNew < listSmoothDistances[indexNeighbor]) {
+                listSmoothDistances[indexNeighbor] = distanceNew;
+                updateSmoothHeap(indexNeighbor);
+            }
+        }
+    }
+
+    //Then each tile's direction down the slope.
+    size_t tileCount = listTiles.size();
+    unsigned char* listAngles = listFlowAnglesPending.data() + rebuild.flowFieldID * tileCount;
+    while (rebuild.anglesNext < tileCount) {
+        if (isPastDeadline(ticksDeadline, stepCount))
+            return false;
+
+        int index = (int)rebuild.anglesNext++;
+        listAngles[index] = calculateSmoothAngle(index % tileCountX, index / tileCountX);
+    }
+
+    return true;
+}
+
+
+float Level::solveEikonal(int x, int y) const {
+    //Only frozen neighbors count, and the closer one on each axis is the one upwind.
+    const int* listPositions = flowFieldRebuild.listSmoothHeapPositions;
+    auto getDistanceFrozen = [&](int neighborX, int neighborY) {
+        if (neighborX < 0 || neighborX >= tileCountX || neighborY < 0 || neighborY >= tileCountY)
+            return std::numeric_limits<float>::infinity();
+        int index = neighborX + neighborY * tileCountX;
+        return (listPositions[index] == smoothHeapFrozen ?
+            listSmoothDistances[index] : std::numeric_limits<float>::infinity());
+    };
+    float distanceX = std::min(getDistanceFrozen(x - 1, y), getDistanceFrozen(x + 1, y));
+    float distanceY = std::min(getDistanceFrozen(x, y - 1), getDistanceFrozen(x, y + 1));
+
+    //Crossing the tile costs its cost, as in the plain field.  When the two axes are far enough
+    //apart the front only comes from one of them, and otherwise from both:
+    //(d - distanceX)^2 + (d - distanceY)^2 = step^2.
+    float step = (float)listTiles[x + y * tileCountX].cost / tileCostDefault;
+    float distanceMin = std::min(distanceX, distanceY);
+    float difference = distanceX - distanceY;
+    if (distanceMin == std::numeric_limits<float>::infinity() || std::fabs(difference) >= step)
+        return distanceMin + step;
+    return 0.5f * (distanceX + distanceY + std::sqrt(2.0f * step * step - difference * difference));
+}
+
+
+unsigned char Level::calculateSmoothAngle(int x, int y) const {
+    int index = x + y * tileCountX;
+    size_t indexPlane = flowFieldRebuild.flowFieldID * listTiles.size() + index;
+    float distance = listSmoothDistances[index];
+    if (distance == std::numeric_limits<float>::infinity())
+        return 0;
+
+    //Step toward the lower neighbor on each axis, by how much lower it is.  Walls and the edge of
+    //the map are infinitely far, so the direction never points straight into one.
+    auto getDistance = [&](int neighborX, int neighborY) {
+        if (neighborX < 0 || neighborX >= tileCountX || neighborY < 0 || neighborY >= tileCountY)
+            return std::numeric_limits<float>::infinity();
+        return listSmoothDistances[neighborX + neighborY * tileCountX];
+    };
+    float distanceLeft = getDistance(x - 1, y), distanceRight = getDistance(x + 1, y);
+    float distanceUp = getDistance(x, y - 1), distanceDown = getDistance(x, y + 1);
+    float directionX = 0.0f, directionY = 0.0f;
+    if (std::min(distanceLeft, distanceRight) < distance)
+        directionX = (distanceLeft < distanceRight ? distanceLeft - distance : distance - distanceRight);
+    if (std::min(distanceUp, distanceDown) < distance)
+        directionY = (distanceUp < distanceDown ? distanceUp - distance : distance - distanceDown);
+
+    //Flat spots fall back on the plain field.
+    if (directionX == 0.0f && directionY == 0.0f) {
+        directionX = (float)listFlowDirectionsXPending[indexPlane];
+        directionY = (float)listFlowDirectionsYPending[indexPlane];
+        if (directionX == 0.0f && directionY == 0.0f)
+            return 0;
+    }
+
+    float turns = std::atan2(directionY, directionX) / (2.0f * 3.14159265359f);
+    return (unsigned char)((int)std::lround(turns * 256.0f) & 255);
+}
+
+
+void Level::updateSmoothHeap(int index) {
+    //Adds the tile, or moves it up after its distance went down.
+    FlowFieldRebuild& rebuild = flowFieldRebuild;
+    int* listHeap = rebuild.listSmoothHeap;
+    int* listPositions = rebuild.listSmoothHeapPositions;
+    int position = listPositions[index];
+    if (position == smoothHeapUnseen)
+        position = (int)rebuild.smoothHeapCount++;
+
+    float distance = listSmoothDistances[index];
+    while (position > 0) {
+        int positionParent = (position - 1) / 2;
+        int indexParent = listHeap[positionParent];
+        if (listSmoothDistances[indexParent] <= distance)
+            break;
+        listHeap[position] = indexParent;
+        listPositions[indexParent] = position;
+        position = positionParent;
+    }
+    listHeap[position] = index;
+    listPositions[index] = position;
+}
+
+
+int Level::popSmoothHeap() {
+    FlowFieldRebuild& rebuild = flowFieldRebuild;
+    int* listHeap = rebuild.listSmoothHeap;
+    int* listPositions = rebuild.listSmoothHeapPositions;
+    int indexTop = listHeap[0];
+    listPositions[indexTop] = smoothHeapFrozen;
+
+    //Sift the last tile down from the top.
+    int count = (int)--rebuild.smoothHeapCount;
+    if (count > 0) {
+        int index = listHeap[count];
+        float distance = listSmoothDistances[index];
+        int position = 0;
+        while (true) {
+            int positionChild = position * 2 + 1;
+            if (positionChild >= count)
+                break;
+            if (positionChild + 1 < count &&
+                listSmoothDistances[listHeap[positionChild + 1]] < listSmoothDistances[listHeap[positionChild]])
+                positionChild++;
+            if (distance <= listSmoothDistances[listHeap[positionChild]])
+                break;
+            listHeap[position] = listHeap[positionChild];
+            listPositions[listHeap[position]] = position;
+            position = positionChild;
+        }
+        listHeap[position] = index;
+        listPositions[index] = position;
+    }
+
+    return indexTop;
+}
+
+
+//Unit vectors for the smooth field's angles, in 256ths of a turn.
+static const struct AngleTable {
+    float listX[256], listY[256];
+    AngleTable() {
+        for (int count = 0; count < 256; count++) {
+            listX[count] = std::cos(count * 2.0f * 3.14159265359f / 256.0f);
+            listY[count] = std::sin(count * 2.0f * 3.14159265359f / 256.0f);
+        }
+    }
+} angleTable;
+
+
+Vector2D Level::getFlowNormal(int x, int y, int flowFieldID) const {
     size_t index = static_cast<size_t>(x + y * tileCountX);
     if (index < listTiles.size() &&
+        flowFieldID > -1 && flowFieldID < flowFieldCount &&
         x > -1 && x < tileCountX &&
-        y > -1 && y < tileCountY)
-        return Vector2D((float)listTiles[index].flowDirectionX, (float)listTiles[index].flowDirectionY).normalize();
+        y > -1 && y < tileCountY) {
+        if (pathfinderHierarchical != nullptr)
+            return pathfinderHierarchical->getFlowNormal(x, y, flowFieldID);
+
+        size_t indexPlane = flowFieldID * listTiles.size() + index;
+        return Vector2D((float)listFlowDirectionsX[indexPlane], (float)listFlowDirectionsY[indexPlane]).normalize();
+    }
 
     return Vector2D();
 }
 
+Vector2D Level::getFlowNormal(Vector2D pos, int flowFieldID) const {
+    int tileX = (int)std::floor(pos.x);
+    int tileY = (int)std::floor(pos.y);
+    if (listFlowAngles.empty() || pathfinderHierarchical != nullptr ||
+        flowFieldID < 0 || flowFieldID >= flowFieldCount ||
+        tileX < 0 || tileX >= tileCountX || tileY < 0 || tileY >= tileCountY)
+        return getFlowNormal(tileX, tileY, flowFieldID);
+
+    size_t planeOffset = flowFieldID * listTiles.size();
+    auto hasDirection = [&](int index) {
+        return (listFlowDirectionsX[planeOffset + index] != 0 || listFlowDirectionsY[planeOffset + index] != 0);
+    };
+    int index = tileX + tileY * tileCountX;
+    if (hasDirection(index) == false)
+        return Vector2D();
+
+    //Weigh the directions at the four tile centers around the position by how close it is to
+    //each.  Walls and tiles with no direction are left out.
+    float sampleX = pos.x - 0.5f, sampleY = pos.y - 0.5f;
+    int cornerX = (int)std::floor(sampleX), cornerY = (int)std::floor(sampleY);
+    float fractionX = sampleX - cornerX, fractionY = sampleY - cornerY;
+    float directionX = 0.0f, directionY = 0.0f;
+    for (int offsetY = 0; offsetY < 2; offsetY++) {
+        for (int offsetX = 0; offsetX < 2; offsetX++) {
+            int x = cornerX + offsetX, y = cornerY + offsetY;
+            if (x < 0 || x >= tileCountX || y < 0 || y >= tileCountY || hasDirection(x + y * tileCountX) == false)
+                continue;
+            float weight = (offsetX ? fractionX : 1.0f - fractionX) * (offsetY ? fractionY : 1.0f - fractionY);
+            unsigned char angle = listFlowAngles[planeOffset + x + y * tileCountX];
+            directionX += angleTable.listX[angle] * weight;
+            directionY += angleTable.listY[angle] * weight;
+        }
+    }
+
+    //Directions either side of a ridge can cancel out, and then the tile's own is the way to go.
+    unsigned char angle = listFlowAngles[planeOffset + index];
+    Vector2D directionTile(angleTable.listX[angle], angleTable.listY[angle]);
+    Vector2D direction(directionX, directionY);
+    if (direction.magnitude() < 0.01f || direction.dot(directionTile) <= 0.0f)
+        return directionTile;
+    return direction.normalize();
+}
+
+void Level::setTileCost(int x, int y, int cost) {
+    size_t index = static_cast<size_t>(x + y * tileCountX);
+    if (index < listTiles.size() &&
+        x > -1 && x < tileCountX &&
+        y > -1 && y < tileCountY) {
+        unsigned char costNew = (unsigned char)std::min(std::max(cost, tileCostMin), tileCostMax);
+        if (listTiles[index].cost != costNew) {
+            tileCountWeighted += (costNew != tileCostDefault) - (listTiles[index].cost != tileCostDefault);
+            listTiles[index].cost = costNew;
+            version++;
+            if (pathfinderHierarchical != nullptr)
+                pathfinderHierarchical->updateTile(x, y);
+            else
+                requestFlowFieldRebuild();
+        }
+    }
+}
+
+
+int Level::getTileCost(int x, int y) const {
+    size_t index = static_cast<size_t>(x + y * tileCountX);
+    if (index < listTiles.size() &&
+        x > -1 && x < tileCountX &&
+        y > -1 && y < tileCountY)
+        return listTiles[index].cost;
+
+    return tileCostDefault;
+}
+
+
+void Level::setFlowFieldDiagonal(bool useDiagonal) {
+    if (useFlowFieldDiagonal != useDiagonal) {
+        useFlowFieldDiagonal = useDiagonal;
+        requestFlowFieldRebuild();
+    }
+}
+
+
+bool Level::isFlowFieldDiagonal() const {
+    return useFlowFieldDiagonal;
+}
+
+
+void Level::setFlowFieldSmooth(bool useSmooth) {
+    if (useFlowFieldSmooth != useSmooth) {
+        useFlowFieldSmooth = useSmooth;
+        requestFlowFieldRebuild();
+    }
+}
+
+
+bool Level::isFlowFieldSmooth() const {
+    return useFlowFieldSmooth;
+}
+
+
+void Level::setFlowFieldHierarchical(bool useHierarchical) {
+    if ((pathfinderHierarchical != nullptr) != useHierarchical) {
+        if (useHierarchical)
+            pathfinderHierarchical = std::make_unique<HierarchicalPathfinder>(*this);
+        else
+            pathfinderHierarchical.reset();
+        calculateFlowField();
+    }
+}
+
+
+bool Level::isFlowFieldHierarchical() const {
+    return (pathfinderHierarchical != nullptr);
+}
+
+
 void Level::clearWalls() {
     // Clear all walls by setting all tiles to empty
     for (auto& tile : listTiles) {
@@ -427,7 +1810,12 @@ void Level::clearWalls() {
             tile.type = TileType::empty;
         }
     }
-    calculateFlowField();
+    wallGrid.clear();
+    wallDistanceField.rebuild();
+    version++;
+    isReachableValid = false;
+    reachableCandidateIndex = -1;
+    requestFlowFieldRebuild();
 }
 
 void Level::loadBackground(SDL_Renderer* renderer, const std::string& backgroundFile) {
@@ -440,7 +1828,7 @@ void Level::loadBackground(SDL_Renderer* renderer, const std::string& background
     // Try to load the background texture
     textureBackground = TextureLoader::loadTexture(renderer, backgroundFile);
     if (textureBackground == nullptr) {
-        std::cout << "Failed to load background texture: " << backgroundFile << std::endl;
+        LOG_WARNING(LogModule::level, "Failed to load background texture: %s", backgroundFile.c_str());
     }
 }
 
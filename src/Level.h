@@ -1,10 +1,17 @@
 #pragma once
-#include <queue>
 #include <vector>
 #include <string>
+#include <memory>
+#include <atomic>
+#include <utility>
 #include "SDL2/SDL.h"
 #include "Vector2D.h"
 #include "TextureLoader.h"
+#include "FrameArena.h"
+#include "WallGrid.h"
+#include "WallDistanceField.h"
+class HierarchicalPathfinder;
+class WorkerPool;
 
 
 
@@ -14,49 +21,275 @@ private:
 	enum class TileType : char {
 		empty,
 		wall,
-		enemySpawner
+		enemySpawner,
+		target
 	};
 
-	static const unsigned char flowDistanceMax = 255;
+	//Paths on large maps are far longer than 255 tiles, so distances need the full range.
+	static constexpr unsigned int flowDistanceMax = 0xFFFFFFFF;
+	//Distances are in fifths of a tile so a diagonal step, about 1.4 tiles, is a whole number too.
+	static constexpr unsigned int flowStepStraight = 5, flowStepDiagonal = 7;
 
 	struct Tile {
 		TileType type = TileType::empty;
-		int flowDirectionX = 0;
-		int flowDirectionY = 0;
-		unsigned char flowDistance = flowDistanceMax;
+		unsigned char cost = tileCostDefault;
 	};
 
+	friend class FlowFieldBenchmark;
+	friend class HierarchicalPathfinder;
+
 
 public:
+	//The cost of moving through a tile, relative to open ground.  A road can be cheaper than the
+	//default, and mud or a turret's field of fire dearer.
+	static constexpr int tileCostMin = 1, tileCostDefault = 2, tileCostMax = 16;
+	//Maps with at least this many tiles use the hierarchical path layer, since a full flow field
+	//rebuild on every wall edit stops being interactive around this size.
+	static constexpr int hierarchicalTileCountMin = 512 * 512;
+
 	// Modified constructor to accept background filename
 	Level(SDL_Renderer* renderer, int tileCountX, int tileCountY, const std::string& backgroundFile);
 	~Level();
 
 	void draw(SDL_Renderer* renderer, int tileSize);
-	void setTileWall(int x, int y, bool isWall);
-	bool isTileWall(int x, int y) const;
-	Vector2D getRandomEnemySpawnerLocation() const;
+	//Returns true if the tile changed.  Spawners and targets can't be walled over.
+	bool setTileWall(int x, int y, bool isWall);
+	bool isTileWall(int x, int y) const { return wallGrid.isWall(x, y); }
+	//False if walling the tile would cut off a spawner that can reach a target now.  Tiles that
+	//can't be walled, or already are, wouldn't change anything, so they return true.
+	bool canPlaceWall(int x, int y) const;
+	//Finds the routes enemies would take from each spawner to field 0's targets if the tile were
+	//walled, without touching the flow field.  Each route's tiles, as x + y * tileCountX from the
+	//spawner on, are put in listRouteTiles, and listRouteEnds gets where each route ends.  A
+	//spawner with no route gets an empty one.  lengthDelta is how much longer the longest detour
+	//makes a route, in tiles of default cost.  Returns false if there's nothing to preview: the
+	//tile isn't empty, or the field is mid rebuild or comes from the hierarchical layer.
+	bool previewWall(int x, int y, std::vector<int>& listRouteTiles, std::vector<int>& listRouteEnds,
+		float& lengthDelta) const;
+	//Goes up whenever the tiles or the flow field change, so cached results can tell they're stale.
+	unsigned int getVersion() const;
+	void setTileEnemySpawner(int x, int y, bool isEnemySpawner, float weight = 1.0f);
+	//Targets are grouped by flow field ID, and each group gets its own flow field.
+	void setTileTarget(int x, int y, bool isTarget, int flowFieldID = 0);
+	//Picks a spawner at random in proportion to the spawners' weights, or -1 if there are none.
+	//Spawner IDs are only good until the spawners change.
+	int getRandomEnemySpawner() const;
+	Vector2D getEnemySpawnerLocation(int enemySpawnerID) const;
+	int getEnemySpawnerCount() const;
+	//The spawner's route to field 0's targets as a polyline, from the center of the spawner's tile
+	//to the center of a target's, or nullptr if it has none.  The version changes whenever the
+	//points do, so a unit following the path can tell when to find its place on it again.  The
+	//points stay put until the next updateFlowField.
+	const Vector2D* getEnemyPath(int enemySpawnerID, int& pointCount, unsigned int& pathVersion) const;
 	void clearWalls();
+	//Costs are clamped to tileCostMin..tileCostMax.
+	void setTileCost(int x, int y, int cost);
+	int getTileCost(int x, int y) const;
+	//With diagonals the flow field searches all 8 neighbors, but never cuts past a wall's corner.
+	void setFlowFieldDiagonal(bool useDiagonal);
+	bool isFlowFieldDiagonal() const;
+	//A smooth field also solves for distances with fast marching, which spreads in every direction
+	//rather than just 4 or 8, and keeps the direction down its slope at each tile.  Units that
+	//sample it between tile centers follow smooth lines instead of zig-zagging.  It adds a serial
+	//pass to every rebuild, and the hierarchical layer ignores it.
+	void setFlowFieldSmooth(bool useSmooth);
+	bool isFlowFieldSmooth() const;
+	//The hierarchical layer always searches 4 neighbors.
+	void setFlowFieldHierarchical(bool useHierarchical);
+	bool isFlowFieldHierarchical() const;
+	//With a budget, edits rebuild the flow field a slice at a time in updateFlowField, and units
+	//keep following the old field until the new one is finished.  0 rebuilds on every edit.
+	void setFlowFieldBudget(int microseconds);
+	int getFlowFieldBudget() const;
+	//Call once a frame.  Spends at most the budget on a rebuild in progress.
+	void updateFlowField();
+	bool isFlowFieldRebuilding() const;
+	//The threads that rebuild the flow field, counting the caller.  It's 1 unless set, and 0 uses
+	//one per core.
+	void setFlowFieldThreadCount(int threadCount);
+	int getFlowFieldThreadCount() const;
 	void loadBackground(SDL_Renderer* renderer, const std::string& backgroundFile);
 
+	//The first target, which is the city at the center of the map.
 	Vector2D getTargetPos() const;
-	Vector2D getFlowNormal(int x, int y) const;
+	Vector2D getTargetPos(int index) const;
+	int getTargetCount() const;
+	bool isTileTarget(int x, int y, int flowFieldID = 0) const;
+	//How far each point is from the walls, for keeping units clear of them.
+	const WallDistanceField& getWallDistanceField() const;
+	int getFlowFieldCount() const;
+	Vector2D getFlowNormal(int x, int y, int flowFieldID = 0) const;
+	//Blends the smooth field's directions at the four tile centers around the position.  Without
+	//a smooth field it's the direction of the tile the position is on.
+	Vector2D getFlowNormal(Vector2D pos, int flowFieldID = 0) const;
 
 
 private:
 	TileType getTileType(int x, int y) const;
-	void setTileType(int x, int y, TileType tileType);
+	void setTileType(int x, int y, TileType tileType, int targetFlowFieldID = 0);
+	void updateTileSets(int index, TileType tileTypeOld, TileType tileTypeNew, int targetFlowFieldID);
+	bool isWallBypassable(int x, int y) const;
+	void calculateReachable(std::vector<uint64_t>& listReached, int xBlocked, int yBlocked) const;
+	//Returns the target the route from the start reached, or -1.
+	int searchPreviewRoute(int indexStart, int indexBlocked) const;
+	void calculateEnemySpawnerAliasTable();
+	void calculateEnemyPaths();
+	bool traceEnemyPath(int indexStart);
+	bool isEnemyPathClear(Vector2D posStart, Vector2D posEnd) const;
 	void drawTile(SDL_Renderer* renderer, int x, int y, int tileSize);
+	//Rebuilds every field at once, whatever the budget.
 	void calculateFlowField();
-	void calculateDistances();
-	void calculateFlowDirections();
+	void requestFlowFieldRebuild();
+	void startFlowFieldRebuild();
+	//Returns true once the new fields are swapped in.  A deadline of 0 runs to the end.
+	bool continueFlowFieldRebuild(Uint64 ticksDeadline);
+	void beginDistances(int flowFieldID);
+	bool continueDistancesUniform(Uint64 ticksDeadline);
+	bool continueDistancesUniformParallel(Uint64 ticksDeadline);
+	bool continueDistances(Uint64 ticksDeadline);
+	void linkDistanceBucket(int index, const unsigned int* listDistances);
+	void unlinkDistanceBucket(int index, const unsigned int* listDistances);
+	bool continueFlowDirections(Uint64 ticksDeadline);
+	void calculateFlowDirectionsRange(size_t indexBegin, size_t indexEnd);
+	//Run one pass of one field into the pending planes, so the benchmark can time them apart.
+	void calculateDistances(int flowFieldID = 0);
+	void calculateFlowDirections(int flowFieldID = 0);
+	void calculateFlowDirectionDiagonal(size_t indexCurrent, const unsigned int* listDistances,
+		signed char* listDirectionsX, signed char* listDirectionsY);
+	void beginSmoothField();
+	bool continueSmoothField(Uint64 ticksDeadline);
+	float solveEikonal(int x, int y) const;
+	unsigned char calculateSmoothAngle(int x, int y) const;
+	void updateSmoothHeap(int index);
+	int popSmoothHeap();
 
 
 	std::vector<Tile> listTiles;
 	const int tileCountX, tileCountY;
+	//Mirrors the wall tiles in listTiles.
+	WallGrid wallGrid;
+	WallDistanceField wallDistanceField;
+	//The tiles a target can be reached from, for checking wall placements.  It's patched as walls
+	//are placed where that's cheap, and otherwise rebuilt the next time a check needs it.  The
+	//candidate is what it would be with the last checked tile walled, so placing that wall next
+	//doesn't need another search.
+	mutable std::vector<uint64_t> listReachable, listReachableCandidate;
+	mutable bool isReachableValid = false;
+	mutable int reachableCandidateIndex = -1;
+	//Scratch for previewing a wall, kept between previews so hovering doesn't allocate.  The live
+	//flow field is only read, and a search only writes the tiles it reaches, stamped with its own
+	//number, so nothing needs clearing between searches.
+	mutable std::vector<unsigned int> listPreviewCosts, listPreviewStamps;
+	mutable std::vector<int> listPreviewParents;
+	mutable std::vector<std::pair<uint64_t, int>> listPreviewHeap;
+	mutable unsigned int previewStamp = 0;
+	unsigned int version = 0;
+	bool useFlowFieldDiagonal = false;
+	//The number of tiles that don't have the default cost.
+	int tileCountWeighted = 0;
+
+	//The flow fields, one per target group.  Each field is a plane of one value per tile, and the
+	//planes are stored back to back, so field n's value for tile i is at n * tileCount + i.  A 
+	//single search seeded from all of a group's targets fills its field.
+	int flowFieldCount = 1;
+	std::vector<unsigned int> listFlowDistances;
+	std::vector<signed char> listFlowDirectionsX, listFlowDirectionsY;
+
+	//A rebuild fills these planes, in the same layout, and swaps them in when every field is done.
+	//Its search state is kept between slices so it carries on from the same frontier.
+	int flowFieldBudgetMicroseconds = 0;
+	//The weighted search's ring of buckets covers the longest single step.
+	static constexpr unsigned int flowBucketCount = tileCostMax * flowStepDiagonal + 1;
+	std::vector<unsigned int> listFlowDistancesPending;
+	std::vector<signed char> listFlowDirectionsXPending, listFlowDirectionsYPending;
+	struct FlowFieldRebuild {
+		bool isActive = false;
+		//Set when the tiles changed during the rebuild, so another one starts when it's done.
+		bool isQueued = false;
+		int flowFieldCount = 1;
+		int flowFieldID = 0;
+		bool isCalculatingDirections = false;
+		bool isUniform = true;
+		size_t arenaMarker = 0;
+		//The BFS queue, in the arena.  The parallel BFS takes it a whole distance at a time, and
+		//claims tiles through a bit per tile since any thread could reach one first.
+		int* listQueue = nullptr;
+		size_t queueFront = 0, queueBack = 0;
+		std::atomic<unsigned int>* listVisited = nullptr;
+		//The weighted search's buckets and tile links, in the arena.
+		int* listBucketHeads = nullptr;
+		int* listNext = nullptr;
+		int* listPrevious = nullptr;
+		size_t openCount = 0;
+		unsigned int distanceCurrent = 0;
+		//The next tile of the direction pass.
+		size_t directionsNext = 0;
+		//Whether this rebuild makes a smooth field, and whether this field's is under way.
+		bool isSmooth = false;
+		bool isCalculatingSmooth = false;
+		//The fast marching heap of tiles by distance, and each tile's place in it, in the arena.
+		int* listSmoothHeap = nullptr;
+		int* listSmoothHeapPositions = nullptr;
+		size_t smoothHeapCount = 0;
+		//The next tile of the angle pass.
+		size_t anglesNext = 0;
+	};
+	FlowFieldRebuild flowFieldRebuild;
+	//A tile's place in the fast marching heap before it's reached, and once its distance is final.
+	static constexpr int smoothHeapUnseen = -1, smoothHeapFrozen = -2;
+
+	//The smooth field's direction at each tile in 256ths of a turn, in the same layout as the
+	//planes above, or empty without a smooth field.  Tiles with no direction in the plain field
+	//have none here either.
+	bool useFlowFieldSmooth = false;
+	std::vector<unsigned char> listFlowAngles, listFlowAnglesPending;
+	//The fast marching distances of the field being built, in tiles of default cost.
+	std::vector<float> listSmoothDistances;
+
+	//Only the parallel BFS and direction pass use the pool, and only while the caller waits.
+	std::unique_ptr<WorkerPool> workerPoolFlowField;
+	//Below this many tiles a BFS distance is handled by the caller alone.
+	static constexpr size_t parallelFrontierMin = 1024;
+	//The direction pass hands out tiles in blocks of this many.
+	static constexpr size_t flowDirectionsBlockSize = 4096;
 
 	const int targetX = 0, targetY = 0;
 
+	//The spawner and target tiles, kept up to date as tiles change so they never have to be 
+	//searched for.  Spawners are picked through an alias table built from their weights.
+	struct EnemySpawner {
+		int index;
+		float weight;
+		//Where its path is in listEnemyPathPoints, and the path's version.
+		int pathBegin = 0, pathEnd = 0;
+		unsigned int pathVersion = 0;
+	};
+	std::vector<EnemySpawner> listEnemySpawners;
+	std::vector<float> listEnemySpawnerAliasProbabilities;
+	std::vector<int> listEnemySpawnerAliases;
+	//Every spawner's path, one after another.  They're found again once the flow field is up to
+	//date after any change, walking down it from each spawner and cutting across the tiles where
+	//that keeps half a tile clear of the walls.  Cutting across would skip dearer tiles, so with
+	//tile costs only straight runs are joined.
+	std::vector<Vector2D> listEnemyPathPoints, listEnemyPathPointsNext;
+	std::vector<int> listEnemyPathTiles;
+	unsigned int enemyPathsLevelVersion = 0, enemyPathVersionLast = 0;
+	//The most tiles one segment of a path cuts across, which bounds the work of finding them.
+	static constexpr int enemyPathSegmentTilesMax = 32;
+	struct Target {
+		int index;
+		int flowFieldID;
+	};
+	std::vector<Target> listTargets;
+
+	//On large maps the flow fields come from the hierarchical layer instead of the planes above.
+	std::unique_ptr<HierarchicalPathfinder> pathfinderHierarchical;
+	//Set while the constructor lays out the tiles, so the flow field is only built once.
+	bool isFlowFieldDeferred = false;
+
+	//Scratch memory for rebuilding the flow field, sized for the search's buckets and tile links.
+	FrameArena arenaFlowField;
+
 	SDL_Texture* textureBackground = nullptr;
 	SDL_Texture* textureTileWall = nullptr,
 		*textureTileTarget = nullptr,
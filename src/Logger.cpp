@@ -0,0 +1,269 @@
+#include "Logger.h"
+#include <cstdarg>
+
+
+Logger::Slot Logger::listSlots[Logger::slotCount];
+std::atomic<size_t> Logger::positionWrite{ 0 };
+size_t Logger::positionRead = 0;
+std::atomic<int> Logger::countDropped{ 0 };
+std::atomic<bool> Logger::listModulesEnabled[(int)LogModule::count] = { {true}, {true}, {true}, {true}, {true} };
+Logger::RateLimit Logger::listRateLimits[Logger::rateLimitCount];
+
+SDL_Thread* Logger::thread = nullptr;
+SDL_sem* Logger::semaphoreMessages = nullptr;
+std::atomic<bool> Logger::running{ false };
+FILE* Logger::output = nullptr;
+
+
+
+
+void Logger::start(const char* filename) {
+	if (running)
+		return;
+
+	output = stdout;
+	if (filename != nullptr) {
+		output = fopen(filename, "w");
+		if (output == nullptr)
+			output = stdout;
+	}
+
+	//Each slot's sequence starts at its own index, meaning it's free for that write position.
+	for (size_t count = 0; count < slotCount; count++)
+		listSlots[count].sequence.store(count, std::memory_order_relaxed);
+	positionWrite.store(0);
+	positionRead = 0;
+
+	semaphoreMessages = SDL_CreateSemaphore(0);
+	running = true;
+	thread = SDL_CreateThread(threadMain, "Logger", nullptr);
+	if (thread == nullptr) {
+		running = false;
+		SDL_DestroySemaphore(semaphoreMessages);
+		semaphoreMessages = nullptr;
+	}
+}
+
+
+void Logger::stop() {
+	if (running == false) {
+		flushSuppressed(stdout, true);
+		return;
+	}
+
+	running = false;
+	SDL_SemPost(semaphoreMessages);
+	SDL_WaitThread(thread, nullptr);
+	thread = nullptr;
+
+	SDL_DestroySemaphore(semaphoreMessages);
+	semaphoreMessages = nullptr;
+
+	//Report what was suppressed in the last second too.
+	if (flushSuppressed(output, true))
+		fflush(output);
+
+	if (output != stdout)
+		fclose(output);
+	output = nullptr;
+}
+
+
+
+void Logger::setModuleEnabled(LogModule module, bool enabled) {
+	if (module < LogModule::count)
+		listModulesEnabled[(int)module].store(enabled, std::memory_order_relaxed);
+}
+
+
+bool Logger::isModuleEnabled(LogModule module) {
+	return (module < LogModule::count &&
+		listModulesEnabled[(int)module].load(std::memory_order_relaxed));
+}
+
+
+
+void Logger::write(int level, LogModule module, const char* format, ...) {
+	//Suppressed messages are only counted, never formatted.
+	int countSuppressed = 0;
+	if (allowMessage(level, module, format, countSuppressed) == false)
+		return;
+
+	char message[messageSizeMax];
+	va_list args;
+	va_start(args, format);
+	SDL_vsnprintf(message, sizeof(message), format, args);
+	va_end(args);
+
+	//Write directly if the writer thread isn't running (startup, shutdown and tools).
+	if (running == false) {
+		writeLine(stdout, level, module, SDL_GetTicks(), countSuppressed, message);
+		return;
+	}
+
+	if (pushSlot(level, module, countSuppressed, message))
+		SDL_SemPost(semaphoreMessages);
+	else
+		countDropped++;
+}
+
+
+
+bool Logger::allowMessage(int level, LogModule module, const char* format, int& countSuppressed) {
+	//Allow a few messages per call site each second and count the rest, so a message repeated
+	//every frame can't flood the output.  The format string is a literal, so its address tells
+	//the call sites apart.
+	Uint64 hash = (Uint64)(uintptr_t)format * 11400714819323198485ULL;
+	RateLimit* rateLimit = nullptr;
+	for (int count = 0; count < rateLimitProbeCount && rateLimit == nullptr; count++) {
+		RateLimit& rateLimitSelected = listRateLimits[((hash >> 32) + count) % rateLimitCount];
+		const char* formatSlot = rateLimitSelected.format.load(std::memory_order_acquire);
+		if (formatSlot == nullptr) {
+			//Claim the free slot, unless another call site just did.
+			rateLimitSelected.level.store(level, std::memory_order_relaxed);
+			rateLimitSelected.module.store((int)module, std::memory_order_relaxed);
+			if (rateLimitSelected.format.compare_exchange_strong(formatSlot, format, std::memory_order_acq_rel))
+				formatSlot = format;
+		}
+		if (formatSlot == format)
+			rateLimit = &rateLimitSelected;
+	}
+	//With every slot nearby taken the message just isn't limited.
+	if (rateLimit == nullptr)
+		return true;
+
+	Uint32 timeMs = SDL_GetTicks();
+	Uint32 timeWindowStartMs = rateLimit->timeWindowStartMs.load(std::memory_order_relaxed);
+	if (timeMs - timeWindowStartMs >= 1000 &&
+		rateLimit->timeWindowStartMs.compare_exchange_strong(timeWindowStartMs, timeMs))
+		rateLimit->countInWindow.store(0, std::memory_order_relaxed);
+
+	if (rateLimit->countInWindow.fetch_add(1, std::memory_order_relaxed) >= rateLimitMessagesPerSecond) {
+		rateLimit->countSuppressed.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	//Report anything the writer thread hasn't flushed yet with this message.
+	countSuppressed = rateLimit->countSuppressed.exchange(0, std::memory_order_relaxed);
+	return true;
+}
+
+
+bool Logger::flushSuppressed(FILE* output, bool all) {
+	Uint32 timeMs = SDL_GetTicks();
+	bool wroteLine = false;
+
+	//Only the format string is kept, so that's what stands in for the messages.
+	for (auto& rateLimitSelected : listRateLimits) {
+		const char* format = rateLimitSelected.format.load(std::memory_order_acquire);
+		if (format == nullptr || rateLimitSelected.countSuppressed.load(std::memory_order_relaxed) == 0 ||
+			(all == false && timeMs - rateLimitSelected.timeWindowStartMs.load(std::memory_order_relaxed) < 1000))
+			continue;
+
+		int countSuppressed = rateLimitSelected.countSuppressed.exchange(0, std::memory_order_relaxed);
+		if (countSuppressed > 0) {
+			writeLine(output, rateLimitSelected.level.load(std::memory_order_relaxed),
+				(LogModule)rateLimitSelected.module.load(std::memory_order_relaxed), timeMs, countSuppressed, format);
+			wroteLine = true;
+		}
+	}
+
+	return wroteLine;
+}
+
+
+
+bool Logger::pushSlot(int level, LogModule module, int countSuppressed, const char* message) {
+	//Claim a write position whose slot has been released by the reader.
+	size_t position = positionWrite.load(std::memory_order_relaxed);
+	Slot* slot = nullptr;
+	while (true) {
+		slot = &listSlots[position % slotCount];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		if (sequence == position) {
+			if (positionWrite.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (sequence < position) {
+			//The buffer is full.
+			return false;
+		}
+		else {
+			position = positionWrite.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->level = level;
+	slot->module = module;
+	slot->timeMs = SDL_GetTicks();
+	slot->countSuppressed = countSuppressed;
+	SDL_strlcpy(slot->message, message, sizeof(slot->message));
+
+	//Publish it to the reader.
+	slot->sequence.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+
+bool Logger::popSlot(FILE* output) {
+	Slot& slot = listSlots[positionRead % slotCount];
+	if (slot.sequence.load(std::memory_order_acquire) != positionRead + 1)
+		return false;
+
+	writeLine(output, slot.level, slot.module, slot.timeMs, slot.countSuppressed, slot.message);
+
+	//Release the slot for the writer one lap ahead.
+	slot.sequence.store(positionRead + slotCount, std::memory_order_release);
+	positionRead++;
+	return true;
+}
+
+
+
+int Logger::threadMain(void* data) {
+	while (true) {
+		bool stopping = (running == false);
+		SDL_SemWaitTimeout(semaphoreMessages, 100);
+
+		//Drain everything that's queued and only flush once per batch.
+		bool wroteLine = false;
+		while (popSlot(output))
+			wroteLine = true;
+
+		int countDroppedNow = countDropped.exchange(0);
+		if (countDroppedNow > 0) {
+			char message[messageSizeMax];
+			SDL_snprintf(message, sizeof(message), "%d log messages dropped, the buffer was full", countDroppedNow);
+			writeLine(output, LOG_LEVEL_WARNING, LogModule::general, SDL_GetTicks(), 0, message);
+			wroteLine = true;
+		}
+
+		//Report messages that were suppressed once their window ends, rather than waiting for
+		//the next one that's allowed through.
+		if (flushSuppressed(output, false))
+			wroteLine = true;
+
+		if (wroteLine)
+			fflush(output);
+
+		if (stopping)
+			return 0;
+	}
+}
+
+
+void Logger::writeLine(FILE* output, int level, LogModule module, Uint32 timeMs,
+	int countSuppressed, const char* message) {
+	static const char* listLevelNames[] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+	static const char* listModuleNames[] = { "general", "game", "level", "assets", "ui" };
+
+	const char* levelName = (level >= 0 && level <= LOG_LEVEL_ERROR ? listLevelNames[level] : "?");
+	const char* moduleName = (module < LogModule::count ? listModuleNames[(int)module] : "?");
+
+	if (countSuppressed > 0)
+		fprintf(output, "%u.%03u [%s][%s] %s (%d similar messages suppressed)\n",
+			timeMs / 1000, timeMs % 1000, levelName, moduleName, message, countSuppressed);
+	else
+		fprintf(output, "%u.%03u [%s][%s] %s\n",
+			timeMs / 1000, timeMs % 1000, levelName, moduleName, message);
+}
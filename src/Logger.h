@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <cstdio>
+#include "SDL2/SDL.h"
+
+
+
+//Levels below LOG_LEVEL_MIN are compiled out entirely.  Build with -DLOG_LEVEL_MIN=0 to get 
+//debug messages.
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR 3
+
+#ifndef LOG_LEVEL_MIN
+#define LOG_LEVEL_MIN LOG_LEVEL_INFO
+#endif
+
+
+enum class LogModule : int {
+	general,
+	game,
+	level,
+	assets,
+	ui,
+	count
+};
+
+
+//Messages are formatted on the calling thread into a lock-free ring buffer and written out by a 
+//background thread, so logging never blocks on the console or a redirected file.  Each call site 
+//is rate-limited separately without taking a lock, before anything is formatted, and every module 
+//can be switched on or off at runtime.
+class Logger
+{
+public:
+	//Starts the writer thread.  Output goes to stdout if filename is nullptr.  Until it's started
+	//messages are written directly.
+	static void start(const char* filename = nullptr);
+	//Writes everything still queued and stops the writer thread.
+	static void stop();
+
+	static void setModuleEnabled(LogModule module, bool enabled);
+	static bool isModuleEnabled(LogModule module);
+
+	static void write(int level, LogModule module, const char* format, ...)
+		SDL_PRINTF_VARARG_FUNC(3);
+
+
+private:
+	static const int messageSizeMax = 240;
+	static const size_t slotCount = 1024;
+	static const int rateLimitMessagesPerSecond = 5;
+	static const int rateLimitCount = 256;
+	static const int rateLimitProbeCount = 8;
+
+	struct Slot {
+		std::atomic<size_t> sequence{ 0 };
+		int level = 0;
+		LogModule module = LogModule::general;
+		Uint32 timeMs = 0;
+		int countSuppressed = 0;
+		char message[messageSizeMax] = {};
+	};
+
+	//A call site's messages in the last second, keyed on its format string.  A slot is claimed by
+	//the first message from a call site and kept for good.
+	struct RateLimit {
+		std::atomic<const char*> format{ nullptr };
+		std::atomic<int> level{ 0 };
+		std::atomic<int> module{ 0 };
+		std::atomic<Uint32> timeWindowStartMs{ 0 };
+		std::atomic<int> countInWindow{ 0 };
+		std::atomic<int> countSuppressed{ 0 };
+	};
+
+	static int threadMain(void* data);
+	static bool allowMessage(int level, LogModule module, const char* format, int& countSuppressed);
+	//Writes the suppressed counts of messages whose window has ended, or of all of them.
+	static bool flushSuppressed(FILE* output, bool all);
+	static bool pushSlot(int level, LogModule module, int countSuppressed, const char* message);
+	static bool popSlot(FILE* output);
+	static void writeLine(FILE* output, int level, LogModule module, Uint32 timeMs,
+		int countSuppressed, const char* message);
+
+
+	static Slot listSlots[slotCount];
+	static std::atomic<size_t> positionWrite;
+	static size_t positionRead;
+	static std::atomic<int> countDropped;
+	static std::atomic<bool> listModulesEnabled[(int)LogModule::count];
+	static RateLimit listRateLimits[rateLimitCount];
+
+	static SDL_Thread* thread;
+	static SDL_sem* semaphoreMessages;
+	static std::atomic<bool> running;
+	static FILE* output;
+};
+
+
+#define LOG_WRITE(level, module, ...) \
+	do { \
+		if ((level) >= LOG_LEVEL_MIN && Logger::isModuleEnabled(module)) \
+			Logger::write((level), (module), __VA_ARGS__); \
+	} while (0)
+
+#define LOG_DEBUG(module, ...) LOG_WRITE(LOG_LEVEL_DEBUG, module, __VA_ARGS__)
+#define LOG_INFO(module, ...) LOG_WRITE(LOG_LEVEL_INFO, module, __VA_ARGS__)
+#define LOG_WARNING(module, ...) LOG_WRITE(LOG_LEVEL_WARNING, module, __VA_ARGS__)
+#define LOG_ERROR(module, ...) LOG_WRITE(LOG_LEVEL_ERROR, module, __VA_ARGS__)
@@ -0,0 +1,41 @@
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "AssetPack.h"
+
+//Packs every file under the data directory into a single archive for AssetIndex to map.
+//Usage: PackAssets [data directory] [output file]
+int main(int argc, char* args[]) {
+	namespace fs = std::filesystem;
+
+	fs::path pathData = (argc > 1 ? args[1] : "data");
+	std::string pathOutput = (argc > 2 ? args[2] : "data.pak");
+
+	std::vector<fs::path> listPaths;
+	std::error_code error;
+	fs::recursive_directory_iterator it(pathData, error), end;
+	for (; !error && it != end; it.increment(error)) {
+		if (it->is_regular_file(error))
+			listPaths.push_back(it->path());
+	}
+
+	if (error || listPaths.empty()) {
+		std::cout << "Error: Couldn't find any assets under: " << pathData.string() << std::endl;
+		return 1;
+	}
+
+	//Sort so the archive's layout is the same on every build.
+	std::sort(listPaths.begin(), listPaths.end());
+
+	std::vector<std::pair<std::string, std::string>> listFiles;
+	for (const auto& path : listPaths)
+		listFiles.push_back({ path.lexically_relative(pathData).generic_string(), path.string() });
+
+	if (AssetPack::write(pathOutput, listFiles) == false)
+		return 1;
+
+	std::cout << "Packed " << listFiles.size() << " assets into: " << pathOutput << std::endl;
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,386 @@
+#include "Profiler.h"
+#ifdef CITYDEFENSE_PROFILE
+#include <string>
+#include "Logger.h"
+#include "AllocationTracker.h"
+
+
+Profiler::Node Profiler::listNodes[Profiler::nodeCountMax];
+int Profiler::nodeCount = 0;
+Profiler::ScopeActive Profiler::listScopesActive[Profiler::scopeDepthMax];
+int Profiler::scopeDepth = 0;
+Profiler::Counter Profiler::listCounters[Profiler::counterCountMax];
+int Profiler::counterCount = 0;
+
+SDL_threadID Profiler::threadIDMain = 0;
+bool Profiler::frameActive = false;
+int Profiler::historyIndex = 0;
+int Profiler::historyFramesRecorded = 0;
+
+bool Profiler::overlayVisible = false;
+Uint32 Profiler::overlayTimeLastUpdateMs = 0;
+SDL_Texture* Profiler::textureOverlay = nullptr;
+SDL_Rect Profiler::rectOverlay = { 0, 0, 0, 0 };
+
+std::atomic<TraceRecorder::ThreadBuffer*> TraceRecorder::threadBufferFirst{ nullptr };
+std::atomic<int> TraceRecorder::threadCount{ 0 };
+thread_local TraceRecorder::ThreadBuffer* TraceRecorder::threadBufferCurrent = nullptr;
+
+//Trace timestamps are relative to the first time anything is profiled.
+static const Uint64 ticksTraceStart = SDL_GetPerformanceCounter();
+
+
+
+
+void Profiler::beginFrame() {
+	threadIDMain = SDL_ThreadID();
+	frameActive = true;
+	scopeDepth = 0;
+
+	//The frame itself is the root of the tree.
+	if (nodeCount == 0) {
+		listNodes[0].name = "Frame";
+		nodeCount = 1;
+	}
+	listScopesActive[0] = { 0, SDL_GetPerformanceCounter() };
+	scopeDepth = 1;
+
+	TraceRecorder::addEvent("Frame", 'B');
+}
+
+
+void Profiler::endFrame() {
+	if (frameActive == false)
+		return;
+
+	//Close anything left open along with the frame.
+	while (scopeDepth > 0)
+		endScope();
+	frameActive = false;
+
+	double msPerTick = 1000.0 / (double)SDL_GetPerformanceFrequency();
+	for (int count = 0; count < nodeCount; count++) {
+		Node& node = listNodes[count];
+		node.listHistoryMs[historyIndex] = (float)(node.ticksThisFrame * msPerTick);
+		node.ticksThisFrame = 0;
+	}
+
+	historyIndex = (historyIndex + 1) % historyFrameCount;
+	if (historyFramesRecorded < historyFrameCount)
+		historyFramesRecorded++;
+
+	TraceRecorder::addEvent("Frame", 'E');
+}
+
+
+
+void Profiler::beginScope(const char* name) {
+	//Only the main thread's frame is profiled, anything else is ignored.
+	if (frameActive == false || SDL_ThreadID() != threadIDMain)
+		return;
+
+	if (scopeDepth >= scopeDepthMax) {
+		scopeDepth++;
+		return;
+	}
+
+	int node = findOrAddNode(listScopesActive[scopeDepth - 1].node, name);
+	listScopesActive[scopeDepth] = { node, SDL_GetPerformanceCounter() };
+	scopeDepth++;
+}
+
+
+void Profiler::endScope() {
+	if (frameActive == false || scopeDepth <= 0 || SDL_ThreadID() != threadIDMain)
+		return;
+
+	scopeDepth--;
+	if (scopeDepth >= scopeDepthMax)
+		return;
+
+	ScopeActive& scope = listScopesActive[scopeDepth];
+	if (scope.node >= 0)
+		listNodes[scope.node].ticksThisFrame += SDL_GetPerformanceCounter() - scope.ticksStart;
+}
+
+
+void Profiler::setCounter(const char* name, int value) {
+	int index = 0;
+	while (index < counterCount && SDL_strcmp(listCounters[index].name, name) != 0)
+		index++;
+	if (index == counterCount) {
+		if (counterCount >= counterCountMax)
+			return;
+		listCounters[counterCount++].name = name;
+	}
+
+	Counter& counter = listCounters[index];
+	counter.value = value;
+	if (value > counter.valueWorst)
+		counter.valueWorst = value;
+}
+
+
+int Profiler::findOrAddNode(int parent, const char* name) {
+	//A scope is identified by its name under its parent, so the same function called from
+	//different phases shows up under each of them.
+	if (parent < 0)
+		return -1;
+
+	for (int count = 1; count < nodeCount; count++)
+		if (listNodes[count].parent == parent && SDL_strcmp(listNodes[count].name, name) == 0)
+			return count;
+
+	if (nodeCount >= nodeCountMax)
+		return -1;
+
+	Node& node = listNodes[nodeCount];
+	node.name = name;
+	node.parent = parent;
+	node.depth = listNodes[parent].depth + 1;
+	return nodeCount++;
+}
+
+
+
+void Profiler::toggleOverlay() {
+	overlayVisible = !overlayVisible;
+	overlayTimeLastUpdateMs = 0;
+}
+
+
+bool Profiler::isOverlayVisible() {
+	return overlayVisible;
+}
+
+
+void Profiler::drawOverlay(SDL_Renderer* renderer, TTF_Font* font) {
+	if (overlayVisible == false || font == nullptr)
+		return;
+
+	ALLOCATION_TAG(AllocationTag::profiler);
+
+	//The text only changes a few times a second so it stays readable and cheap.
+	Uint32 timeMs = SDL_GetTicks();
+	if (textureOverlay == nullptr || timeMs - overlayTimeLastUpdateMs >= overlayRefreshMs) {
+		updateOverlayTexture(renderer, font);
+		overlayTimeLastUpdateMs = timeMs;
+	}
+
+	if (textureOverlay != nullptr) {
+		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
+		SDL_Rect rectBackground = { rectOverlay.x - 10, rectOverlay.y - 10, rectOverlay.w + 20, rectOverlay.h + 20 };
+		SDL_RenderFillRect(renderer, &rectBackground);
+		SDL_RenderCopy(renderer, textureOverlay, NULL, &rectOverlay);
+	}
+}
+
+
+void Profiler::destroyOverlay() {
+	if (textureOverlay != nullptr) {
+		SDL_DestroyTexture(textureOverlay);
+		textureOverlay = nullptr;
+	}
+}
+
+
+void Profiler::updateOverlayTexture(SDL_Renderer* renderer, TTF_Font* font) {
+	destroyOverlay();
+
+	//Find the worst frame in the history by its total time.
+	int frameCount = (historyFramesRecorded > 0 ? historyFramesRecorded : 1);
+	int frameWorst = 0;
+	for (int count = 1; count < frameCount; count++)
+		if (listNodes[0].listHistoryMs[count] > listNodes[0].listHistoryMs[frameWorst])
+			frameWorst = count;
+
+	std::string text = "Phase                     avg ms   worst frame\n";
+	char line[128];
+
+	//List the nodes depth first so children sit under their parents.
+	int listStack[nodeCountMax];
+	int stackSize = 0;
+	if (nodeCount > 0)
+		listStack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		int index = listStack[--stackSize];
+		const Node& node = listNodes[index];
+
+		float sumMs = 0.0f;
+		for (int count = 0; count < frameCount; count++)
+			sumMs += node.listHistoryMs[count];
+
+		SDL_snprintf(line, sizeof(line), "%*s%-*s %7.2f %9.2f\n",
+			node.depth * 2, "", 24 - node.depth * 2, node.name,
+			sumMs / frameCount, node.listHistoryMs[frameWorst]);
+		text += line;
+
+		//Push the children in reverse so they come out in the order they were first seen.
+		for (int count = nodeCount - 1; count > index; count--)
+			if (listNodes[count].parent == index && stackSize < nodeCountMax)
+				listStack[stackSize++] = count;
+	}
+
+	//Allocations in the last frame, and in the worst frame since the overlay was last updated.
+	const AllocationTracker::FrameStats& frameStatsLast = AllocationTracker::getLastFrame();
+	const AllocationTracker::FrameStats& frameStatsWorst = AllocationTracker::getWorstFrame();
+	SDL_snprintf(line, sizeof(line), "\nAllocations  last %d (%d B)  worst %d (%d B)\n",
+		(int)frameStatsLast.countTotal, (int)frameStatsLast.bytesTotal,
+		(int)frameStatsWorst.countTotal, (int)frameStatsWorst.bytesTotal);
+	text += line;
+	for (int count = 0; count < AllocationTracker::tagCount; count++) {
+		if (frameStatsWorst.listCounts[count] > 0) {
+			SDL_snprintf(line, sizeof(line), "  %-22s %7d %9d B\n",
+				AllocationTracker::getTagName((AllocationTag)count),
+				(int)frameStatsWorst.listCounts[count], (int)frameStatsWorst.listBytes[count]);
+			text += line;
+		}
+	}
+	AllocationTracker::resetWorstFrame();
+
+	//Counters reported this frame, and the highest each reached since the overlay was last updated.
+	if (counterCount > 0)
+		text += "\nCounters                  last     worst\n";
+	for (int count = 0; count < counterCount; count++) {
+		Counter& counter = listCounters[count];
+		SDL_snprintf(line, sizeof(line), "  %-22s %7d %9d\n", counter.name, counter.value, counter.valueWorst);
+		text += line;
+		counter.valueWorst = counter.value;
+	}
+
+	SDL_Color color = { 255, 255, 255, 255 };
+	SDL_Surface* surface = TTF_RenderUTF8_Blended_Wrapped(font, text.c_str(), color, 0);
+	if (surface == nullptr)
+		return;
+
+	textureOverlay = SDL_CreateTextureFromSurface(renderer, surface);
+	int windowWidth = 0, windowHeight = 0;
+	SDL_GetRendererOutputSize(renderer, &windowWidth, &windowHeight);
+	rectOverlay = { windowWidth - surface->w - 20, 20, surface->w, surface->h };
+	SDL_FreeSurface(surface);
+}
+
+
+
+
+void TraceRecorder::setThreadName(const char* name) {
+	getThreadBuffer()->name.store(name, std::memory_order_release);
+}
+
+
+void TraceRecorder::addEvent(const char* name, char phase) {
+	ThreadBuffer* threadBuffer = getThreadBuffer();
+	Chunk* chunk = threadBuffer->chunkLast;
+	int eventCount = chunk->eventCount.load(std::memory_order_relaxed);
+
+	//Start a new chunk when this one is full, and at the limit reuse the oldest one instead so
+	//recording never stops.
+	if (eventCount >= chunkEventCount) {
+		SDL_AtomicLock(&threadBuffer->spinLockChunks);
+		Chunk* chunkNew = nullptr;
+		if (threadBuffer->chunkCount < chunkCountMaxPerThread) {
+			chunkNew = new Chunk();
+			threadBuffer->chunkCount++;
+		}
+		else {
+			chunkNew = threadBuffer->chunkFirst;
+			threadBuffer->chunkFirst = chunkNew->next.load(std::memory_order_relaxed);
+			chunkNew->next.store(nullptr, std::memory_order_relaxed);
+			chunkNew->eventCount.store(0, std::memory_order_relaxed);
+		}
+		chunk->next.store(chunkNew, std::memory_order_release);
+		threadBuffer->chunkLast = chunkNew;
+		SDL_AtomicUnlock(&threadBuffer->spinLockChunks);
+
+		chunk = chunkNew;
+		eventCount = 0;
+	}
+
+	chunk->listEvents[eventCount] = { name, SDL_GetPerformanceCounter(), phase };
+	//Publish the event to writeFile.
+	chunk->eventCount.store(eventCount + 1, std::memory_order_release);
+}
+
+
+TraceRecorder::ThreadBuffer* TraceRecorder::getThreadBuffer() {
+	if (threadBufferCurrent != nullptr)
+		return threadBufferCurrent;
+
+	//Each thread's buffer is created on its first event and added to the front of the list.
+	//Buffers live until the process exits so events from finished threads can still be written.
+	ThreadBuffer* threadBuffer = new ThreadBuffer();
+	threadBuffer->chunkFirst = threadBuffer->chunkLast = new Chunk();
+	threadBuffer->chunkCount = 1;
+	threadBuffer->threadIndex = threadCount.fetch_add(1) + 1;
+
+	ThreadBuffer* next = threadBufferFirst.load(std::memory_order_relaxed);
+	do {
+		threadBuffer->next = next;
+	} while (threadBufferFirst.compare_exchange_weak(next, threadBuffer,
+		std::memory_order_release, std::memory_order_relaxed) == false);
+
+	threadBufferCurrent = threadBuffer;
+	return threadBuffer;
+}
+
+
+bool TraceRecorder::writeFile(const char* filename) {
+	FILE* file = fopen(filename, "w");
+	if (file == nullptr) {
+		LOG_ERROR(LogModule::general, "Couldn't write trace file: %s", filename);
+		return false;
+	}
+
+	double usPerTick = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+	int eventCountWritten = 0;
+	bool first = true;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for (ThreadBuffer* threadBuffer = threadBufferFirst.load(std::memory_order_acquire);
+		threadBuffer != nullptr; threadBuffer = threadBuffer->next) {
+
+		const char* threadName = threadBuffer->name.load(std::memory_order_acquire);
+		if (threadName != nullptr) {
+			fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",", threadBuffer->threadIndex, threadName);
+			first = false;
+		}
+
+		//Only the events each thread has published so far are read, the rest is left alone.  The
+		//lock keeps the thread from reusing a chunk while it's being written, and stalls it at
+		//its next chunk until the write is done.
+		SDL_AtomicLock(&threadBuffer->spinLockChunks);
+		int depth = 0;
+		for (Chunk* chunk = threadBuffer->chunkFirst; chunk != nullptr;
+			chunk = chunk->next.load(std::memory_order_acquire)) {
+			int eventCount = chunk->eventCount.load(std::memory_order_acquire);
+			for (int count = 0; count < eventCount; count++) {
+				const Event& event = chunk->listEvents[count];
+				//Skip the ends of scopes whose beginning was in a chunk that's been reused.
+				if (event.phase == 'E' && depth == 0)
+					continue;
+				depth += (event.phase == 'B' ? 1 : -1);
+
+				fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+					first ? "" : ",", event.name, event.phase, threadBuffer->threadIndex,
+					(double)(Sint64)(event.ticks - ticksTraceStart) * usPerTick);
+				first = false;
+				eventCountWritten++;
+			}
+		}
+		SDL_AtomicUnlock(&threadBuffer->spinLockChunks);
+	}
+	fprintf(file, "\n]}\n");
+
+	bool success = (ferror(file) == 0);
+	fclose(file);
+
+	if (success)
+		LOG_INFO(LogModule::general, "Wrote %d trace events to: %s", eventCountWritten, filename);
+	else
+		LOG_ERROR(LogModule::general, "Couldn't write trace file: %s", filename);
+	return success;
+}
+
+#endif
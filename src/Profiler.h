@@ -0,0 +1,164 @@
+#pragma once
+#include <atomic>
+#include "SDL2/SDL.h"
+#include "SDL2/SDL_ttf.h"
+
+
+
+//Scoped frame timers.  Everything here is compiled out unless CITYDEFENSE_PROFILE is defined
+//(make PROFILE=1), so the macros can stay in the hot paths of release builds.
+#ifdef CITYDEFENSE_PROFILE
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FRAME_BEGIN() Profiler::beginFrame()
+#define PROFILE_FRAME_END() Profiler::endFrame()
+#define PROFILE_THREAD_NAME(name) TraceRecorder::setThreadName(name)
+#define PROFILE_COUNTER(name, value) Profiler::setCounter(name, value)
+
+
+//Times nested scopes on the main thread into a per-frame tree, and keeps a short history of
+//frames to show rolling averages next to the breakdown of the worst frame.
+class Profiler
+{
+public:
+	static void beginFrame();
+	static void endFrame();
+	static void beginScope(const char* name);
+	static void endScope();
+	//Shows a value in the overlay, with the highest it reached since the overlay was last updated.
+	//Names must be string literals.
+	static void setCounter(const char* name, int value);
+
+	static void toggleOverlay();
+	static bool isOverlayVisible();
+	static void drawOverlay(SDL_Renderer* renderer, TTF_Font* font);
+	static void destroyOverlay();
+
+
+private:
+	static const int nodeCountMax = 64;
+	static const int scopeDepthMax = 32;
+	static const int historyFrameCount = 120;
+	static const Uint32 overlayRefreshMs = 250;
+	static const int counterCountMax = 16;
+
+	struct Node {
+		const char* name = nullptr;
+		int parent = -1;
+		int depth = 0;
+		Uint64 ticksThisFrame = 0;
+		float listHistoryMs[historyFrameCount] = {};
+	};
+
+	struct Counter {
+		const char* name = nullptr;
+		int value = 0;
+		int valueWorst = 0;
+	};
+
+	struct ScopeActive {
+		int node;
+		Uint64 ticksStart;
+	};
+
+	static int findOrAddNode(int parent, const char* name);
+	static void updateOverlayTexture(SDL_Renderer* renderer, TTF_Font* font);
+
+
+	static Node listNodes[nodeCountMax];
+	static int nodeCount;
+	static ScopeActive listScopesActive[scopeDepthMax];
+	static int scopeDepth;
+
+	static Counter listCounters[counterCountMax];
+	static int counterCount;
+
+	static SDL_threadID threadIDMain;
+	static bool frameActive;
+	static int historyIndex, historyFramesRecorded;
+
+	static bool overlayVisible;
+	static Uint32 overlayTimeLastUpdateMs;
+	static SDL_Texture* textureOverlay;
+	static SDL_Rect rectOverlay;
+};
+
+
+//Records scope begin/end events from every thread so a session can be opened in Perfetto or
+//chrome://tracing.  Each thread appends to its own ring of chunks, only taking its lock when it
+//moves on to the next chunk, so the file always holds the last few seconds of every thread.
+class TraceRecorder
+{
+public:
+	//Names must be string literals or otherwise outlive the recorder.
+	static void setThreadName(const char* name);
+	static void addEvent(const char* name, char phase);
+	//Writes the events still in each thread's ring as Chrome Trace Event JSON.
+	static bool writeFile(const char* filename);
+
+
+private:
+	static const int chunkEventCount = 16384;
+	static const int chunkCountMaxPerThread = 64;
+
+	struct Event {
+		const char* name;
+		Uint64 ticks;
+		char phase;
+	};
+
+	struct Chunk {
+		Event listEvents[chunkEventCount];
+		std::atomic<int> eventCount{ 0 };
+		std::atomic<Chunk*> next{ nullptr };
+	};
+
+	struct ThreadBuffer {
+		//Held while the chunk list changes or is being written out.
+		SDL_SpinLock spinLockChunks = 0;
+		Chunk* chunkFirst = nullptr;
+		Chunk* chunkLast = nullptr;
+		int chunkCount = 0;
+		int threadIndex = 0;
+		std::atomic<const char*> name{ nullptr };
+		ThreadBuffer* next = nullptr;
+	};
+
+	static ThreadBuffer* getThreadBuffer();
+
+
+	static std::atomic<ThreadBuffer*> threadBufferFirst;
+	static std::atomic<int> threadCount;
+	static thread_local ThreadBuffer* threadBufferCurrent;
+};
+
+
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name) : name(name) {
+		Profiler::beginScope(name);
+		TraceRecorder::addEvent(name, 'B');
+	}
+	~ProfileScope() {
+		TraceRecorder::addEvent(name, 'E');
+		Profiler::endScope();
+	}
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	const char* name;
+};
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FRAME_BEGIN() ((void)0)
+#define PROFILE_FRAME_END() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+
+#endif
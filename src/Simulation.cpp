@@ -0,0 +1,83 @@
+#include "Simulation.h"
+#include "Profiler.h"
+#include "AllocationTracker.h"
+
+
+
+
+int Simulation::update(SDL_Renderer* renderer, float dT, Level& level, CrowdField& crowdField,
+	std::vector<std::shared_ptr<Unit>>& listUnits, std::vector<Turret>& listTurrets,
+	std::vector<Projectile>& listProjectiles) {
+	level.updateFlowField();
+
+	//Update the units.
+	int unitsReachedTargetCount = updateUnits(dT, level, crowdField, listUnits);
+
+	//Update the turrets.
+	{
+		PROFILE_SCOPE("updateTurrets");
+		ALLOCATION_TAG(AllocationTag::turrets);
+		for (auto& turretSelected : listTurrets)
+			turretSelected.update(renderer, dT, listUnits, listProjectiles);
+	}
+
+	//Update the projectiles.
+	updateProjectiles(dT, listUnits, listProjectiles);
+
+	return unitsReachedTargetCount;
+}
+
+
+int Simulation::updateUnits(float dT, Level& level, CrowdField& crowdField,
+	std::vector<std::shared_ptr<Unit>>& listUnits) {
+	PROFILE_SCOPE("updateUnits");
+	ALLOCATION_TAG(AllocationTag::units);
+	//Every unit adds itself to the crowd field before any of them move, so they all steer by the
+	//same picture of the crowd.
+	crowdField.clear();
+	for (auto& unitSelected : listUnits)
+		if (unitSelected != nullptr)
+			crowdField.addUnit(unitSelected->getPos());
+
+	//Loop through the list of units and update all of them.
+	int unitsReachedTargetCount = 0;
+	auto it = listUnits.begin();
+	while (it != listUnits.end()) {
+		bool increment = true;
+
+		if ((*it) != nullptr) {
+			(*it)->update(dT, level, crowdField);
+			if ((*it)->reachedTarget())
+				unitsReachedTargetCount++;
+
+			//Check if the unit is still alive. If not then erase it and don't increment the iterator.
+			if ((*it)->isAlive() == false) {
+				it = listUnits.erase(it);
+				increment = false;
+			}
+		}
+
+		if (increment)
+			it++;
+	}
+
+	return unitsReachedTargetCount;
+}
+
+
+void Simulation::updateProjectiles(float dT, std::vector<std::shared_ptr<Unit>>& listUnits,
+	std::vector<Projectile>& listProjectiles) {
+	PROFILE_SCOPE("updateProjectiles");
+	ALLOCATION_TAG(AllocationTag::projectiles);
+	//Loop through the list of projectiles and update all of them.
+	auto it = listProjectiles.begin();
+	while (it != listProjectiles.end()) {
+		(*it).update(dT, listUnits);
+
+		//Check if the projectile has collided or not, erase it if needed, and update the iterator.
+		if ((*it).getCollisionOccurred())
+			it = listProjectiles.erase(it);
+		else
+			it++;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include "SDL2/SDL.h"
+#include "Level.h"
+#include "CrowdField.h"
+#include "Unit.h"
+#include "Turret.h"
+#include "Projectile.h"
+
+
+
+//One tick of the simulation: the flow field, then the units steering by the crowd field, then the
+//turrets and the projectiles.  The game and the benchmark both step through here so the benchmark
+//always measures the order the game actually runs in.
+class Simulation
+{
+public:
+	//Returns how many units reached the target this tick.  The renderer is only used to load the
+	//textures of new projectiles and may be nullptr.
+	static int update(SDL_Renderer* renderer, float dT, Level& level, CrowdField& crowdField,
+		std::vector<std::shared_ptr<Unit>>& listUnits, std::vector<Turret>& listTurrets,
+		std::vector<Projectile>& listProjectiles);
+
+
+private:
+	static int updateUnits(float dT, Level& level, CrowdField& crowdField,
+		std::vector<std::shared_ptr<Unit>>& listUnits);
+	static void updateProjectiles(float dT, std::vector<std::shared_ptr<Unit>>& listUnits,
+		std::vector<Projectile>& listProjectiles);
+};
@@ -1,4 +1,5 @@
 #include "SoundLoader.h"
+#include "AssetIndex.h"
 
 
 std::unordered_map<std::string, Mix_Chunk*> SoundLoader::umapSoundsLoaded;
@@ -15,23 +16,46 @@ Mix_Chunk* SoundLoader::loadSound(std::string filename) {
             return found->second;
         }
         else {
-            //Setup the relative filepath to the sounds folder using the input filename.
-            std::string filepath = "Data/Sounds/" + filename;
+            return addSound(filename, loadChunk(filename));
+        }
+    }
+
+    return nullptr;
+}
 
-            //Try to create a mix_Chunk using the filepath.
-            Mix_Chunk* mix_Chunk = Mix_LoadWAV(filepath.c_str());
-            if (mix_Chunk != nullptr) {
 
-                //Add the mix_Chunk to the map of loaded mix_Chunks to keep track of it and for 
-                //clean-up purposes.
-                umapSoundsLoaded[filename] = mix_Chunk;
 
-                return mix_Chunk;
-            }
-        }
+Mix_Chunk* SoundLoader::loadChunk(const std::string& filename) {
+    if (filename == "")
+        return nullptr;
+
+    //Look the sound up in the asset index.
+    SDL_RWops* rw = AssetIndex::openRW(filename);
+    if (rw == nullptr)
+        return nullptr;
+
+    //Try to create a mix_Chunk from the stream, which also closes it.
+    return Mix_LoadWAV_RW(rw, 1);
+}
+
+
+
+Mix_Chunk* SoundLoader::addSound(const std::string& filename, Mix_Chunk* mix_Chunk) {
+    if (mix_Chunk == nullptr)
+        return nullptr;
+
+    //Keep the chunk that's already in use if this one was loaded twice.
+    auto found = umapSoundsLoaded.find(filename);
+    if (found != umapSoundsLoaded.end() && found->second != nullptr) {
+        Mix_FreeChunk(mix_Chunk);
+        return found->second;
     }
 
-    return nullptr;
+    //Add the mix_Chunk to the map of loaded mix_Chunks to keep track of it and for 
+    //clean-up purposes.
+    umapSoundsLoaded[filename] = mix_Chunk;
+
+    return mix_Chunk;
 }
 
 
@@ -11,6 +11,11 @@ public:
 	static Mix_Chunk* loadSound(std::string filename);
 	static void deallocateSounds();
 
+	//Decodes a sound without touching the cache, so it's safe to call from worker threads.
+	static Mix_Chunk* loadChunk(const std::string& filename);
+	//Caches a decoded sound.  Must be called on the main thread.
+	static Mix_Chunk* addSound(const std::string& filename, Mix_Chunk* mix_Chunk);
+
 
 private:
 	static std::unordered_map<std::string, Mix_Chunk*> umapSoundsLoaded;
@@ -1,77 +1,128 @@
 #include "TextureLoader.h"
-#include <vector>
-#include <iostream>
+#include "Logger.h"
+#include "SDL2/SDL_image.h"
+#include "AssetIndex.h"
 
 std::unordered_map<std::string, SDL_Texture*> TextureLoader::umapTexturesLoaded;
 
 SDL_Texture* TextureLoader::loadTexture(SDL_Renderer* renderer, std::string filename) {
+    //Headless runs (the benchmark) have no renderer, so there's nothing to create.
+    if (renderer == nullptr)
+        return nullptr;
+
     if (filename != "") {
         auto found = umapTexturesLoaded.find(filename);
 
         if (found != umapTexturesLoaded.end()) {
-            std::cout << "Found cached texture for: " << filename << std::endl;
+            LOG_DEBUG(LogModule::assets, "Found cached texture for: %s", filename.c_str());
             // Verify the cached texture is still valid
             int w, h;
             if (SDL_QueryTexture(found->second, NULL, NULL, &w, &h) == 0) {
-                std::cout << "Cached texture is valid, dimensions: " << w << "x" << h << std::endl;
+                LOG_DEBUG(LogModule::assets, "Cached texture is valid, dimensions: %dx%d", w, h);
                 return found->second;
             } else {
-                std::cout << "Cached texture is invalid, reloading..." << std::endl;
+                LOG_WARNING(LogModule::assets, "Cached texture is invalid, reloading: %s", filename.c_str());
                 // Remove invalid texture from cache
                 SDL_DestroyTexture(found->second);
                 umapTexturesLoaded.erase(found);
             }
         }
 
-        // Try multiple paths for the image
-        std::vector<std::string> pathsToTry = {
-            filename,                        // Original path
-            "./" + filename,                 // Current directory
-            "Data/Images/" + filename       // Data/Images directory
-        };
-
-        for (const auto& filepath : pathsToTry) {
-            std::cout << "Trying to load texture from: " << filepath << std::endl;
-            //Try to create a surface using the filepath.
-            SDL_Surface* surfaceTemp = SDL_LoadBMP(filepath.c_str());
-            if (surfaceTemp != nullptr) {
-                std::cout << "Successfully loaded surface from: " << filepath << std::endl;
-                //The surface was created successfully so attempt to create a texture with it.
-                SDL_Texture* textureOutput = SDL_CreateTextureFromSurface(renderer, surfaceTemp);
-                //Free the surface because it's no longer needed. 
-                SDL_FreeSurface(surfaceTemp);
-
-                if (textureOutput != nullptr) {
-                    std::cout << "Successfully created texture from: " << filepath << std::endl;
-                    //Enable transparency for the texture.
-                    SDL_SetTextureBlendMode(textureOutput, SDL_BLENDMODE_BLEND);
-
-                    //Add the texture to the map of loaded textures to keep track of it and for clean-up purposes.
-                    umapTexturesLoaded[filename] = textureOutput;
-
-                    // Verify texture is valid
-                    int w, h;
-                    if (SDL_QueryTexture(textureOutput, NULL, NULL, &w, &h) == 0) {
-                        std::cout << "Texture is valid, dimensions: " << w << "x" << h << std::endl;
-                    } else {
-                        std::cout << "Warning: Texture validation failed: " << SDL_GetError() << std::endl;
-                        SDL_DestroyTexture(textureOutput);
-                        return nullptr;
-                    }
-
-                    return textureOutput;
-                } else {
-                    std::cout << "Failed to create texture from surface: " << SDL_GetError() << std::endl;
-                }
-            } else {
-                std::cout << "Failed to load surface from: " << filepath << " - " << SDL_GetError() << std::endl;
-            }
+        SDL_Surface* surfaceTemp = loadSurface(filename);
+        if (surfaceTemp != nullptr)
+            return addTexture(renderer, filename, surfaceTemp);
+    }
+
+    return nullptr;
+}
+
+
+
+SDL_Surface* TextureLoader::loadSurface(const std::string& filename) {
+    if (filename == "")
+        return nullptr;
+
+    //Look the image up in the asset index instead of probing paths on disk.
+    std::string filepath;
+    SDL_RWops* rw = AssetIndex::openRW(filename, &filepath);
+    if (rw == nullptr) {
+        LOG_ERROR(LogModule::assets, "Failed to find texture: %s", filename.c_str());
+        return nullptr;
+    }
+
+    // BMPs go through SDL itself, everything else (PNG, JPG) through SDL_image
+    bool isBMP = false;
+    size_t dotPos = filepath.find_last_of('.');
+    if (dotPos != std::string::npos) {
+        std::string extension = filepath.substr(dotPos);
+        isBMP = (SDL_strcasecmp(extension.c_str(), ".bmp") == 0);
+    }
+
+    //Try to create a surface from the stream, which also closes it.
+    SDL_Surface* surfaceTemp = (isBMP ? SDL_LoadBMP_RW(rw, 1) : IMG_Load_RW(rw, 1));
+    if (surfaceTemp != nullptr) {
+        LOG_DEBUG(LogModule::assets, "Loaded surface from: %s", filepath.c_str());
+    } else {
+        LOG_ERROR(LogModule::assets, "Failed to load surface from: %s - %s", filepath.c_str(), SDL_GetError());
+    }
+
+    return surfaceTemp;
+}
+
+
+
+SDL_Texture* TextureLoader::addTexture(SDL_Renderer* renderer, const std::string& filename, SDL_Surface* surface) {
+    if (surface == nullptr)
+        return nullptr;
+
+    //Keep the texture that's already in use if this one was loaded twice.
+    auto found = umapTexturesLoaded.find(filename);
+    if (found != umapTexturesLoaded.end() && found->second != nullptr) {
+        SDL_FreeSurface(surface);
+        return found->second;
+    }
+
+    //Create a texture with the surface.
+    SDL_Texture* textureOutput = SDL_CreateTextureFromSurface(renderer, surface);
+    //Free the surface because it's no longer needed. 
+    SDL_FreeSurface(surface);
+
+    if (textureOutput != nullptr) {
+        LOG_DEBUG(LogModule::assets, "Created texture for: %s", filename.c_str());
+        //Enable transparency for the texture.
+        SDL_SetTextureBlendMode(textureOutput, SDL_BLENDMODE_BLEND);
+
+        // Verify texture is valid
+        int w, h;
+        if (SDL_QueryTexture(textureOutput, NULL, NULL, &w, &h) == 0) {
+            LOG_DEBUG(LogModule::assets, "Texture is valid, dimensions: %dx%d", w, h);
+        } else {
+            LOG_WARNING(LogModule::assets, "Texture validation failed: %s", SDL_GetError());
+            SDL_DestroyTexture(textureOutput);
+            return nullptr;
         }
+
+        //Add the texture to the map of loaded textures to keep track of it and for clean-up purposes.
+        umapTexturesLoaded[filename] = textureOutput;
+
+        return textureOutput;
+    } else {
+        LOG_ERROR(LogModule::assets, "Failed to create texture from surface: %s", SDL_GetError());
     }
 
     return nullptr;
 }
 
+
+
+SDL_Texture* TextureLoader::findTexture(const std::string& filename) {
+    auto found = umapTexturesLoaded.find(filename);
+    if (found != umapTexturesLoaded.end())
+        return found->second;
+
+    return nullptr;
+}
+
 void TextureLoader::deallocateTextures() {
     //Destroy all the textures
     while (umapTexturesLoaded.empty() == false) {
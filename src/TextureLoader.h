@@ -11,6 +11,15 @@ public:
 	static SDL_Texture* loadTexture(SDL_Renderer* renderer, std::string filename);
 	static void deallocateTextures();
 
+	//Decodes an image without touching the renderer or the cache, so it's safe to call from
+	//worker threads.  The caller owns the returned surface.
+	static SDL_Surface* loadSurface(const std::string& filename);
+	//Uploads a decoded surface and caches the texture.  Must be called on the render thread.
+	//The surface is freed.
+	static SDL_Texture* addTexture(SDL_Renderer* renderer, const std::string& filename, SDL_Surface* surface);
+	//Returns the cached texture or nullptr if it isn't resident yet.
+	static SDL_Texture* findTexture(const std::string& filename);
+
 
 private:
 	static std::unordered_map<std::string, SDL_Texture*> umapTexturesLoaded;
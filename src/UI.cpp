@@ -1,15 +1,28 @@
 #include "UI.h"
-#include <iostream>
+#include "AssetIndex.h"
+#include "Profiler.h"
+#include "AllocationTracker.h"
+#include "Logger.h"
 
 UI::UI(SDL_Window* window, SDL_Renderer* renderer) {
     SDL_GetWindowSize(window, &windowWidth, &windowHeight);
-    font = TTF_OpenFont("D:/Xius/Dev/Game_Project/Data/Fonts/arial.ttf", 24);
+    font = TTF_OpenFontRW(AssetIndex::openRW("arial.ttf"), 1, 24);
     if (font == nullptr) {
-        std::cout << "Error: Couldn't load font = " << TTF_GetError() << std::endl;
+        LOG_ERROR(LogModule::ui, "Couldn't load font = %s", TTF_GetError());
     }
 }
 
 UI::~UI() {
+    for (auto& element : listHudElements) {
+        if (element.texture != nullptr) {
+            SDL_DestroyTexture(element.texture);
+            element.texture = nullptr;
+        }
+    }
+    if (notification.texture != nullptr) {
+        SDL_DestroyTexture(notification.texture);
+        notification.texture = nullptr;
+    }
     if (font != nullptr) {
         TTF_CloseFont(font);
         font = nullptr;
@@ -19,85 +32,67 @@ UI::~UI() {
 void UI::drawGameState(SDL_Renderer* renderer, int cityHealth, int maxCityHealth, 
                       int currentRound, int maxRounds, int enemiesRemaining,
                       int remainingTurrets, int maxTurrets, int remainingWalls, int maxWalls) {
+    PROFILE_SCOPE("UI::drawGameState");
+    ALLOCATION_TAG(AllocationTag::ui);
+    elementsRebuiltLastFrame = 0;
     if (font == nullptr || !gameStateVisible) return;
 
-    SDL_Color textColor = { 255, 255, 255, 255 };
-    char buffer[128];
-
     // Draw semi-transparent background
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 180);
     SDL_Rect bgRect = { 10, 10, 300, 170 };
     SDL_RenderFillRect(renderer, &bgRect);
 
-    // Draw city health
-    sprintf_s(buffer, "City Health: %d/%d", cityHealth, maxCityHealth);
-    SDL_Surface* surface = TTF_RenderText_Solid(font, buffer, textColor);
-    if (surface != nullptr) {
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        if (texture != nullptr) {
-            SDL_Rect rect = { 20, 20, surface->w, surface->h };
-            SDL_RenderCopy(renderer, texture, NULL, &rect);
-            SDL_DestroyTexture(texture);
-        }
-        SDL_FreeSurface(surface);
-    }
+    // Refresh any element whose value changed since it was last rendered
+    updateHudElement(renderer, hudCityHealth, "City Health: %d/%d", cityHealth, maxCityHealth, 20);
+    updateHudElement(renderer, hudRound, "Round: %d/%d", currentRound, maxRounds, 50);
+    updateHudElement(renderer, hudEnemiesRemaining, "Enemies Remaining: %d", enemiesRemaining, 0, 80);
+    updateHudElement(renderer, hudTurrets, "Turrets: %d/%d", remainingTurrets, maxTurrets, 110);
+    updateHudElement(renderer, hudWalls, "Walls: %d/%d", remainingWalls, maxWalls, 140);
 
-    // Draw round information
-    sprintf_s(buffer, "Round: %d/%d", currentRound, maxRounds);
-    surface = TTF_RenderText_Solid(font, buffer, textColor);
-    if (surface != nullptr) {
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        if (texture != nullptr) {
-            SDL_Rect rect = { 20, 50, surface->w, surface->h };
-            SDL_RenderCopy(renderer, texture, NULL, &rect);
-            SDL_DestroyTexture(texture);
-        }
-        SDL_FreeSurface(surface);
-    }
+    for (int id = 0; id < hudElementCount; id++)
+        drawHudElement(renderer, (HudElementId)id);
+}
 
-    // Draw remaining enemies
-    sprintf_s(buffer, "Enemies Remaining: %d", enemiesRemaining);
-    surface = TTF_RenderText_Solid(font, buffer, textColor);
-    if (surface != nullptr) {
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        if (texture != nullptr) {
-            SDL_Rect rect = { 20, 80, surface->w, surface->h };
-            SDL_RenderCopy(renderer, texture, NULL, &rect);
-            SDL_DestroyTexture(texture);
-        }
-        SDL_FreeSurface(surface);
-    }
+void UI::updateHudElement(SDL_Renderer* renderer, HudElementId id, const char* format,
+                          int value, int valueMax, int y) {
+    HudElement& element = listHudElements[id];
+    if (!element.dirty && element.value == value && element.valueMax == valueMax)
+        return;
 
-    // Draw remaining turrets
-    sprintf_s(buffer, "Turrets: %d/%d", remainingTurrets, maxTurrets);
-    surface = TTF_RenderText_Solid(font, buffer, textColor);
-    if (surface != nullptr) {
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        if (texture != nullptr) {
-            SDL_Rect rect = { 20, 110, surface->w, surface->h };
-            SDL_RenderCopy(renderer, texture, NULL, &rect);
-            SDL_DestroyTexture(texture);
-        }
-        SDL_FreeSurface(surface);
+    if (element.texture != nullptr) {
+        SDL_DestroyTexture(element.texture);
+        element.texture = nullptr;
     }
 
-    // Draw remaining walls
-    sprintf_s(buffer, "Walls: %d/%d", remainingWalls, maxWalls);
-    surface = TTF_RenderText_Solid(font, buffer, textColor);
+    SDL_Color textColor = { 255, 255, 255, 255 };
+    char buffer[128];
+    sprintf_s(buffer, format, value, valueMax);
+    SDL_Surface* surface = TTF_RenderText_Solid(font, buffer, textColor);
     if (surface != nullptr) {
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        if (texture != nullptr) {
-            SDL_Rect rect = { 20, 140, surface->w, surface->h };
-            SDL_RenderCopy(renderer, texture, NULL, &rect);
-            SDL_DestroyTexture(texture);
-        }
+        element.texture = SDL_CreateTextureFromSurface(renderer, surface);
+        element.rect = { 20, y, surface->w, surface->h };
         SDL_FreeSurface(surface);
     }
+
+    element.value = value;
+    element.valueMax = valueMax;
+    element.dirty = false;
+    elementsRebuiltLastFrame++;
+}
+
+void UI::drawHudElement(SDL_Renderer* renderer, HudElementId id) {
+    const HudElement& element = listHudElements[id];
+    if (element.texture != nullptr)
+        SDL_RenderCopy(renderer, element.texture, NULL, &element.rect);
 }
 
-void UI::showNotification(const std::string& message) {
-    notification.message = message;
+void UI::showNotification(const char* message) {
+    // Held mouse buttons repeat the same message every frame, so only re-render it if it changed
+    if (!notification.active || SDL_strcmp(notification.message, message) != 0) {
+        SDL_strlcpy(notification.message, message, sizeof(notification.message));
+        notification.dirty = true;
+    }
     notification.currentTime = notification.displayTime;
     notification.active = true;
 }
@@ -112,33 +107,46 @@ void UI::updateNotification(float dT) {
 }
 
 void UI::drawNotification(SDL_Renderer* renderer) {
+    ALLOCATION_TAG(AllocationTag::ui);
     if (!notification.active || font == nullptr) return;
 
-    SDL_Color textColor = { 255, 255, 255, 255 };
-    SDL_Surface* surface = TTF_RenderText_Solid(font, notification.message.c_str(), textColor);
-    if (surface != nullptr) {
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        if (texture != nullptr) {
-            SDL_Rect rect = {
+    // Only re-render the message texture when a new notification was shown
+    if (notification.dirty) {
+        if (notification.texture != nullptr) {
+            SDL_DestroyTexture(notification.texture);
+            notification.texture = nullptr;
+        }
+
+        SDL_Color textColor = { 255, 255, 255, 255 };
+        SDL_Surface* surface = TTF_RenderText_Solid(font, notification.message, textColor);
+        if (surface != nullptr) {
+            notification.texture = SDL_CreateTextureFromSurface(renderer, surface);
+            notification.rect = {
                 (windowWidth - surface->w) / 2,
                 windowHeight / 4,
                 surface->w,
                 surface->h
             };
-            
-            SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 180);
-            SDL_Rect bgRect = {
-                rect.x - 20,
-                rect.y - 10,
-                rect.w + 40,
-                rect.h + 20
-            };
-            SDL_RenderFillRect(renderer, &bgRect);
-            
-            SDL_RenderCopy(renderer, texture, NULL, &rect);
-            SDL_DestroyTexture(texture);
+            SDL_FreeSurface(surface);
         }
-        SDL_FreeSurface(surface);
+
+        notification.dirty = false;
+        elementsRebuiltLastFrame++;
+    }
+
+    if (notification.texture != nullptr) {
+        const SDL_Rect& rect = notification.rect;
+
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 180);
+        SDL_Rect bgRect = {
+            rect.x - 20,
+            rect.y - 10,
+            rect.w + 40,
+            rect.h + 20
+        };
+        SDL_RenderFillRect(renderer, &bgRect);
+
+        SDL_RenderCopy(renderer, notification.texture, NULL, &rect);
     }
 } 
\ No newline at end of file
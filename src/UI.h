@@ -11,12 +11,39 @@ private:
     bool gameStateVisible = true;
     
     struct Notification {
-        std::string message;
+        char message[128] = "";
         float displayTime = 4.0f;
         float currentTime = 0.0f;
         bool active = false;
+        SDL_Texture* texture = nullptr;
+        SDL_Rect rect = { 0, 0, 0, 0 };
+        bool dirty = true;
     } notification;
 
+    // Retained HUD text: the texture and layout are only rebuilt when the shown values change.
+    enum HudElementId {
+        hudCityHealth,
+        hudRound,
+        hudEnemiesRemaining,
+        hudTurrets,
+        hudWalls,
+        hudElementCount
+    };
+
+    struct HudElement {
+        int value = 0;
+        int valueMax = 0;
+        SDL_Texture* texture = nullptr;
+        SDL_Rect rect = { 0, 0, 0, 0 };
+        bool dirty = true;
+    } listHudElements[hudElementCount];
+
+    int elementsRebuiltLastFrame = 0;
+
+    void updateHudElement(SDL_Renderer* renderer, HudElementId id, const char* format,
+                          int value, int valueMax, int y);
+    void drawHudElement(SDL_Renderer* renderer, HudElementId id);
+
 public:
     UI(SDL_Window* window, SDL_Renderer* renderer);
     ~UI();
@@ -24,9 +51,13 @@ public:
     void drawGameState(SDL_Renderer* renderer, int cityHealth, int maxCityHealth, 
                       int currentRound, int maxRounds, int enemiesRemaining,
                       int remainingTurrets, int maxTurrets, int remainingWalls, int maxWalls);
-    void showNotification(const std::string& message);
+    void showNotification(const char* message);
     void updateNotification(float dT);
     void drawNotification(SDL_Renderer* renderer);
+    bool isNotificationActive() const { return notification.active; }
     void toggleGameState() { gameStateVisible = !gameStateVisible; }
     bool isGameStateVisible() const { return gameStateVisible; }
+
+    // Number of HUD textures that had to be re-rendered during the last drawn frame.
+    int getElementsRebuiltLastFrame() const { return elementsRebuiltLastFrame; }
 }; 
\ No newline at end of file
@@ -1,9 +1,13 @@
 #include "Unit.h"
+#include <algorithm>
 #include "Game.h"
 
 
 const float Unit::baseSpeed = 0.5f;
 const float Unit::size = 0.48f;
+const float Unit::crowdAvoidance = 2.0f;
+const float Unit::pathDeviationMax = 0.5f;
+const float Unit::pathLookahead = 2.0f;
 
 
 
@@ -18,69 +22,128 @@ Unit::Unit(SDL_Renderer* renderer, Vector2D setPos, int roundNumber) :
 
 
 
-void Unit::update(float dT, Level& level, std::vector<std::shared_ptr<Unit>>& listUnits) {
+void Unit::update(float dT, Level& level, const CrowdField& crowdField) {
 	timerJustHurt.countDown(dT);
 
-	//Determine the distance to the target from the unit's current position.
-	float distanceToTarget = (level.getTargetPos() - pos).magnitude();
+	//Check if this unit is on one of its targets' tiles, and how far it is from the center.
+	int tileX = (int)pos.x;
+	int tileY = (int)pos.y;
+	bool isOnTarget = level.isTileTarget(tileX, tileY, flowFieldID);
+	Vector2D posTarget((float)tileX + 0.5f, (float)tileY + 0.5f);
+	float distanceToTarget = (isOnTarget ? (posTarget - pos).magnitude() : 0.0f);
 
-	if (distanceToTarget < 0.5f) {
+	if (isOnTarget && distanceToTarget < 0.5f) {
 		healthCurrent = 0;
 		hasReachedTarget = true;
 	}
 	else {
 		//Determine the distance to move this frame.
 		float distanceMove = currentSpeed * dT;
-		if (distanceMove > distanceToTarget)
+		if (isOnTarget && distanceMove > distanceToTarget)
 			distanceMove = distanceToTarget;
 
-		//Find the normal from the flow field.
-		Vector2D directionNormal(level.getFlowNormal((int)pos.x, (int)pos.y));
-		//If this reached the target tile, then modify directionNormal to point to the target tile.
-		if ((int)pos.x == (int)level.getTargetPos().x && (int)pos.y == (int)level.getTargetPos().y)
-			directionNormal = (level.getTargetPos() - pos).normalize();
-
-		Vector2D posAdd = directionNormal * distanceMove;
-
-		//Check if the new position would overlap any other units or not.
-		bool moveOk = true;
-		for (int count = 0; count < listUnits.size() && moveOk; count++) {
-			auto& unitSelected = listUnits[count];
-			if (unitSelected != nullptr && unitSelected.get() != this &&
-				unitSelected->checkOverlap(pos, size)) {
-				//They overlap so check and see if this unit is moving towards or away 
-				//from the unit it overlaps.
-				Vector2D directionToOther = (unitSelected->pos - pos);
-				//Ensure that they're not directly on top of each other.
-				if (directionToOther.magnitude() > 0.01f) {
-					//Check the angle between the units positions and the direction that this unit 
-					//is traveling.  Ensure that this unit isn't moving directly towards the other 
-					//unit (by checking the angle between).
-					Vector2D normalToOther(directionToOther.normalize());
-					float angleBtw = abs(normalToOther.angleBetween(directionNormal));
-					if (angleBtw < 3.14159265359f / 4.0f)
-						//Don't allow the move.
-						moveOk = false;
-				}
-			}
+		//Head along the unit's path while it's on it, and otherwise find the normal from its flow
+		//field, blended between tiles if it's smooth.  If this reached the target tile, then point
+		//directionNormal to the target tile.
+		Vector2D directionNormal;
+		if (isOnTarget)
+			directionNormal = (posTarget - pos).normalize();
+		else if (getPathDirection(level, directionNormal) == false)
+			directionNormal = level.getFlowNormal(pos, flowFieldID);
+
+		//Steer out of crowds too, down the slope of the density of units around this one.  A unit
+		//held back by the crowd slows down instead of bunching up, but units walking into the
+		//city aren't held back.
+		Vector2D direction(directionNormal);
+		if (isOnTarget == false) {
+			direction += crowdField.getPush(pos) * crowdAvoidance;
+			float magnitude = direction.magnitude();
+			if (magnitude > 1.0f)
+				direction /= magnitude;
 		}
+		Vector2D posAdd = direction * distanceMove;
+
+		//Keep some clearance from the walls.  A move that would cut into it is pushed back out
+		//from the wall, which slides the unit along it.  The push is never more than the move,
+		//so a unit that's already too close eases away rather than jumping.
+		const float spacing = 0.35f;
+		Vector2D normalWall;
+		pos += posAdd;
+		float clearance = level.getWallDistanceField().getClearance(pos, normalWall);
+		if (clearance < spacing)
+			pos += normalWall * std::min(spacing - clearance, distanceMove);
+	}
+}
+
+
 
-		if (moveOk) {
-			//Check if it needs to move in the x direction.  If so then check if the new x position, plus an amount of spacing 
-			//(to keep from moving too close to the wall) is within a wall or not and update the position as required.
-			const float spacing = 0.35f;
-			int x = (int)(pos.x + posAdd.x + copysign(spacing, posAdd.x));
-			int y = (int)(pos.y);
-			if (posAdd.x != 0.0f && level.isTileWall(x, y) == false)
-				pos.x += posAdd.x;
-
-			//Do the same for the y direction.
-			x = (int)(pos.x);
-			y = (int)(pos.y + posAdd.y + copysign(spacing, posAdd.y));
-			if (posAdd.y != 0.0f && level.isTileWall(x, y) == false)
-				pos.y += posAdd.y;
+//Points on a path are never in the same place, so a segment always has a length.
+static float getDistanceSquaredToSegment(Vector2D pos, Vector2D start, Vector2D end) {
+	Vector2D offset = end - start;
+	Vector2D posRelative = pos - start;
+	float fraction = std::min(std::max(posRelative.dot(offset) / offset.dot(offset), 0.0f), 1.0f);
+	Vector2D offsetClosest = posRelative - offset * fraction;
+	return offsetClosest.dot(offsetClosest);
+}
+
+
+bool Unit::getPathDirection(const Level& level, Vector2D& direction) {
+	if (enemySpawnerID < 0 || flowFieldID != 0)
+		return false;
+
+	int pointCount;
+	unsigned int pathVersionCurrent;
+	const Vector2D* listPoints = level.getEnemyPath(enemySpawnerID, pointCount, pathVersionCurrent);
+	if (pointCount < 2)
+		return false;
+
+	//After the path changed the unit could be anywhere along it, so every segment is checked for
+	//the closest.  Otherwise it's still by the segment it was by, or has passed its end onto the
+	//next, even if it's strayed off the path for now.
+	if (pathVersionCurrent != pathVersion) {
+		int segmentBest = 1;
+		float distanceSquaredBest = -1.0f;
+		for (int segment = 1; segment < pointCount; segment++) {
+			float distanceSquared = getDistanceSquaredToSegment(pos, listPoints[segment - 1], listPoints[segment]);
+			if (distanceSquaredBest < 0.0f || distanceSquared < distanceSquaredBest) {
+				segmentBest = segment;
+				distanceSquaredBest = distanceSquared;
+			}
 		}
+		pathPointNext = segmentBest;
+		pathVersion = pathVersionCurrent;
+	}
+	pathPointNext = std::min(std::max(pathPointNext, 1), pointCount - 1);
+
+	Vector2D start = listPoints[pathPointNext - 1], end = listPoints[pathPointNext];
+	Vector2D offset = end - start;
+	float fraction = (pos - start).dot(offset) / offset.dot(offset);
+	if (fraction >= 1.0f && pathPointNext + 1 < pointCount) {
+		pathPointNext++;
+		start = end;
+		end = listPoints[pathPointNext];
+		offset = end - start;
+		fraction = (pos - start).dot(offset) / offset.dot(offset);
 	}
+	fraction = std::min(std::max(fraction, 0.0f), 1.0f);
+
+	Vector2D posClosest = start + offset * fraction;
+	Vector2D offsetClosest = pos - posClosest;
+	if (offsetClosest.dot(offsetClosest) > pathDeviationMax * pathDeviationMax)
+		return false;
+
+	//Aim a little further along the path than the closest point, which draws the unit back onto
+	//it and carries it round corners.
+	float length = offset.magnitude();
+	Vector2D posAim = end;
+	if (fraction * length + pathLookahead < length)
+		posAim = posClosest + offset * (pathLookahead / length);
+
+	Vector2D offsetAim = posAim - pos;
+	if (offsetAim.magnitude() < 0.001f)
+		return false;
+	direction = offsetAim.normalize();
+	return true;
 }
 
 
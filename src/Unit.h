@@ -4,6 +4,7 @@
 #include "SDL2/SDL.h"
 #include "Vector2D.h"
 #include "Level.h"
+#include "CrowdField.h"
 #include "TextureLoader.h"
 #include "Timer.h"
 class Game;
@@ -14,19 +15,32 @@ class Unit
 {
 public:
 	Unit(SDL_Renderer* renderer, Vector2D setPos, int roundNumber = 0);
-	void update(float dT, Level& level, std::vector<std::shared_ptr<Unit>>& listUnits);
+	void update(float dT, Level& level, const CrowdField& crowdField);
 	void draw(SDL_Renderer* renderer, int tileSize);
 	bool checkOverlap(Vector2D posOther, float sizeOther);
 	bool isAlive();
 	Vector2D getPos();
 	void removeHealth(int damage);
 	bool reachedTarget() const { return hasReachedTarget; }
+	//Which of the level's flow fields, and so which group of targets, this unit heads for.
+	void setFlowFieldID(int flowFieldIDNew) { flowFieldID = flowFieldIDNew; }
+	int getFlowFieldID() const { return flowFieldID; }
+	//The spawner this unit came from, whose path it follows while it's on field 0.
+	void setEnemySpawnerID(int enemySpawnerIDNew) { enemySpawnerID = enemySpawnerIDNew; }
 
 
 private:
+	bool getPathDirection(const Level& level, Vector2D& direction);
+
+
 	Vector2D pos;
 	static const float baseSpeed;
 	static const float size;
+	//How hard units steer out of crowds, against the flow field's pull of 1.
+	static const float crowdAvoidance;
+	//How far a unit can stray from its path and still follow it, and how far ahead on it it aims.
+	static const float pathDeviationMax;
+	static const float pathLookahead;
 	float currentSpeed;
 
 	SDL_Texture* texture = nullptr;
@@ -36,4 +50,11 @@ private:
 	const int healthMax = 2;
 	int healthCurrent = healthMax;
 	bool hasReachedTarget = false;
+	int flowFieldID = 0;
+
+	//Where the unit is on its spawner's path, as the point it's heading for, and which version of
+	//the path that's for.
+	int enemySpawnerID = -1;
+	int pathPointNext = 1;
+	unsigned int pathVersion = 0;
 };
\ No newline at end of file
@@ -0,0 +1,237 @@
+#include "WallDistanceField.h"
+#include <algorithm>
+#include <cmath>
+
+
+
+//The clearance over a quarter of a tile for each pattern of walls beside it, in cells of sampleStep
+//across.  Points are measured as gaps from the two sides of the tile the quarter is at, from 0 to
+//half a tile, and bits 0, 1 and 2 of the pattern are the wall past the side across x, past the side
+//across y, and past the corner between them.  Each cell holds the slope of the clearance at its
+//center, which is the direction away from the nearest wall, in 127ths, and what's added to the
+//slope times the gaps, in 510ths of a tile.  That's exact by the side of a wall and follows the
+//curve around a corner closely.
+struct ClearanceSample {
+	signed char normalX, normalY;
+	unsigned char offset;
+};
+static constexpr int sampleCountQuarter = (int)(0.5f / WallDistanceField::sampleStep);
+static constexpr float sampleNormalScale = 1.0f / 127.0f, sampleOffsetScale = 1.0f / 510.0f;
+using ClearanceSamples = ClearanceSample[8][sampleCountQuarter][sampleCountQuarter];
+
+
+static const ClearanceSamples& calculateClearanceSamples() {
+	static ClearanceSamples listSamples;
+	for (int pattern = 0; pattern < 8; pattern++) {
+		for (int indexY = 0; indexY < sampleCountQuarter; indexY++) {
+			for (int indexX = 0; indexX < sampleCountQuarter; indexX++) {
+				float gapX = (indexX + 0.5f) * WallDistanceField::sampleStep;
+				float gapY = (indexY + 0.5f) * WallDistanceField::sampleStep;
+				float clearance = 0.5f, normalX = 0.0f, normalY = 0.0f;
+				if ((pattern & 1) != 0 && gapX < clearance) {
+					clearance = gapX;
+					normalX = 1.0f;
+				}
+				if ((pattern & 2) != 0 && gapY < clearance) {
+					clearance = gapY;
+					normalX = 0.0f;
+					normalY = 1.0f;
+				}
+
+				//A wall beside the quarter is never further than the corner past it.
+				float distanceCorner = std::sqrt(gapX * gapX + gapY * gapY);
+				if (pattern == 4 && distanceCorner < clearance) {
+					clearance = distanceCorner;
+					normalX = gapX / distanceCorner;
+					normalY = gapY / distanceCorner;
+				}
+
+				float offset = (normalX == 0.0f && normalY == 0.0f ? clearance : 0.0f);
+				listSamples[pattern][indexY][indexX] = { (signed char)std::lround(normalX * 127.0f),
+					(signed char)std::lround(normalY * 127.0f), (unsigned char)std::lround(offset * 510.0f) };
+			}
+		}
+	}
+	return listSamples;
+}
+
+
+static const ClearanceSamples& listClearanceSamples = calculateClearanceSamples();
+
+
+
+//Runs a two pass chamfer transform over an area, where tiles that are 0 are where distances are
+//measured from.  The first pass carries distances down and right, the second up and left.
+template <int stepStraight, int stepDiagonal>
+static void calculateChamfer(unsigned char* listDistances, int width, int height) {
+	for (int y = 0; y < height; y++) {
+		unsigned char* row = listDistances + y * width;
+		const unsigned char* rowAbove = row - width;
+		for (int x = 0; x < width; x++) {
+			int distance = row[x];
+			if (x > 0)
+				distance = std::min(distance, row[x - 1] + stepStraight);
+			if (y > 0) {
+				distance = std::min(distance, rowAbove[x] + stepStraight);
+				if (x > 0)
+					distance = std::min(distance, rowAbove[x - 1] + stepDiagonal);
+				if (x + 1 < width)
+					distance = std::min(distance, rowAbove[x + 1] + stepDiagonal);
+			}
+			row[x] = (unsigned char)distance;
+		}
+	}
+
+	for (int y = height - 1; y >= 0; y--) {
+		unsigned char* row = listDistances + y * width;
+		const unsigned char* rowBelow = row + width;
+		for (int x = width - 1; x >= 0; x--) {
+			int distance = row[x];
+			if (x + 1 < width)
+				distance = std::min(distance, row[x + 1] + stepStraight);
+			if (y + 1 < height) {
+				distance = std::min(distance, rowBelow[x] + stepStraight);
+				if (x + 1 < width)
+					distance = std::min(distance, rowBelow[x + 1] + stepDiagonal);
+				if (x > 0)
+					distance = std::min(distance, rowBelow[x - 1] + stepDiagonal);
+			}
+			row[x] = (unsigned char)distance;
+		}
+	}
+}
+
+
+
+WallDistanceField::WallDistanceField(const WallGrid& wallGrid, int tileCountX, int tileCountY) :
+	wallGrid(wallGrid), tileCountX(tileCountX), tileCountY(tileCountY),
+	listTiles((size_t)tileCountX * tileCountY, Tile{ distanceCap, 0 }) {
+}
+
+
+void WallDistanceField::rebuild() {
+	calculateArea(0, 0, tileCountX - 1, tileCountY - 1);
+
+	for (int y = 0; y < tileCountY; y++)
+		for (int x = 0; x < tileCountX; x++)
+			listTiles[x + y * tileCountX].wallMask = getWallMask(x, y);
+}
+
+
+void WallDistanceField::updateTile(int x, int y) {
+	calculateArea(x - distanceMax, y - distanceMax, x + distanceMax, y + distanceMax);
+
+	//The tile is the neighbor on the opposite side of each of its own neighbors.
+	bool isWall = wallGrid.isWall(x, y);
+	for (int offsetY = -1; offsetY <= 1; offsetY++) {
+		for (int offsetX = -1; offsetX <= 1; offsetX++) {
+			int neighborX = x + offsetX, neighborY = y + offsetY;
+			if ((offsetX == 0 && offsetY == 0) || neighborX < 0 || neighborX >= tileCountX ||
+				neighborY < 0 || neighborY >= tileCountY)
+				continue;
+
+			unsigned char& wallMask = listTiles[neighborX + neighborY * tileCountX].wallMask;
+			int bit = getNeighborBit(-offsetX, -offsetY);
+			wallMask = (unsigned char)(isWall ? wallMask | bit : wallMask & ~bit);
+		}
+	}
+}
+
+
+void WallDistanceField::calculateArea(int xMin, int yMin, int xMax, int yMax) {
+	xMin = std::max(xMin, 0);
+	yMin = std::max(yMin, 0);
+	xMax = std::min(xMax, tileCountX - 1);
+	yMax = std::min(yMax, tileCountY - 1);
+	if (xMin > xMax || yMin > yMax)
+		return;
+
+	//A tile's distance only depends on the tiles within distanceMax of it, and the shortest
+	//chamfer path between two tiles stays inside the box around them, so the transform only has
+	//to run over the area grown by that much.
+	int readXMin = std::max(xMin - distanceMax, 0), readYMin = std::max(yMin - distanceMax, 0);
+	int readXMax = std::min(xMax + distanceMax, tileCountX - 1), readYMax = std::min(yMax + distanceMax, tileCountY - 1);
+	int width = readXMax - readXMin + 1, height = readYMax - readYMin + 1;
+	listArea.resize((size_t)width * height);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+			listArea[x + y * width] = (wallGrid.isWall(readXMin + x, readYMin + y) ? 0 : distanceCap);
+	calculateChamfer<stepStraight, stepDiagonal>(listArea.data(), width, height);
+
+	for (int y = yMin; y <= yMax; y++)
+		for (int x = xMin; x <= xMax; x++)
+			listTiles[x + y * tileCountX].distance = listArea[(x - readXMin) + (y - readYMin) * width];
+}
+
+
+
+float WallDistanceField::getClearance(Vector2D pos) const {
+	Vector2D normal;
+	return getClearance(pos, normal);
+}
+
+
+float WallDistanceField::getClearance(Vector2D pos, Vector2D& normal) const {
+	int tileX = (int)std::floor(pos.x), tileY = (int)std::floor(pos.y);
+	float offsetX = pos.x - tileX, offsetY = pos.y - tileY;
+	Tile tile;
+	if (tileX >= 0 && tileX < tileCountX && tileY >= 0 && tileY < tileCountY)
+		tile = listTiles[tileX + tileY * tileCountX];
+	else
+		tile = { (unsigned char)stepStraight, getWallMask(tileX, tileY) };
+
+	//With no wall among the neighbors there's a whole tile between the position and any wall.  A
+	//wall c fifths of a tile away is at least c / 7 tiles away on one axis.
+	if (tile.distance > stepDiagonal) {
+		normal = Vector2D();
+		return std::max(1.0f, (float)tile.distance / stepDiagonal - 1.0f);
+	}
+
+	//Inside a wall the way out is through its nearest edge.
+	if (tile.distance == 0) {
+		float gapX = std::min(offsetX, 1.0f - offsetX), gapY = std::min(offsetY, 1.0f - offsetY);
+		if (gapX < gapY) {
+			normal = Vector2D(offsetX < 0.5f ? -1.0f : 1.0f, 0.0f);
+			return -gapX;
+		}
+		normal = Vector2D(0.0f, offsetY < 0.5f ? -1.0f : 1.0f);
+		return -gapY;
+	}
+
+	//Only the walls beside the quarter of the tile the position is in can be within half a tile of
+	//it.  Their bits in the wall mask follow from its reading order.
+	int sideX = (offsetX < 0.5f ? 0 : 1), sideY = (offsetY < 0.5f ? 0 : 1);
+	int pattern = ((tile.wallMask >> (3 + sideX)) & 1) | (((tile.wallMask >> (1 + 5 * sideY)) & 1) << 1) |
+		(((tile.wallMask >> (2 * sideX + 5 * sideY)) & 1) << 2);
+	float gapX = 0.5f - std::fabs(offsetX - 0.5f), gapY = 0.5f - std::fabs(offsetY - 0.5f);
+	const ClearanceSample& sample = listClearanceSamples[pattern]
+		[std::min((int)(gapY / sampleStep), sampleCountQuarter - 1)]
+		[std::min((int)(gapX / sampleStep), sampleCountQuarter - 1)];
+	float normalX = sample.normalX * sampleNormalScale, normalY = sample.normalY * sampleNormalScale;
+	normal = Vector2D(normalX * (1 - 2 * sideX), normalY * (1 - 2 * sideY));
+	return normalX * gapX + normalY * gapY + sample.offset * sampleOffsetScale;
+}
+
+
+int WallDistanceField::getNeighborBit(int offsetX, int offsetY) {
+	//The neighbors in reading order, skipping the tile itself.
+	int index = (offsetX + 1) + (offsetY + 1) * 3;
+	return 1 << (index > 4 ? index - 1 : index);
+}
+
+
+unsigned char WallDistanceField::getWallMask(int x, int y) const {
+	unsigned char wallMask = 0;
+	for (int offsetY = -1; offsetY <= 1; offsetY++)
+		for (int offsetX = -1; offsetX <= 1; offsetX++)
+			if ((offsetX != 0 || offsetY != 0) && wallGrid.isWall(x + offsetX, y + offsetY))
+				wallMask |= getNeighborBit(offsetX, offsetY);
+	return wallMask;
+}
+
+
+int WallDistanceField::getDistance(int x, int y) const {
+	if (x < 0 || x >= tileCountX || y < 0 || y >= tileCountY)
+		return 0;
+	return listTiles[x + y * tileCountX].distance;
+}
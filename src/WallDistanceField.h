@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include "Vector2D.h"
+#include "WallGrid.h"
+
+
+
+//Each tile's distance to the nearest wall, for keeping units clear of them.  Distances are chamfer
+//distances in fifths of a tile, 5 for a straight step and 7 for a diagonal one like the flow
+//field's, and stop counting at distanceMax tiles, since nothing needs to know about walls further
+//away than that.
+//
+//Each tile also keeps which of its eight neighbors are walls next to its distance, so a point's
+//clearance is one read of its tile.  Far from walls the distance bounds it, and in a tile touching
+//a wall it comes from a table over the quarter of the tile the point is in, keyed by the walls
+//beside that quarter.  Because distances stop at distanceMax, an edit only changes the tiles within
+//that range of it.
+class WallDistanceField
+{
+public:
+	static constexpr int distanceMax = 8;
+	//The spacing of the points the clearance by a wall is worked out at, in tiles.
+	static constexpr float sampleStep = 1.0f / 32.0f;
+
+	WallDistanceField(const WallGrid& wallGrid, int tileCountX, int tileCountY);
+
+	void rebuild();
+	//Call after a tile's wall state changed.
+	void updateTile(int x, int y);
+
+	//The distance from the position to the edge of the nearest wall in tiles, or how far inside
+	//one it is as a negative.  Within half a tile of a wall it's off by less than one and a half
+	//sampleSteps, and further out it's a lower bound of at least half a tile.  The edge of the map
+	//isn't a wall.
+	float getClearance(Vector2D pos) const;
+	//Also gives the direction away from the nearest wall, if it's within half a tile or the
+	//position is inside it, and otherwise zero.
+	float getClearance(Vector2D pos, Vector2D& normal) const;
+	//The tile's distance in fifths of a tile, which is 0 for walls, and off the map.
+	int getDistance(int x, int y) const;
+
+
+private:
+	static constexpr int stepStraight = 5, stepDiagonal = 7;
+	static constexpr unsigned char distanceCap = distanceMax * stepStraight;
+
+	struct Tile {
+		unsigned char distance;
+		//A bit for each of the tile's neighbors that's a wall.
+		unsigned char wallMask;
+	};
+
+	void calculateArea(int xMin, int yMin, int xMax, int yMax);
+	//The bit in a tile's wall mask for the neighbor at the offset.
+	static int getNeighborBit(int offsetX, int offsetY);
+	unsigned char getWallMask(int x, int y) const;
+
+
+	const WallGrid& wallGrid;
+	const int tileCountX, tileCountY;
+	std::vector<Tile> listTiles;
+	//Scratch for an update, the distances over the area it reads.
+	std::vector<unsigned char> listArea;
+};
@@ -0,0 +1,165 @@
+#include "WallGrid.h"
+#include <algorithm>
+
+
+
+//Counts the set bits in a word.
+static int countBits(uint64_t word) {
+#if defined(__GNUC__)
+	return __builtin_popcountll(word);
+#else
+	int count = 0;
+	for (; word != 0; word &= word - 1)
+		count++;
+	return count;
+#endif
+}
+
+
+//Spreads the set bits of a word towards its high end, and towards its low end, through open bits.
+//Each step doubles the distance covered, so a whole word takes six.
+static uint64_t spreadUp(uint64_t bits, uint64_t open) {
+	for (int shift = 1; shift < 64; shift *= 2) {
+		bits |= open & (bits << shift);
+		open &= open << shift;
+	}
+	return bits;
+}
+
+
+static uint64_t spreadDown(uint64_t bits, uint64_t open) {
+	for (int shift = 1; shift < 64; shift *= 2) {
+		bits |= open & (bits >> shift);
+		open &= open >> shift;
+	}
+	return bits;
+}
+
+
+
+WallGrid::WallGrid(int tileCountX, int tileCountY) :
+	tileCountX(tileCountX), tileCountY(tileCountY),
+	wordsPerRow((tileCountX + 63) / 64),
+	listWords((size_t)((tileCountX + 63) / 64) * tileCountY, 0) {
+}
+
+
+void WallGrid::setWall(int x, int y, bool isWall) {
+	setBit(listWords, x, y, isWall);
+}
+
+
+void WallGrid::clear() {
+	std::fill(listWords.begin(), listWords.end(), 0);
+}
+
+
+
+int WallGrid::spread(std::vector<uint64_t>& listReached, int xBlocked, int yBlocked) const {
+	Blocked blocked = { -1, 0 };
+	if ((unsigned int)xBlocked < (unsigned int)tileCountX && (unsigned int)yBlocked < (unsigned int)tileCountY) {
+		blocked.index = yBlocked * wordsPerRow + (xBlocked >> 6);
+		blocked.bit = (uint64_t)1 << (xBlocked & 63);
+		listReached[blocked.index] &= ~blocked.bit;
+	}
+
+	//Spread every row that starts with something in it along its open runs.
+	for (int y = 0; y < tileCountY; y++) {
+		for (int word = 0; word < wordsPerRow; word++) {
+			if (listReached[y * wordsPerRow + word] != 0) {
+				fillRow(y, listReached, blocked);
+				break;
+			}
+		}
+	}
+
+	//Sweep down the rows and back up.  Each row takes in the open tiles next to what the row
+	//before it reached and spreads them along its open runs, so a sweep follows a path as far as
+	//it keeps going the same way.  It's done when a pair of sweeps doesn't reach anything new.
+	bool isChanged = true;
+	while (isChanged) {
+		isChanged = false;
+		for (int step : { 1, -1 }) {
+			for (int y = (step == 1 ? 1 : tileCountY - 2); y >= 0 && y < tileCountY; y += step) {
+				uint64_t* listRowReached = &listReached[y * wordsPerRow];
+				const uint64_t* listRowBefore = &listReached[(y - step) * wordsPerRow];
+
+				bool isRowChanged = false;
+				for (int word = 0; word < wordsPerRow; word++) {
+					uint64_t bitsNew = listRowBefore[word] & ~listRowReached[word] & getOpen(y, word, blocked);
+					if (bitsNew != 0) {
+						listRowReached[word] |= bitsNew;
+						isRowChanged = true;
+					}
+				}
+
+				if (isRowChanged) {
+					fillRow(y, listReached, blocked);
+					isChanged = true;
+				}
+			}
+		}
+	}
+
+	int count = 0;
+	for (uint64_t word : listReached)
+		count += countBits(word);
+	return count;
+}
+
+
+void WallGrid::fillRow(int y, std::vector<uint64_t>& listReached, const Blocked& blocked) const {
+	uint64_t* listRowReached = &listReached[y * wordsPerRow];
+
+	//Spread along the row to the right, carrying into the next word when a run crosses into it,
+	//then back to the left.  Every open run with a reached tile in it ends up reached.
+	uint64_t carry = 0;
+	for (int word = 0; word < wordsPerRow; word++) {
+		uint64_t open = getOpen(y, word, blocked);
+		listRowReached[word] = spreadUp(listRowReached[word] | (carry & open), open);
+		carry = listRowReached[word] >> 63;
+	}
+
+	carry = 0;
+	for (int word = wordsPerRow - 1; word >= 0; word--) {
+		uint64_t open = getOpen(y, word, blocked);
+		listRowReached[word] = spreadDown(listRowReached[word] | ((carry << 63) & open), open);
+		carry = listRowReached[word] & 1;
+	}
+}
+
+
+
+int WallGrid::getWordsPerRow() const {
+	return wordsPerRow;
+}
+
+
+bool WallGrid::isSet(const std::vector<uint64_t>& listBits, int x, int y) const {
+	return ((unsigned int)x < (unsigned int)tileCountX && (unsigned int)y < (unsigned int)tileCountY &&
+		(listBits[y * wordsPerRow + (x >> 6)] >> (x & 63) & 1) != 0);
+}
+
+
+void WallGrid::setBit(std::vector<uint64_t>& listBits, int x, int y, bool isSet) const {
+	if ((unsigned int)x >= (unsigned int)tileCountX || (unsigned int)y >= (unsigned int)tileCountY)
+		return;
+
+	uint64_t& word = listBits[y * wordsPerRow + (x >> 6)];
+	uint64_t bit = (uint64_t)1 << (x & 63);
+	word = (isSet ? word | bit : word & ~bit);
+}
+
+
+uint64_t WallGrid::getRowMask(int word) const {
+	//The bits of the word that are on the map.
+	int bitCount = tileCountX - word * 64;
+	return (bitCount >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << bitCount) - 1);
+}
+
+
+uint64_t WallGrid::getOpen(int y, int word, const Blocked& blocked) const {
+	int index = y * wordsPerRow + word;
+	uint64_t open = ~listWords[index] & getRowMask(word);
+	return (index == blocked.index ? open & ~blocked.bit : open);
+}
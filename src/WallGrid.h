@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+
+
+//A bit per tile that's set for walls, kept in sync with the level's tiles.  Each row is a run of
+//64 bit words, with the bits past the end of the row always clear, so whole rows can be worked on
+//a word at a time when flood filling the open tiles.  The loops over a row are plain word
+//operations that compilers vectorize.  Sets of tiles that come out of it use the same layout.
+class WallGrid
+{
+public:
+	WallGrid(int tileCountX, int tileCountY);
+
+	void setWall(int x, int y, bool isWall);
+	//Tiles off the map aren't walls.
+	bool isWall(int x, int y) const {
+		return ((unsigned int)x < (unsigned int)tileCountX && (unsigned int)y < (unsigned int)tileCountY &&
+			(listWords[y * wordsPerRow + (x >> 6)] >> (x & 63) & 1) != 0);
+	}
+	void clear();
+
+	//Spreads the open tiles already set in listReached to every open tile they can reach, moving
+	//in 4 directions, and returns how many are reached.  A blocked tile is treated as a wall, to
+	//try one out without changing the grid.
+	int spread(std::vector<uint64_t>& listReached, int xBlocked = -1, int yBlocked = -1) const;
+
+	int getWordsPerRow() const;
+	//Tests and changes a tile in a set laid out like the grid.
+	bool isSet(const std::vector<uint64_t>& listBits, int x, int y) const;
+	void setBit(std::vector<uint64_t>& listBits, int x, int y, bool isSet) const;
+
+
+private:
+	//A tile treated as a wall for one spread, as the index of its word and its bit.
+	struct Blocked {
+		int index;
+		uint64_t bit;
+	};
+
+	uint64_t getRowMask(int word) const;
+	uint64_t getOpen(int y, int word, const Blocked& blocked) const;
+	void fillRow(int y, std::vector<uint64_t>& listReached, const Blocked& blocked) const;
+
+
+	const int tileCountX, tileCountY;
+	const int wordsPerRow;
+	std::vector<uint64_t> listWords;
+};
@@ -0,0 +1,170 @@
+#include "WorkerPool.h"
+#include <algorithm>
+#include "Profiler.h"
+#include "Logger.h"
+
+
+
+
+WorkerPool::WorkerPool(int threadCount) {
+	if (threadCount <= 0)
+		threadCount = std::max(1, SDL_GetCPUCount() - 1);
+
+	mutex = SDL_CreateMutex();
+	conditionJobAvailable = SDL_CreateCond();
+	semaphoreHelpersDone = SDL_CreateSemaphore(0);
+
+	for (int count = 0; count < threadCount; count++) {
+		SDL_Thread* thread = SDL_CreateThread(threadMain, "Worker", this);
+		if (thread != nullptr)
+			listThreads.push_back(thread);
+		else
+			LOG_ERROR(LogModule::general, "Couldn't create worker thread = %s", SDL_GetError());
+	}
+}
+
+
+WorkerPool::~WorkerPool() {
+	//Drop any jobs that haven't started yet and wake every thread so it can exit.
+	SDL_LockMutex(mutex);
+	stopping = true;
+	listJobs.clear();
+	SDL_CondBroadcast(conditionJobAvailable);
+	SDL_UnlockMutex(mutex);
+
+	for (auto thread : listThreads)
+		SDL_WaitThread(thread, nullptr);
+	listThreads.clear();
+
+	SDL_DestroySemaphore(semaphoreHelpersDone);
+	SDL_DestroyCond(conditionJobAvailable);
+	SDL_DestroyMutex(mutex);
+}
+
+
+
+void WorkerPool::submit(std::function<void()> job) {
+	//Without any threads the job has to run on the caller.
+	if (listThreads.empty()) {
+		job();
+		return;
+	}
+
+	SDL_LockMutex(mutex);
+	listJobs.push_back(std::move(job));
+	SDL_CondSignal(conditionJobAvailable);
+	SDL_UnlockMutex(mutex);
+}
+
+
+int WorkerPool::getThreadCount() const {
+	return (int)listThreads.size();
+}
+
+
+void WorkerPool::parallelFor(int taskCount, const std::function<void(int)>& task) {
+	int helperCount = std::min(getThreadCount(), taskCount - 1);
+	if (helperCount <= 0) {
+		for (int index = 0; index < taskCount; index++)
+			task(index);
+		return;
+	}
+
+	//Everyone takes the next task until there are none left.
+	std::atomic<int> taskNext{ 0 };
+	auto runTasks = [&taskNext, taskCount, &task]() {
+		for (int index = taskNext++; index < taskCount; index = taskNext++)
+			task(index);
+	};
+
+	for (int count = 0; count < helperCount; count++) {
+		submit([this, &runTasks]() {
+			runTasks();
+			SDL_SemPost(semaphoreHelpersDone);
+		});
+	}
+	runTasks();
+
+	//The helpers hold references to this frame, so wait for all of them even if they found nothing.
+	for (int count = 0; count < helperCount; count++)
+		SDL_SemWait(semaphoreHelpersDone);
+}
+
+
+void WorkerPool::runTeam(const std::function<void(int, int)>& body) {
+	int memberCount = getThreadCount() + 1;
+	if (memberCount == 1) {
+		body(0, 1);
+		return;
+	}
+
+	//The jobs only hold the member index and a pointer, so they fit in std::function without
+	//allocating.
+	struct Team {
+		const std::function<void(int, int)>& body;
+		int memberCount;
+		SDL_sem* semaphoreMembersDone;
+	} team = { body, memberCount, semaphoreHelpersDone };
+
+	for (int memberIndex = 1; memberIndex < memberCount; memberIndex++) {
+		submit([&team, memberIndex]() {
+			team.body(memberIndex, team.memberCount);
+			SDL_SemPost(team.semaphoreMembersDone);
+		});
+	}
+	body(0, memberCount);
+
+	for (int count = 1; count < memberCount; count++)
+		SDL_SemWait(team.semaphoreMembersDone);
+}
+
+
+
+int WorkerPool::threadMain(void* data) {
+	WorkerPool* workerPool = static_cast<WorkerPool*>(data);
+	PROFILE_THREAD_NAME("Worker");
+
+	while (true) {
+		//Wait for a job or for the pool to shut down.
+		SDL_LockMutex(workerPool->mutex);
+		while (workerPool->listJobs.empty() && workerPool->stopping == false)
+			SDL_CondWait(workerPool->conditionJobAvailable, workerPool->mutex);
+
+		if (workerPool->stopping) {
+			SDL_UnlockMutex(workerPool->mutex);
+			return 0;
+		}
+
+		std::function<void()> job = std::move(workerPool->listJobs.front());
+		workerPool->listJobs.pop_front();
+		SDL_UnlockMutex(workerPool->mutex);
+
+		PROFILE_SCOPE("WorkerPool::job");
+		job();
+	}
+}
+
+
+
+SpinBarrier::SpinBarrier(int memberCount) :
+	memberCount(memberCount) {
+}
+
+
+void SpinBarrier::arrive() {
+	int generationArrived = generation.load(std::memory_order_acquire);
+
+	//The last member to arrive resets the count and lets everyone go.
+	if (arrivedCount.fetch_add(1, std::memory_order_acq_rel) + 1 == memberCount) {
+		arrivedCount.store(0, std::memory_order_relaxed);
+		generation.store(generationArrived + 1, std::memory_order_release);
+		return;
+	}
+
+	for (int spinCount = 0; generation.load(std::memory_order_acquire) == generationArrived; spinCount++) {
+		if (spinCount < 4096)
+			SDL_CPUPauseInstruction();
+		else
+			SDL_Delay(0);
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <vector>
+#include "SDL2/SDL.h"
+
+
+
+class WorkerPool
+{
+public:
+	//A thread count of 0 uses one thread per core, leaving one core for the render thread.
+	WorkerPool(int threadCount = 0);
+	~WorkerPool();
+
+	void submit(std::function<void()> job);
+	int getThreadCount() const;
+
+	//Runs task(index) for every index below taskCount, spread over the workers and the caller, and
+	//returns once they're all done.  The caller takes tasks too, so it finishes even if every
+	//worker is busy with something else.  Only one thread may call it or runTeam at a time.
+	void parallelFor(int taskCount, const std::function<void(int)>& task);
+	//Runs body(memberIndex, memberCount) on every worker and the caller at the same time, the caller
+	//being member 0, for work whose members wait on each other.  Only use it on a pool that nothing
+	//else submits to, or a member could wait forever for a worker that never starts.
+	void runTeam(const std::function<void(int, int)>& body);
+
+
+private:
+	static int threadMain(void* data);
+
+
+	std::vector<SDL_Thread*> listThreads;
+	std::deque<std::function<void()>> listJobs;
+
+	SDL_mutex* mutex = nullptr;
+	SDL_cond* conditionJobAvailable = nullptr;
+	//Posted by each helper of parallelFor or runTeam when it's done.
+	SDL_sem* semaphoreHelpersDone = nullptr;
+	bool stopping = false;
+};
+
+
+
+//A barrier for a fixed team of threads.  It spins rather than sleeping, since the steps between
+//barriers are often shorter than waking a thread, but yields if the wait drags on in case there
+//are more threads than cores.
+class SpinBarrier
+{
+public:
+	explicit SpinBarrier(int memberCount);
+
+	void arrive();
+
+
+private:
+	const int memberCount;
+	std::atomic<int> arrivedCount{ 0 };
+	std::atomic<int> generation{ 0 };
+};
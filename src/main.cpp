@@ -1,34 +1,51 @@
-#include <iostream>
 #include <string>
 #include "SDL2/SDL.h"
 #include "SDL2/SDL_mixer.h"
 #include "SDL2/SDL_ttf.h"
+#include "SDL2/SDL_image.h"
 #include "Game.h"
 #include "BackgroundSelector.h"
+#include "AssetLoader.h"
+#include "AssetIndex.h"
+#include "Logger.h"
+#include "Profiler.h"
 
 int main(int argc, char* args[]) {
 	// Seed the random number generator
 	srand((unsigned)time(NULL));
 
+	// Write log output from a background thread, and flush it on every exit path
+	Logger::start();
+	atexit(Logger::stop);
+	PROFILE_THREAD_NAME("Main");
+
 	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
-		std::cout << "Error: Couldn't initialize SDL Video or Audio = " << SDL_GetError() << std::endl;
+		LOG_ERROR(LogModule::general, "Couldn't initialize SDL Video or Audio = %s", SDL_GetError());
 		return 1;
 	}
 	else {
 		// Initialize SDL_ttf
 		if (TTF_Init() < 0) {
-			std::cout << "Error: Couldn't initialize SDL_ttf = " << TTF_GetError() << std::endl;
+			LOG_ERROR(LogModule::general, "Couldn't initialize SDL_ttf = %s", TTF_GetError());
 			return 1;
 		}
 
+		// Index the data directory once so assets never have to be searched for
+		AssetIndex::build();
+
+		// Initialize SDL_image for PNG assets
+		if ((IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG) == 0) {
+			LOG_ERROR(LogModule::general, "Couldn't initialize SDL_image = %s", IMG_GetError());
+		}
+
 		// Setup the audio mixer
 		bool isSDLMixerLoaded = (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 1024) == 0);
 		if (isSDLMixerLoaded == false) {
-			std::cout << "Error: Couldn't initialize Mix_OpenAudio = " << Mix_GetError() << std::endl;
+			LOG_ERROR(LogModule::general, "Couldn't initialize Mix_OpenAudio = %s", Mix_GetError());
 		}
 		else {
 			Mix_AllocateChannels(32);
-			std::cout << "Audio driver = " << SDL_GetCurrentAudioDriver() << std::endl;
+			LOG_INFO(LogModule::general, "Audio driver = %s", SDL_GetCurrentAudioDriver());
 		}
 
 		// Create the window
@@ -36,14 +53,14 @@ int main(int argc, char* args[]) {
 			SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 960, 576, 0);
 			
 		if (window == nullptr) {
-			std::cout << "Error: Couldn't create window = " << SDL_GetError() << std::endl;
+			LOG_ERROR(LogModule::general, "Couldn't create window = %s", SDL_GetError());
 			return 1;
 		}
 		else {
 			// Load and set the window icon
-			SDL_Surface* icon = SDL_LoadBMP("Data/Images/icon.bmp");
+			SDL_Surface* icon = SDL_LoadBMP_RW(AssetIndex::openRW("icon.bmp"), 1);
 			if (icon == nullptr) {
-				std::cout << "Warning: Couldn't load icon = " << SDL_GetError() << std::endl;
+				LOG_WARNING(LogModule::general, "Couldn't load icon = %s", SDL_GetError());
 			} else {
 				SDL_SetWindowIcon(window, icon);
 				SDL_FreeSurface(icon);
@@ -54,7 +71,7 @@ int main(int argc, char* args[]) {
                                SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
                                
 			if (renderer == nullptr) {
-				std::cout << "Error: Couldn't create renderer = " << SDL_GetError() << std::endl;
+				LOG_ERROR(LogModule::general, "Couldn't create renderer = %s", SDL_GetError());
 				return 1;
 			}
 			else {
@@ -64,30 +81,38 @@ int main(int argc, char* args[]) {
 				// Output renderer information
 				SDL_RendererInfo rendererInfo;
 				SDL_GetRendererInfo(renderer, &rendererInfo);
-				std::cout << "Renderer = " << rendererInfo.name << std::endl;
+				LOG_INFO(LogModule::general, "Renderer = %s", rendererInfo.name);
 
 				// Get window dimensions
 				int windowWidth = 0, windowHeight = 0;
 				SDL_GetWindowSize(window, &windowWidth, &windowHeight);
 
+                // Decode every asset in the background while the menu is already interactive
+                AssetLoader assetLoader;
+                assetLoader.queueGameAssets();
+                assetLoader.start();
+
                 // Visual background selection menu
                 std::string selectedBackground = "bg1.bmp"; // Default in case selection fails
+                bool quitRequested = false;
                 
                 {
                     BackgroundSelection bgSelection(renderer, windowWidth, windowHeight);
+                    bgSelection.setLoadingProgress(assetLoader.getProgress());
                     bool selectionRunning = true;
                     
                     while (selectionRunning) {
+                        // The menu is static, so block until there's input rather than redrawing every 16ms.
+                        // While assets are still streaming in, wake up each frame to show progress.
                         SDL_Event event;
-                        while (SDL_PollEvent(&event)) {
+                        int waitTimeoutMs = assetLoader.isFinished() ? 500 : 16;
+                        bool eventReceived = (SDL_WaitEventTimeout(&event, waitTimeoutMs) == 1);
+                        while (eventReceived) {
                             if (event.type == SDL_QUIT) {
-                                selectionRunning = false;
                                 // Exit entire application
-                                SDL_DestroyRenderer(renderer);
-                                SDL_DestroyWindow(window);
-                                TTF_Quit();
-                                SDL_Quit();
-                                return 0;
+                                selectionRunning = false;
+                                quitRequested = true;
+                                break;
                             }
                             
                             std::string selected = bgSelection.update(event);
@@ -96,19 +121,39 @@ int main(int argc, char* args[]) {
                                 selectionRunning = false;
                                 break;
                             }
+
+                            eventReceived = (SDL_PollEvent(&event) == 1);
+                        }
+
+                        // Upload any textures the workers finished decoding
+                        if (assetLoader.update(renderer)) {
+                            bgSelection.setLoadingProgress(assetLoader.getProgress());
                         }
                         
-                        if (selectionRunning) {
+                        if (selectionRunning && bgSelection.isRedrawRequired()) {
                             bgSelection.draw(renderer);
-                            SDL_Delay(16); // ~60fps
                         }
                     }
                 }
                 
-                std::cout << "Starting game with background: " << selectedBackground << std::endl;
-                
-				// Start the game with selected background
-				Game game(window, renderer, windowWidth, windowHeight, selectedBackground);
+                if (!quitRequested) {
+                    // The game itself needs everything resident
+                    assetLoader.finish(renderer);
+
+                    LOG_INFO(LogModule::game, "Starting game with background: %s", selectedBackground.c_str());
+                    
+                    // Start the game with selected background
+                    Game game(window, renderer, windowWidth, windowHeight, selectedBackground);
+                }
+
+#ifdef CITYDEFENSE_PROFILE
+                // Keep a trace of the whole session for offline analysis
+                TraceRecorder::writeFile("trace.json");
+#endif
+
+                // Release anything the loader cached if the game never started
+                TextureLoader::deallocateTextures();
+                SoundLoader::deallocateSounds();
 
 				// Clean up renderer
 				SDL_DestroyRenderer(renderer);
@@ -124,6 +169,7 @@ int main(int argc, char* args[]) {
 			Mix_Quit();
 		}
 
+		IMG_Quit();
 		TTF_Quit();
 		SDL_Quit();
 	}